@@ -0,0 +1,2039 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "frequency_index.hpp"
+#include "hash.hpp"
+#include "parallel.hpp"
+#include "small_hash_map.hpp"
+
+/**
+ * @brief Strict weak order on elements that defines the canonical order of a BasicMultiSet.
+ *
+ * The primary template uses std::less. Specialize it for element types
+ * without operator<; the order must treat elements that the multiset's
+ * Eq considers equal as equivalent.
+ *
+ * @tparam T The element type.
+ */
+template <typename T>
+struct CanonicalLess
+{
+    bool operator()(const T& left, const T& right) const { return std::less<T>()(left, right); }
+};
+
+/**
+ * @brief Class template representing a multiset of elements of type T.
+ *
+ * BasicMultiSet stores each distinct element once together with its
+ * number of occurrences. It supports addition, removal and set
+ * operations (union, intersection, difference) for any hashable
+ * element type, without converting elements to strings. Up to
+ * kInlineCapacity distinct elements are stored inline without any
+ * allocation; larger sets move to a hash table. The total size is
+ * maintained incrementally and the structural hash is cached, so both
+ * are O(1) to query and let equality checks reject most unequal sets
+ * without comparing elements. An optional frequency index answers
+ * queries by count without scanning all elements.
+ *
+ * Classes that extend a BasicMultiSet pass themselves as Derived, so
+ * that operators return the derived type. A derived class may hide
+ * EmptyLike() to control how result sets are created.
+ *
+ * @tparam T The element type.
+ * @tparam Hash The hash functor for elements.
+ * @tparam Eq The equality functor for elements.
+ * @tparam Count The type of the per-element counts.
+ * @tparam Derived The derived class, or void if the template is used directly.
+ */
+template <typename T, typename Hash = std::hash<T>, typename Eq = std::equal_to<T>, typename Count = std::size_t,
+          typename Derived = void>
+class BasicMultiSet
+{
+public:
+    /**
+     * @brief Number of distinct elements stored inline before switching to a hash table.
+     *
+     * At least eight, more for small elements, see kSmallHashMapCapacity.
+     */
+    static constexpr std::size_t kInlineCapacity = kSmallHashMapCapacity<T, Count, Hash, Eq>;
+
+    using Self = std::conditional_t<std::is_void_v<Derived>, BasicMultiSet, Derived>;
+    using Element = T;
+    using CountType = Count;
+    using HashType = Hash;
+    using ElementMap = SmallHashMap<T, Count, Hash, Eq, kInlineCapacity>;
+    using Entry = typename ElementMap::value_type;
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    BasicMultiSet() = default;
+
+    /**
+     * @brief Constructs an empty multiset that allocates from the given allocator.
+     *
+     * @param alloc The allocator to use.
+     */
+    explicit BasicMultiSet(const allocator_type& alloc) : elements_(alloc) {}
+
+    /**
+     * @brief Copies a multiset, including its frequency index if it has one.
+     *
+     * @param other The multiset to copy.
+     */
+    BasicMultiSet(const BasicMultiSet& other)
+        : elements_(other.elements_),
+          total_(other.total_),
+          hash_(other.hash_),
+          index_(CloneIndex(other.index_, elements_.get_allocator()))
+    {
+    }
+
+    /**
+     * @brief Copy-constructs a multiset using the given allocator.
+     *
+     * @param other The multiset to copy.
+     * @param alloc The allocator to use for the copy.
+     */
+    BasicMultiSet(const BasicMultiSet& other, const allocator_type& alloc)
+        : elements_(other.elements_, alloc),
+          total_(other.total_),
+          hash_(other.hash_),
+          index_(CloneIndex(other.index_, alloc))
+    {
+    }
+
+    BasicMultiSet(BasicMultiSet&& other) noexcept(std::is_nothrow_move_constructible_v<ElementMap>)
+        : elements_(std::move(other.elements_)),
+          total_(other.total_),
+          hash_(other.hash_),
+          index_(std::exchange(other.index_, nullptr))
+    {
+        other.ResetMovedFrom();
+    }
+
+    /**
+     * @brief Move-constructs a multiset using the given allocator.
+     *
+     * The elements are moved if the allocators compare equal and copied otherwise.
+     *
+     * @param other The multiset to move from.
+     * @param alloc The allocator to use for the new multiset.
+     */
+    BasicMultiSet(BasicMultiSet&& other, const allocator_type& alloc)
+        : elements_(std::move(other.elements_), alloc),
+          total_(other.total_),
+          hash_(other.hash_),
+          index_(alloc == other.get_allocator() ? std::exchange(other.index_, nullptr)
+                                                : CloneIndex(other.index_, alloc))
+    {
+        if (alloc == other.get_allocator())
+        {
+            other.ResetMovedFrom();
+        }
+    }
+
+    BasicMultiSet& operator=(const BasicMultiSet& other);
+    BasicMultiSet& operator=(BasicMultiSet&& other);
+
+    ~BasicMultiSet()
+    {
+        DestroyIndex();
+        DestroyCanonical();
+    }
+
+    /**
+     * @brief Gets the allocator used by the multiset.
+     *
+     * @return The allocator of the multiset.
+     */
+    allocator_type get_allocator() const { return elements_.get_allocator(); }
+
+    /**
+     * @brief Adds an element to the multiset.
+     *
+     * This method increases the count of the specified element
+     * in the multiset. Any number of occurrences is added with one probe.
+     *
+     * @param element The element to add.
+     * @param count The number of occurrences to add; adding zero does nothing.
+     */
+    void AddElement(const T& element, Count count = 1);
+
+    /**
+     * @brief Removes an element from the multiset.
+     *
+     * This method decreases the count of the specified element
+     * in the multiset, removing it completely if the count reaches zero.
+     *
+     * @param element The element to remove.
+     * @throws std::runtime_error If the element does not exist in the multiset.
+     */
+    void RemoveElement(const T& element);
+
+    /**
+     * @brief Checks if the multiset contains a specific element.
+     *
+     * @param element The element to check for.
+     * @return True if the element is contained in the multiset, false otherwise.
+     */
+    bool IsContains(const T& element) const;
+
+    /**
+     * @brief Checks if the multiset is empty.
+     *
+     * @return True if the multiset has no elements, false otherwise.
+     */
+    bool IsEmpty() const;
+
+    /**
+     * @brief Gets the number of elements in the multiset, counting duplicates.
+     *
+     * @return The size of the multiset.
+     */
+    std::size_t Size() const;
+
+    /**
+     * @brief Computes an order-independent hash of the elements and their counts.
+     *
+     * The hash is cached until the multiset is modified. Elements must
+     * not be modified while they are stored in the multiset.
+     *
+     * @return The structural hash of the multiset.
+     */
+    std::size_t StructuralHash() const;
+
+    /**
+     * @brief Builds a boolean representation of the multiset.
+     *
+     * This method returns a multiset where each element of the
+     * current set is present with a count of 1.
+     *
+     * @return A multiset representing the boolean logic.
+     */
+    Self BuildBoolean() const;
+
+    /**
+     * @brief Starts maintaining a frequency index over the counts.
+     *
+     * The index buckets elements by count. AddElement and RemoveElement
+     * update it in O(1); operations that change many counts at once
+     * rebuild it. Copies of the multiset copy the index. Enabling an
+     * enabled index does nothing.
+     */
+    void EnableFrequencyIndex();
+
+    /**
+     * @brief Stops maintaining the frequency index and frees it.
+     */
+    void DisableFrequencyIndex();
+
+    /**
+     * @brief Checks whether the multiset maintains a frequency index.
+     *
+     * @return True if the frequency index is enabled.
+     */
+    bool HasFrequencyIndex() const { return index_ != nullptr; }
+
+    /**
+     * @brief Calls visit(element, count) for every element whose count is at least the threshold.
+     *
+     * With the frequency index the cost is proportional to the number
+     * of reported elements and they are visited by decreasing count;
+     * without it all elements are scanned in unspecified order.
+     *
+     * @param threshold The smallest count to report.
+     * @param visit The visitor.
+     */
+    template <typename Visitor>
+    void ForEachWithCountAtLeast(Count threshold, Visitor&& visit) const;
+
+    /**
+     * @brief Calls visit(element, count) for every element whose count lies in [low, high].
+     *
+     * With the frequency index the elements are visited by decreasing
+     * count; without it all elements are scanned in unspecified order.
+     *
+     * @param low The smallest count to report.
+     * @param high The largest count to report.
+     * @param visit The visitor.
+     */
+    template <typename Visitor>
+    void ForEachWithCountInRange(Count low, Count high, Visitor&& visit) const;
+
+    /**
+     * @brief Counts the distinct elements whose count lies in [low, high].
+     *
+     * With the frequency index only the sizes of the count buckets are
+     * summed; without it all elements are scanned.
+     *
+     * @param low The smallest count to include.
+     * @param high The largest count to include.
+     * @return The number of distinct elements with a count in the range.
+     */
+    std::size_t CountWithCountInRange(Count low, Count high) const;
+
+    /**
+     * @brief Finds the k most frequent elements.
+     *
+     * Uses a bounded min-heap over the counts, so the cost is
+     * O(n log k) rather than a full sort. The entries point into the
+     * multiset and stay valid until it is modified. The order of
+     * elements with equal counts is unspecified.
+     *
+     * @param k The number of elements to return.
+     * @return Up to k entries, ordered by decreasing count.
+     */
+    std::vector<const Entry*> TopK(std::size_t k) const;
+
+    // Operators overload
+    /**
+     * @brief Checks for equality between two multisets.
+     *
+     * The comparison returns early for the same object, and rejects
+     * sets with different sizes, different numbers of distinct elements
+     * or different cached hashes before comparing elements.
+     *
+     * @param other The other multiset to compare with.
+     * @return True if the two multisets are equal, false otherwise.
+     */
+    bool operator==(const BasicMultiSet& other) const;
+
+    /**
+     * @brief Checks for inequality between two multisets.
+     *
+     * @param other The other multiset to compare with.
+     * @return True if the two multisets are not equal, false otherwise.
+     */
+    bool operator!=(const BasicMultiSet& other) const;
+
+    /**
+     * @brief Checks whether every element occurs in another multiset at least as often as here.
+     *
+     * Sizes and cached hashes are compared first, and the check stops at
+     * the first element that violates containment.
+     *
+     * @param other The other multiset.
+     * @return True if this multiset is a sub-multiset of the other one.
+     */
+    bool IsSubMultiSetOf(const BasicMultiSet& other) const;
+
+    /**
+     * @brief Checks whether two multisets have no element in common.
+     *
+     * The smaller multiset is iterated, and the check stops at the first
+     * shared element.
+     *
+     * @param other The other multiset.
+     * @return True if no element occurs in both multisets.
+     */
+    bool IsDisjoint(const BasicMultiSet& other) const;
+
+    /**
+     * @brief Performs the union operation between two multisets.
+     *
+     * @param other The other multiset to union with.
+     * @return A new multiset representing the union of both.
+     */
+    Self operator+(const BasicMultiSet& other) const;
+
+    /**
+     * @brief Performs the union operation in place.
+     *
+     * @param other The other multiset to union with.
+     * @return A reference to this multiset after the union.
+     */
+    Self& operator+=(const BasicMultiSet& other);
+
+    /**
+     * @brief Performs the intersection operation between two multisets.
+     *
+     * @param other The other multiset to intersect with.
+     * @return A new multiset representing the intersection of both.
+     */
+    Self operator*(const BasicMultiSet& other) const;
+
+    /**
+     * @brief Performs the intersection operation in place.
+     *
+     * @param other The other multiset to intersect with.
+     * @return A reference to this multiset after the intersection.
+     */
+    Self& operator*=(const BasicMultiSet& other);
+
+    /**
+     * @brief Performs the difference operation between two multisets.
+     *
+     * Elements found only in the other multiset are kept with their
+     * count. Use Difference() to subtract without keeping them.
+     *
+     * @param other The other multiset to subtract.
+     * @return A new multiset representing the difference of both.
+     */
+    Self operator-(const BasicMultiSet& other) const;
+
+    /**
+     * @brief Performs the difference operation in place.
+     *
+     * @param other The other multiset to subtract.
+     * @return A reference to this multiset after the difference.
+     */
+    Self& operator-=(const BasicMultiSet& other);
+
+    /**
+     * @brief Computes this multiset minus another one.
+     *
+     * The count of each element is reduced by its count in the other
+     * multiset, and elements whose count drops to zero are removed.
+     * Elements found only in the other multiset are ignored.
+     *
+     * @param other The multiset to subtract.
+     * @return A new multiset holding the difference.
+     */
+    Self Difference(const BasicMultiSet& other) const&;
+
+    /**
+     * @brief Computes this multiset minus another one, reusing the storage of this multiset.
+     *
+     * @param other The multiset to subtract.
+     * @return The difference, built in the storage of this multiset.
+     */
+    Self Difference(const BasicMultiSet& other) &&;
+
+    /**
+     * @brief Subtracts another multiset from this one in place.
+     *
+     * @param other The multiset to subtract.
+     * @return A reference to this multiset after the difference.
+     */
+    Self& DifferenceInPlace(const BasicMultiSet& other);
+
+    /**
+     * @brief Computes the symmetric difference of two multisets.
+     *
+     * Each element is kept with the absolute difference of its counts
+     * in both multisets, and removed if the counts are equal.
+     *
+     * @param other The other multiset.
+     * @return A new multiset holding the symmetric difference.
+     */
+    Self SymmetricDifference(const BasicMultiSet& other) const&;
+
+    /**
+     * @brief Computes the symmetric difference, reusing the storage of this multiset.
+     *
+     * @param other The other multiset.
+     * @return The symmetric difference, built in the storage of this multiset.
+     */
+    Self SymmetricDifference(const BasicMultiSet& other) &&;
+
+    /**
+     * @brief Replaces this multiset with its symmetric difference with another one.
+     *
+     * @param other The other multiset.
+     * @return A reference to this multiset after the symmetric difference.
+     */
+    Self& SymmetricDifferenceInPlace(const BasicMultiSet& other);
+
+    /**
+     * @brief Computes the weighted Jaccard similarity with another multiset.
+     *
+     * The similarity is the size of the intersection divided by the size
+     * of the union, the same as (*this * other).Size() / (*this +
+     * other).Size(), but computed in one pass over the smaller multiset
+     * without building either result.
+     *
+     * @param other The other multiset.
+     * @return The similarity in [0, 1], or 1 if both multisets are empty.
+     */
+    double WeightedJaccard(const BasicMultiSet& other) const;
+
+    /**
+     * @brief Computes the union of many multisets.
+     *
+     * Each element is kept with its largest count among the inputs. The
+     * result is sized for all inputs up front and uses the allocator of
+     * the first one. With threads > 1 the inputs are split into chunks
+     * that are reduced concurrently and then merged pairwise; the
+     * allocator of the first input must then be thread-safe. Threads
+     * are ignored if MULTISET_SINGLE_THREADED is defined.
+     *
+     * @param first The first of a range of pointers to the multisets.
+     * @param last The end of the range.
+     * @param threads The number of threads to use.
+     * @return The union of the multisets, or an empty multiset for an empty range.
+     */
+    template <typename ForwardIt>
+    static Self UnionAll(ForwardIt first, ForwardIt last, std::size_t threads = 1);
+
+    /**
+     * @brief Computes the intersection of many multisets.
+     *
+     * Each element is kept with its smallest count among the inputs. The
+     * smallest input is copied and intersected with the others in order
+     * of size, which stops early once the result is empty. Parameters
+     * are as for UnionAll().
+     *
+     * @param first The first of a range of pointers to the multisets.
+     * @param last The end of the range.
+     * @param threads The number of threads to use.
+     * @return The intersection of the multisets, or an empty multiset for an empty range.
+     */
+    template <typename ForwardIt>
+    static Self IntersectAll(ForwardIt first, ForwardIt last, std::size_t threads = 1);
+
+    /**
+     * @brief Computes the sum of many multisets.
+     *
+     * The count of each element is the sum of its counts in the inputs.
+     * Parameters are as for UnionAll().
+     *
+     * @param first The first of a range of pointers to the multisets.
+     * @param last The end of the range.
+     * @param threads The number of threads to use.
+     * @return The sum of the multisets, or an empty multiset for an empty range.
+     */
+    template <typename ForwardIt>
+    static Self SumAll(ForwardIt first, ForwardIt last, std::size_t threads = 1);
+
+    /**
+     * @brief Sets the elements of the multiset.
+     *
+     * This method populates the multiset with a given set of elements
+     * and their counts.
+     *
+     * @param elements A map of elements and their respective counts to set.
+     */
+    void SetElements(const ElementMap& elements);
+
+    /**
+     * @brief Sets the elements of the multiset, taking ownership of the map.
+     *
+     * @param elements A map of elements and their respective counts to set.
+     */
+    void SetElements(ElementMap&& elements);
+
+    /**
+     * @brief Retrieves the elements of the multiset.
+     *
+     * This method returns a constant reference to the internal map of
+     * elements and their counts in the multiset. The map iterates in
+     * hash order, which can differ between runs and builds; use
+     * CanonicalEntries() for a deterministic order.
+     *
+     * @return A constant reference to the map of elements and counts.
+     */
+    const ElementMap& GetElements() const;
+
+    /**
+     * @brief Gets the entries sorted by CanonicalLess of their elements.
+     *
+     * The order only depends on the contents of the multiset. It is
+     * computed once and cached until the multiset is modified, so
+     * repeated calls cost nothing and concurrent readers are safe.
+     *
+     * @return Pointers to the entries in canonical order, valid until the multiset is modified.
+     */
+    const std::vector<const Entry*>& CanonicalEntries() const;
+
+    /**
+     * @brief Compares two multisets in canonical order.
+     *
+     * Canonical entries are compared lexicographically, first by element
+     * and then by count, and a prefix orders before a longer sequence.
+     * Equal multisets compare equal.
+     *
+     * @param other The other multiset.
+     * @return A negative value, zero or a positive value if this multiset orders before, with or after the other.
+     */
+    int CanonicalCompare(const BasicMultiSet& other) const;
+
+protected:
+    /**
+     * @brief Creates an empty multiset to hold the result of an operation.
+     *
+     * The result uses the allocator of this multiset.
+     *
+     * @return An empty multiset.
+     */
+    Self EmptyLike() const { return Self(get_allocator()); }
+
+    const Self& AsDerived() const { return static_cast<const Self&>(*this); }
+
+    Self& AsDerived() { return static_cast<Self&>(*this); }
+
+    /**
+     * @brief Recomputes the total size and drops the cached hash after elements_ was replaced.
+     */
+    void ElementsChanged();
+
+    /**
+     * @brief Drops the cached hash and rebuilds the frequency index after counts were changed in bulk.
+     */
+    void CountsChanged();
+
+    ElementMap elements_;
+    std::size_t total_ = 0;
+
+private:
+    using FrequencyIndexType = FrequencyIndex<T, Count, Hash, Eq>;
+
+    static FrequencyIndexType* NewIndex(const FrequencyIndexType* source, const allocator_type& alloc);
+
+    static FrequencyIndexType* CloneIndex(const FrequencyIndexType* index, const allocator_type& alloc);
+
+    void DestroyIndex();
+
+    /**
+     * @brief Drops the cached hash and canonical order after a modification.
+     */
+    void ResetCaches();
+
+    void DestroyCanonical();
+
+    /**
+     * @brief Leaves a multiset whose elements were taken by a move empty, with its size and caches to match.
+     */
+    void ResetMovedFrom();
+
+    void MergeMax(const BasicMultiSet& other);
+
+    void ApplyDifference(const BasicMultiSet& other);
+
+    void ClearElements();
+
+    void AddCounts(const BasicMultiSet& other);
+
+    using SetList = std::vector<const BasicMultiSet*>;
+    using RangeReducer = Self (*)(const BasicMultiSet* const* first, const BasicMultiSet* const* last);
+
+    static Self UnionRange(const BasicMultiSet* const* first, const BasicMultiSet* const* last);
+
+    static Self IntersectRange(const BasicMultiSet* const* first, const BasicMultiSet* const* last);
+
+    static Self SumRange(const BasicMultiSet* const* first, const BasicMultiSet* const* last);
+
+    static Self ReduceAll(const SetList& sets, std::size_t threads, RangeReducer reduce);
+
+    /**
+     * @brief Lazily computed structural hash, where 0 means not computed yet.
+     *
+     * Relaxed atomic access lets concurrent readers of a const multiset
+     * fill the cache without a data race.
+     */
+    class HashCache
+    {
+    public:
+        HashCache() = default;
+        HashCache(const HashCache& other) : value_(other.Get()) {}
+
+        HashCache& operator=(const HashCache& other)
+        {
+            value_.store(other.Get(), std::memory_order_relaxed);
+            return *this;
+        }
+
+        std::size_t Get() const { return value_.load(std::memory_order_relaxed); }
+
+        void Set(std::size_t value) const { value_.store(value, std::memory_order_relaxed); }
+
+        void Reset() { value_.store(0, std::memory_order_relaxed); }
+
+    private:
+        mutable std::atomic<std::size_t> value_{0};
+    };
+
+    using CanonicalCache = std::vector<const Entry*>;
+
+    HashCache hash_;
+    FrequencyIndexType* index_ = nullptr;
+    // Published with release ordering by the first reader that sorts; lives outside the multiset's memory resource
+    // so that const readers never allocate from it concurrently
+    mutable std::atomic<const CanonicalCache*> canonical_{nullptr};
+};
+
+/**
+ * @brief Copies the elements of another multiset, keeping the allocator of this one.
+ * @param other The multiset to copy.
+ * @return A reference to this multiset.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::operator=(const BasicMultiSet& other) -> BasicMultiSet&
+{
+    if (&other != this)
+    {
+        FrequencyIndexType* index = CloneIndex(other.index_, get_allocator());
+        elements_ = other.elements_;
+        total_ = other.total_;
+        hash_ = other.hash_;
+        DestroyIndex();
+        DestroyCanonical();
+        index_ = index;
+    }
+    return *this;
+}
+
+/**
+ * @brief Moves the elements of another multiset, keeping the allocator of this one.
+ *
+ * The elements and index are taken over if the allocators compare equal and copied otherwise.
+ *
+ * @param other The multiset to move from.
+ * @return A reference to this multiset.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::operator=(BasicMultiSet&& other) -> BasicMultiSet&
+{
+    if (&other != this)
+    {
+        bool take = get_allocator() == other.get_allocator();
+        FrequencyIndexType* index =
+            take ? std::exchange(other.index_, nullptr) : CloneIndex(other.index_, get_allocator());
+        elements_ = std::move(other.elements_);
+        total_ = other.total_;
+        hash_ = other.hash_;
+        DestroyIndex();
+        DestroyCanonical();
+        index_ = index;
+        if (take)
+        {
+            other.ResetMovedFrom();
+        }
+    }
+    return *this;
+}
+
+/**
+ * @brief Adds an element to the multiset. If the element already exists, its count is increased.
+ * @param element The element to be added to the multiset.
+ * @param count The number of occurrences to add.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::AddElement(const T& element, Count count)
+{
+    if (count == Count())
+    {
+        return;
+    }
+    elements_.try_emplace(element, 0).first->second += count;
+    total_ += count;
+    ResetCaches();
+    if (index_)
+    {
+        index_->Increment(element, count);
+    }
+}
+
+/**
+ * @brief Removes an element from the multiset. If the element's count reaches zero, it is removed from the multiset.
+ * @param element The element to be removed from the multiset.
+ * @throws std::runtime_error If the element does not exist in the multiset.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::RemoveElement(const T& element)
+{
+    auto it = elements_.find(element);
+
+    if (it == elements_.end())
+    {
+        throw std::runtime_error("Element does not exist in the multiset");
+    }
+
+    if (index_)
+    {
+        index_->Decrement(it->first);
+    }
+    if (--(it->second) == 0)
+    {
+        elements_.erase(it);
+    }
+    --total_;
+    ResetCaches();
+}
+
+/**
+ * @brief Checks if the multiset contains a specific element.
+ * @param element The element to check for presence in the multiset.
+ * @return true if the element is in the multiset, false otherwise.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+bool BasicMultiSet<T, Hash, Eq, Count, Derived>::IsContains(const T& element) const
+{
+    auto it = elements_.find(element);
+    return it != elements_.end();
+}
+
+/**
+ * @brief Checks if the multiset is empty.
+ * @return true if the multiset is empty, false otherwise.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+bool BasicMultiSet<T, Hash, Eq, Count, Derived>::IsEmpty() const
+{
+    return elements_.empty();
+}
+
+/**
+ * @brief Returns the total number of elements in the multiset, counting duplicates.
+ * @return The size of the multiset.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+std::size_t BasicMultiSet<T, Hash, Eq, Count, Derived>::Size() const
+{
+    return total_;
+}
+
+/**
+ * @brief Computes the structural hash of the multiset, reusing the cached value if there is one.
+ *
+ * Each element is hashed together with its count into an entry hash, and the entry hashes are summed, which
+ * keeps the result independent of iteration order.
+ *
+ * @return The structural hash of the multiset.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+std::size_t BasicMultiSet<T, Hash, Eq, Count, Derived>::StructuralHash() const
+{
+    std::size_t cached = hash_.Get();
+    if (cached != 0)
+    {
+        return cached;
+    }
+
+    std::uint64_t hash_sum = 0;
+    for (const auto& elem : elements_)
+    {
+        hash_sum += HashEntry(Hash()(elem.first), static_cast<std::uint64_t>(elem.second));
+    }
+
+    // Fold in the number of distinct elements so that sums of different sizes spread further
+    auto hash_value = static_cast<std::size_t>(MixHash(hash_sum + elements_.size()));
+    // 0 marks an empty cache, so an actual hash of 0 is remapped
+    hash_value = hash_value != 0 ? hash_value : 1;
+    hash_.Set(hash_value);
+    return hash_value;
+}
+
+/**
+ * @brief Builds a boolean multiset where each element is present with a count of 1.
+ * @return A new multiset representing the boolean version of the original multiset.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::BuildBoolean() const -> Self
+{
+    Self booleanSet = AsDerived().EmptyLike();
+    for (const auto& element : elements_)
+    {
+        booleanSet.elements_[element.first] = 1;
+    }
+    booleanSet.total_ = elements_.size();
+    return booleanSet;
+}
+
+/**
+ * @brief Finds the k most frequent elements with a bounded min-heap.
+ * @param k The number of elements to return.
+ * @return Up to k entries, ordered by decreasing count.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::TopK(std::size_t k) const -> std::vector<const Entry*>
+{
+    // Orders the heap so that the least frequent of the kept entries is on top
+    auto more_frequent = [](const Entry* left, const Entry* right) { return left->second > right->second; };
+
+    std::vector<const Entry*> top;
+    top.reserve(std::min(k, elements_.size()));
+    if (k == 0)
+    {
+        return top;
+    }
+    for (const auto& entry : elements_)
+    {
+        if (top.size() < k)
+        {
+            top.push_back(&entry);
+            std::push_heap(top.begin(), top.end(), more_frequent);
+        }
+        else if (entry.second > top.front()->second)
+        {
+            std::pop_heap(top.begin(), top.end(), more_frequent);
+            top.back() = &entry;
+            std::push_heap(top.begin(), top.end(), more_frequent);
+        }
+    }
+    std::sort_heap(top.begin(), top.end(), more_frequent);
+    return top;
+}
+
+/**
+ * @brief Starts maintaining a frequency index over the counts.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::EnableFrequencyIndex()
+{
+    if (index_)
+    {
+        return;
+    }
+    index_ = NewIndex(nullptr, get_allocator());
+    try
+    {
+        index_->Rebuild(elements_);
+    }
+    catch (...)
+    {
+        DestroyIndex();
+        throw;
+    }
+}
+
+/**
+ * @brief Stops maintaining the frequency index and frees it.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::DisableFrequencyIndex()
+{
+    DestroyIndex();
+}
+
+/**
+ * @brief Calls visit(element, count) for every element whose count is at least the threshold.
+ * @param threshold The smallest count to report.
+ * @param visit The visitor.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+template <typename Visitor>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::ForEachWithCountAtLeast(Count threshold, Visitor&& visit) const
+{
+    if (index_)
+    {
+        index_->ForEachAtLeast(threshold, visit);
+        return;
+    }
+    for (const auto& element : elements_)
+    {
+        if (element.second >= threshold)
+        {
+            visit(element.first, element.second);
+        }
+    }
+}
+
+/**
+ * @brief Calls visit(element, count) for every element whose count lies in [low, high].
+ * @param low The smallest count to report.
+ * @param high The largest count to report.
+ * @param visit The visitor.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+template <typename Visitor>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::ForEachWithCountInRange(Count low, Count high,
+                                                                         Visitor&& visit) const
+{
+    if (index_)
+    {
+        index_->ForEachInRange(low, high, visit);
+        return;
+    }
+    for (const auto& element : elements_)
+    {
+        if (element.second >= low && element.second <= high)
+        {
+            visit(element.first, element.second);
+        }
+    }
+}
+
+/**
+ * @brief Counts the distinct elements whose count lies in [low, high].
+ * @param low The smallest count to include.
+ * @param high The largest count to include.
+ * @return The number of distinct elements with a count in the range.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+std::size_t BasicMultiSet<T, Hash, Eq, Count, Derived>::CountWithCountInRange(Count low, Count high) const
+{
+    if (index_)
+    {
+        return index_->CountInRange(low, high);
+    }
+    return std::count_if(elements_.begin(), elements_.end(), [low, high](const Entry& element)
+                         { return element.second >= low && element.second <= high; });
+}
+
+// Override operators
+
+/**
+ * @brief Compares two multisets for equality.
+ * @param other The other multiset to compare with.
+ * @return true if both multisets are equal, false otherwise.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+bool BasicMultiSet<T, Hash, Eq, Count, Derived>::operator==(const BasicMultiSet& other) const
+{
+    if (this == &other)
+    {
+        return true;
+    }
+    if (total_ != other.total_ || elements_.size() != other.elements_.size())
+    {
+        return false;
+    }
+    // Only compare hashes that are already cached, since computing one costs as much as comparing
+    std::size_t hash_this = hash_.Get();
+    std::size_t hash_other = other.hash_.Get();
+    if (hash_this != 0 && hash_other != 0 && hash_this != hash_other)
+    {
+        return false;
+    }
+
+    // Look every element up through the map, so that keys are compared with Eq rather than T's own operator==
+    for (const auto& el : elements_)
+    {
+        auto it = other.elements_.find(el.first);
+        if (it == other.elements_.end() || it->second != el.second)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Compares two multisets for inequality.
+ * @param other The other multiset to compare with.
+ * @return true if the multisets are not equal, false otherwise.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+bool BasicMultiSet<T, Hash, Eq, Count, Derived>::operator!=(const BasicMultiSet& other) const
+{
+    return !(*this == other);
+}
+
+/**
+ * @brief Checks whether this multiset is a sub-multiset of another one.
+ *
+ * A sub-multiset has no more occurrences and no more distinct elements.
+ * With as many of both it can only be the other multiset itself, so
+ * differing cached hashes settle the answer without a probe.
+ *
+ * @param other The other multiset.
+ * @return True if this multiset is a sub-multiset of the other one.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+bool BasicMultiSet<T, Hash, Eq, Count, Derived>::IsSubMultiSetOf(const BasicMultiSet& other) const
+{
+    if (this == &other)
+    {
+        return true;
+    }
+    if (total_ > other.total_ || elements_.size() > other.elements_.size())
+    {
+        return false;
+    }
+    if (total_ == other.total_ && elements_.size() == other.elements_.size())
+    {
+        std::size_t hash_this = hash_.Get();
+        std::size_t hash_other = other.hash_.Get();
+        if (hash_this != 0 && hash_other != 0 && hash_this != hash_other)
+        {
+            return false;
+        }
+    }
+
+    for (const auto& el : elements_)
+    {
+        auto it = other.elements_.find(el.first);
+        if (it == other.elements_.end() || it->second < el.second)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Checks whether two multisets have no element in common.
+ * @param other The other multiset.
+ * @return True if no element occurs in both multisets.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+bool BasicMultiSet<T, Hash, Eq, Count, Derived>::IsDisjoint(const BasicMultiSet& other) const
+{
+    if (elements_.empty() || other.elements_.empty())
+    {
+        return true;
+    }
+    if (this == &other)
+    {
+        return false;
+    }
+
+    const BasicMultiSet& larger = elements_.size() >= other.elements_.size() ? *this : other;
+    const BasicMultiSet& smaller = &larger == this ? other : *this;
+    for (const auto& el : smaller.elements_)
+    {
+        if (larger.elements_.find(el.first) != larger.elements_.end())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Computes the union of two multisets.
+ *
+ * The larger multiset is copied, which reuses its hashes, and every element of the smaller one is probed once.
+ *
+ * @param other The other multiset to unite with.
+ * @return A new multiset that is the union of the two multisets.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::operator+(const BasicMultiSet& other) const -> Self
+{
+    const BasicMultiSet& larger = elements_.size() >= other.elements_.size() ? *this : other;
+    const BasicMultiSet& smaller = &larger == this ? other : *this;
+
+    Self result = AsDerived().EmptyLike();
+    result.elements_ = larger.elements_;
+    result.total_ = larger.total_;
+    result.MergeMax(smaller);
+    return result;
+}
+
+/**
+ * @brief Adds elements from another multiset to this multiset (union).
+ * @param other The other multiset to add.
+ * @return A reference to the updated multiset.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::operator+=(const BasicMultiSet& other) -> Self&
+{
+    MergeMax(other);
+    return AsDerived();
+}
+
+/**
+ * @brief Computes the intersection of two multisets.
+ *
+ * Only the elements of the smaller multiset are looked up in the larger one, and the result is sized for them
+ * up front so that it is never rehashed while it grows.
+ *
+ * @param other The other multiset to intersect with.
+ * @return A new multiset that is the intersection of the two multisets.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::operator*(const BasicMultiSet& other) const -> Self
+{
+    const BasicMultiSet& smaller = elements_.size() <= other.elements_.size() ? *this : other;
+    const BasicMultiSet& larger = &smaller == this ? other : *this;
+
+    Self result = AsDerived().EmptyLike();
+    result.elements_.reserve(smaller.elements_.size());
+    for (const auto& elem : smaller.elements_)
+    {
+        auto it = larger.elements_.find(elem.first);
+        if (it != larger.elements_.end())
+        {
+            Count count = std::min(elem.second, it->second);
+            result.elements_.try_emplace(elem.first, count);
+            result.total_ += count;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Updates this multiset by intersecting it with another multiset.
+ *
+ * Elements are updated or erased in place, so each element of this multiset is hashed once.
+ *
+ * @param other The other multiset to intersect with.
+ * @return A reference to the updated multiset.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::operator*=(const BasicMultiSet& other) -> Self&
+{
+    for (auto it = elements_.begin(); it != elements_.end();)
+    {
+        auto other_it = other.elements_.find(it->first);
+        if (other_it == other.elements_.end())
+        {
+            total_ -= it->second;
+            it = elements_.erase(it);
+            continue;
+        }
+        if (other_it->second < it->second)
+        {
+            total_ -= it->second - other_it->second;
+            it->second = other_it->second;
+        }
+        ++it;
+    }
+    CountsChanged();
+    return AsDerived();
+}
+
+/**
+ * @brief Computes the difference of two multisets (this - other).
+ *
+ * Elements found only in the other multiset are kept with their count. This multiset is copied, which reuses
+ * its hashes, and every element of the other one is probed once.
+ *
+ * @param other The other multiset to subtract.
+ * @return A new multiset that represents the difference of the two multisets.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::operator-(const BasicMultiSet& other) const -> Self
+{
+    Self result = AsDerived().EmptyLike();
+    result.elements_ = elements_;
+    result.total_ = total_;
+    result.ApplyDifference(other);
+    return result;
+}
+
+/**
+ * @brief Updates this multiset by subtracting elements from another multiset.
+ * @param other The other multiset to subtract.
+ * @return A reference to the updated multiset.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::operator-=(const BasicMultiSet& other) -> Self&
+{
+    if (&other == this)
+    {
+        ClearElements();
+        return AsDerived();
+    }
+    ApplyDifference(other);
+    return AsDerived();
+}
+
+/**
+ * @brief Computes this multiset minus another one.
+ *
+ * This multiset is copied, which reuses its hashes, and the difference is applied to the copy in place.
+ *
+ * @param other The multiset to subtract.
+ * @return A new multiset holding the difference.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::Difference(const BasicMultiSet& other) const& -> Self
+{
+    Self result = AsDerived().EmptyLike();
+    if (&other != this)
+    {
+        result.elements_ = elements_;
+        result.total_ = total_;
+        result.DifferenceInPlace(other);
+    }
+    return result;
+}
+
+/**
+ * @brief Computes this multiset minus another one, reusing the storage of this multiset.
+ * @param other The multiset to subtract.
+ * @return The difference, built in the storage of this multiset.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::Difference(const BasicMultiSet& other) && -> Self
+{
+    // Moving from this multiset first would also empty other if they are the same object
+    if (&other == this)
+    {
+        return AsDerived().EmptyLike();
+    }
+    Self result(std::move(AsDerived()));
+    result.DifferenceInPlace(other);
+    return result;
+}
+
+/**
+ * @brief Subtracts another multiset from this one in place.
+ *
+ * The smaller of the two multisets is iterated and each of its elements is probed once in the larger one.
+ *
+ * @param other The multiset to subtract.
+ * @return A reference to this multiset after the difference.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::DifferenceInPlace(const BasicMultiSet& other) -> Self&
+{
+    if (&other == this)
+    {
+        ClearElements();
+        return AsDerived();
+    }
+
+    if (elements_.size() <= other.elements_.size())
+    {
+        for (auto it = elements_.begin(); it != elements_.end();)
+        {
+            auto other_it = other.elements_.find(it->first);
+            if (other_it == other.elements_.end())
+            {
+                ++it;
+            }
+            else if (it->second > other_it->second)
+            {
+                total_ -= other_it->second;
+                it->second -= other_it->second;
+                ++it;
+            }
+            else
+            {
+                total_ -= it->second;
+                it = elements_.erase(it);
+            }
+        }
+    }
+    else
+    {
+        for (const auto& el : other.elements_)
+        {
+            auto it = elements_.find(el.first);
+            if (it == elements_.end())
+            {
+                continue;
+            }
+            if (it->second > el.second)
+            {
+                total_ -= el.second;
+                it->second -= el.second;
+            }
+            else
+            {
+                total_ -= it->second;
+                elements_.erase(it);
+            }
+        }
+    }
+    CountsChanged();
+    return AsDerived();
+}
+
+/**
+ * @brief Computes the symmetric difference of two multisets.
+ *
+ * The larger multiset is copied, which reuses its hashes, and every element of the smaller one is probed once.
+ * The result uses the allocator of this multiset.
+ *
+ * @param other The other multiset.
+ * @return A new multiset holding the symmetric difference.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::SymmetricDifference(const BasicMultiSet& other) const& -> Self
+{
+    Self result = AsDerived().EmptyLike();
+    if (&other != this)
+    {
+        const BasicMultiSet& larger = elements_.size() >= other.elements_.size() ? *this : other;
+        const BasicMultiSet& smaller = &larger == this ? other : *this;
+        result.elements_ = larger.elements_;
+        result.total_ = larger.total_;
+        result.SymmetricDifferenceInPlace(smaller);
+    }
+    return result;
+}
+
+/**
+ * @brief Computes the symmetric difference, reusing the storage of this multiset.
+ * @param other The other multiset.
+ * @return The symmetric difference, built in the storage of this multiset.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::SymmetricDifference(const BasicMultiSet& other) && -> Self
+{
+    if (&other == this)
+    {
+        return AsDerived().EmptyLike();
+    }
+    Self result(std::move(AsDerived()));
+    result.SymmetricDifferenceInPlace(other);
+    return result;
+}
+
+/**
+ * @brief Replaces this multiset with its symmetric difference with another one.
+ *
+ * Each element of the other multiset is hashed and probed once.
+ *
+ * @param other The other multiset.
+ * @return A reference to this multiset after the symmetric difference.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::SymmetricDifferenceInPlace(const BasicMultiSet& other) -> Self&
+{
+    if (&other == this)
+    {
+        ClearElements();
+        return AsDerived();
+    }
+
+    for (const auto& el : other.elements_)
+    {
+        auto [it, inserted] = elements_.try_emplace(el.first, el.second);
+        if (inserted)
+        {
+            total_ += el.second;
+        }
+        else if (it->second > el.second)
+        {
+            total_ -= el.second;
+            it->second -= el.second;
+        }
+        else if (it->second < el.second)
+        {
+            total_ -= it->second;
+            it->second = el.second - it->second;
+            total_ += it->second;
+        }
+        else
+        {
+            total_ -= it->second;
+            elements_.erase(it);
+        }
+    }
+    CountsChanged();
+    return AsDerived();
+}
+
+/**
+ * @brief Computes the weighted Jaccard similarity with another multiset.
+ *
+ * Only the intersection size is accumulated, by probing the larger
+ * multiset with each element of the smaller one; the union size then
+ * follows from the sizes of both multisets.
+ *
+ * @param other The other multiset.
+ * @return The similarity in [0, 1], or 1 if both multisets are empty.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+double BasicMultiSet<T, Hash, Eq, Count, Derived>::WeightedJaccard(const BasicMultiSet& other) const
+{
+    if (total_ == 0 && other.total_ == 0)
+    {
+        return 1.0;
+    }
+
+    const BasicMultiSet& larger = elements_.size() >= other.elements_.size() ? *this : other;
+    const BasicMultiSet& smaller = &larger == this ? other : *this;
+    std::size_t intersection = 0;
+    for (const auto& el : smaller.elements_)
+    {
+        auto it = larger.elements_.find(el.first);
+        if (it != larger.elements_.end())
+        {
+            intersection += std::min(it->second, el.second);
+        }
+    }
+    return static_cast<double>(intersection) / static_cast<double>(total_ + other.total_ - intersection);
+}
+
+/**
+ * @brief Sets the elements of the multiset.
+ * @param elements A map of elements and their respective counts to set.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::SetElements(const ElementMap& elements)
+{
+    elements_ = elements;
+    ElementsChanged();
+}
+
+/**
+ * @brief Sets the elements of the multiset, taking ownership of the map.
+ * @param elements A map of elements and their respective counts to set.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::SetElements(ElementMap&& elements)
+{
+    elements_ = std::move(elements);
+    ElementsChanged();
+}
+
+/**
+ * @brief Retrieves the elements of the multiset.
+ * @return A constant reference to the map of elements and counts.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::GetElements() const -> const ElementMap&
+{
+    return elements_;
+}
+
+/**
+ * @brief Gets the entries sorted by CanonicalLess, sorting them on the first call after a modification.
+ *
+ * Readers that race on an empty cache each sort, and all but the first
+ * to publish discard their result.
+ *
+ * @return Pointers to the entries in canonical order.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::CanonicalEntries() const -> const std::vector<const Entry*>&
+{
+    if (const CanonicalCache* cached = canonical_.load(std::memory_order_acquire))
+    {
+        return *cached;
+    }
+
+    auto order = std::make_unique<CanonicalCache>();
+    order->reserve(elements_.size());
+    for (const auto& entry : elements_)
+    {
+        order->push_back(&entry);
+    }
+    CanonicalLess<T> less;
+    std::sort(order->begin(), order->end(),
+              [&less](const Entry* left, const Entry* right) { return less(left->first, right->first); });
+
+    const CanonicalCache* expected = nullptr;
+    if (canonical_.compare_exchange_strong(expected, order.get(), std::memory_order_acq_rel))
+    {
+        return *order.release();
+    }
+    return *expected;
+}
+
+/**
+ * @brief Compares two multisets in canonical order.
+ * @param other The other multiset.
+ * @return A negative value, zero or a positive value if this multiset orders before, with or after the other.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+int BasicMultiSet<T, Hash, Eq, Count, Derived>::CanonicalCompare(const BasicMultiSet& other) const
+{
+    if (this == &other)
+    {
+        return 0;
+    }
+    const CanonicalCache& left = CanonicalEntries();
+    const CanonicalCache& right = other.CanonicalEntries();
+    CanonicalLess<T> less;
+    const std::size_t common = std::min(left.size(), right.size());
+    for (std::size_t i = 0; i < common; ++i)
+    {
+        if (less(left[i]->first, right[i]->first))
+        {
+            return -1;
+        }
+        if (less(right[i]->first, left[i]->first))
+        {
+            return 1;
+        }
+        if (left[i]->second != right[i]->second)
+        {
+            return left[i]->second < right[i]->second ? -1 : 1;
+        }
+    }
+    if (left.size() != right.size())
+    {
+        return left.size() < right.size() ? -1 : 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Recomputes the total size and drops the cached hash after the elements were replaced.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::ElementsChanged()
+{
+    total_ = 0;
+    for (const auto& element : elements_)
+    {
+        total_ += element.second;
+    }
+    CountsChanged();
+}
+
+/**
+ * @brief Drops the cached hash and rebuilds the frequency index after counts were changed in bulk.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::CountsChanged()
+{
+    ResetCaches();
+    if (index_)
+    {
+        index_->Rebuild(elements_);
+    }
+}
+
+/**
+ * @brief Drops the cached hash and canonical order after a modification.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::ResetCaches()
+{
+    hash_.Reset();
+    DestroyCanonical();
+}
+
+/**
+ * @brief Frees the cached canonical order, if there is one.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::DestroyCanonical()
+{
+    delete canonical_.exchange(nullptr, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Resets the size and caches of a multiset whose elements were moved out.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::ResetMovedFrom()
+{
+    total_ = 0;
+    hash_.Reset();
+    DestroyCanonical();
+}
+
+/**
+ * @brief Allocates a frequency index from the given allocator.
+ *
+ * @param source The index to copy, or nullptr for an empty index.
+ * @param alloc The allocator for the index.
+ * @return The new index.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::NewIndex(const FrequencyIndexType* source,
+                                                          const allocator_type& alloc) -> FrequencyIndexType*
+{
+    std::pmr::polymorphic_allocator<FrequencyIndexType> index_alloc(alloc);
+    FrequencyIndexType* index = index_alloc.allocate(1);
+    try
+    {
+        if (source)
+        {
+            ::new (static_cast<void*>(index)) FrequencyIndexType(*source, alloc);
+        }
+        else
+        {
+            ::new (static_cast<void*>(index)) FrequencyIndexType(alloc);
+        }
+    }
+    catch (...)
+    {
+        index_alloc.deallocate(index, 1);
+        throw;
+    }
+    return index;
+}
+
+/**
+ * @brief Allocates a copy of a frequency index.
+ *
+ * @param index The index to copy, or nullptr.
+ * @param alloc The allocator for the copy.
+ * @return The copy, or nullptr if index is nullptr.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::CloneIndex(const FrequencyIndexType* index,
+                                                            const allocator_type& alloc) -> FrequencyIndexType*
+{
+    return index ? NewIndex(index, alloc) : nullptr;
+}
+
+/**
+ * @brief Frees the frequency index, if there is one.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::DestroyIndex()
+{
+    if (!index_)
+    {
+        return;
+    }
+    std::pmr::polymorphic_allocator<FrequencyIndexType> index_alloc(index_->get_allocator());
+    index_->~FrequencyIndexType();
+    index_alloc.deallocate(index_, 1);
+    index_ = nullptr;
+}
+
+/**
+ * @brief Raises the count of every element of another multiset in this one to at least its count there.
+ *
+ * Each element of the other multiset is hashed and probed once.
+ *
+ * @param other The multiset to merge in.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::MergeMax(const BasicMultiSet& other)
+{
+    for (const auto& el : other.elements_)
+    {
+        auto [it, inserted] = elements_.try_emplace(el.first, el.second);
+        if (inserted)
+        {
+            total_ += el.second;
+        }
+        else if (el.second > it->second)
+        {
+            total_ += el.second - it->second;
+            it->second = el.second;
+        }
+    }
+    CountsChanged();
+}
+
+/**
+ * @brief Subtracts the counts of another multiset and adds the elements found only there.
+ *
+ * Each element of the other multiset is hashed and probed once. The other multiset must not be this one.
+ *
+ * @param other The multiset to subtract.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::ApplyDifference(const BasicMultiSet& other)
+{
+    for (const auto& el : other.elements_)
+    {
+        auto [it, inserted] = elements_.try_emplace(el.first, el.second);
+        if (inserted)
+        {
+            total_ += el.second;
+        }
+        else if (it->second > el.second)
+        {
+            total_ -= el.second;
+            it->second -= el.second;
+        }
+        else
+        {
+            total_ -= it->second;
+            elements_.erase(it);
+        }
+    }
+    CountsChanged();
+}
+
+/**
+ * @brief Removes all elements from the multiset.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::ClearElements()
+{
+    elements_.clear();
+    total_ = 0;
+    CountsChanged();
+}
+
+/**
+ * @brief Adds the counts of another multiset to this one.
+ *
+ * Each element of the other multiset is hashed and probed once.
+ *
+ * @param other The multiset to add.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+void BasicMultiSet<T, Hash, Eq, Count, Derived>::AddCounts(const BasicMultiSet& other)
+{
+    for (const auto& el : other.elements_)
+    {
+        elements_.try_emplace(el.first, 0).first->second += el.second;
+        total_ += el.second;
+    }
+    CountsChanged();
+}
+
+/**
+ * @brief Computes the union of many multisets.
+ * @param first The first of a range of pointers to the multisets.
+ * @param last The end of the range.
+ * @param threads The number of threads to use.
+ * @return The union of the multisets.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+template <typename ForwardIt>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::UnionAll(ForwardIt first, ForwardIt last, std::size_t threads)
+    -> Self
+{
+    return ReduceAll(SetList(first, last), threads, &UnionRange);
+}
+
+/**
+ * @brief Computes the intersection of many multisets.
+ * @param first The first of a range of pointers to the multisets.
+ * @param last The end of the range.
+ * @param threads The number of threads to use.
+ * @return The intersection of the multisets.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+template <typename ForwardIt>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::IntersectAll(ForwardIt first, ForwardIt last, std::size_t threads)
+    -> Self
+{
+    return ReduceAll(SetList(first, last), threads, &IntersectRange);
+}
+
+/**
+ * @brief Computes the sum of many multisets.
+ * @param first The first of a range of pointers to the multisets.
+ * @param last The end of the range.
+ * @param threads The number of threads to use.
+ * @return The sum of the multisets.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+template <typename ForwardIt>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::SumAll(ForwardIt first, ForwardIt last, std::size_t threads) -> Self
+{
+    return ReduceAll(SetList(first, last), threads, &SumRange);
+}
+
+/**
+ * @brief Sequentially unites a non-empty range of multisets.
+ *
+ * The largest input is copied, which reuses its hashes, and the other inputs are merged into it. The copy is
+ * not reserved for the summed input sizes, which overlapping inputs would never fill; it grows as needed.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::UnionRange(const BasicMultiSet* const* first,
+                                                            const BasicMultiSet* const* last) -> Self
+{
+    const BasicMultiSet* const* largest = first;
+    for (auto it = first; it != last; ++it)
+    {
+        if ((*it)->elements_.size() > (*largest)->elements_.size())
+        {
+            largest = it;
+        }
+    }
+
+    Self result = (*first)->AsDerived().EmptyLike();
+    result.elements_ = (*largest)->elements_;
+    result.total_ = (*largest)->total_;
+    for (auto it = first; it != last; ++it)
+    {
+        if (it != largest)
+        {
+            result.MergeMax(**it);
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Sequentially intersects a non-empty range of multisets, smallest first.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::IntersectRange(const BasicMultiSet* const* first,
+                                                                const BasicMultiSet* const* last) -> Self
+{
+    SetList by_size(first, last);
+    std::sort(by_size.begin(), by_size.end(), [](const BasicMultiSet* left, const BasicMultiSet* right)
+              { return left->elements_.size() < right->elements_.size(); });
+
+    Self result = (*first)->AsDerived().EmptyLike();
+    result.elements_ = by_size.front()->elements_;
+    result.total_ = by_size.front()->total_;
+    for (std::size_t i = 1; i < by_size.size() && !result.elements_.empty(); ++i)
+    {
+        result *= *by_size[i];
+    }
+    return result;
+}
+
+/**
+ * @brief Sequentially sums a non-empty range of multisets.
+ *
+ * The result is sized for the largest input, which it holds at least, and grows as needed from there.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::SumRange(const BasicMultiSet* const* first,
+                                                          const BasicMultiSet* const* last) -> Self
+{
+    std::size_t largest = 0;
+    for (auto it = first; it != last; ++it)
+    {
+        largest = std::max(largest, (*it)->elements_.size());
+    }
+
+    Self result = (*first)->AsDerived().EmptyLike();
+    result.elements_.reserve(largest);
+    for (auto it = first; it != last; ++it)
+    {
+        result.AddCounts(**it);
+    }
+    return result;
+}
+
+/**
+ * @brief Reduces a list of multisets, optionally as a parallel tree reduction.
+ *
+ * The list is split into one chunk per thread, each chunk is reduced sequentially, and the partial results are
+ * reduced pairwise until one is left.
+ *
+ * @param sets The multisets to reduce.
+ * @param threads The number of threads to use.
+ * @param reduce The sequential reduction of a non-empty range.
+ * @return The reduced multiset, or an empty multiset if the list is empty.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+auto BasicMultiSet<T, Hash, Eq, Count, Derived>::ReduceAll(const SetList& sets, std::size_t threads,
+                                                           RangeReducer reduce) -> Self
+{
+    if (sets.empty())
+    {
+        return Self();
+    }
+#ifdef MULTISET_SINGLE_THREADED
+    threads = 1;
+#endif
+    threads = std::min(threads, sets.size() / 2);
+    if (threads <= 1)
+    {
+        return reduce(sets.data(), sets.data() + sets.size());
+    }
+
+    std::vector<std::optional<Self>> partials(threads);
+    multiset_detail::RunParallel(threads,
+                                 [&](std::size_t i)
+                                 {
+                                     std::size_t begin = sets.size() * i / threads;
+                                     std::size_t end = sets.size() * (i + 1) / threads;
+                                     partials[i].emplace(reduce(sets.data() + begin, sets.data() + end));
+                                 });
+
+    while (partials.size() > 1)
+    {
+        std::size_t pairs = partials.size() / 2;
+        std::vector<std::optional<Self>> next(pairs + partials.size() % 2);
+        multiset_detail::RunParallel(pairs,
+                                     [&](std::size_t i)
+                                     {
+                                         const BasicMultiSet* pair[] = {&*partials[2 * i], &*partials[2 * i + 1]};
+                                         next[i].emplace(reduce(pair, pair + 2));
+                                     });
+        if (partials.size() % 2 != 0)
+        {
+            next.back() = std::move(partials.back());
+        }
+        partials = std::move(next);
+    }
+    return std::move(*partials.front());
+}
+
+namespace multiset_detail
+{
+/**
+ * @brief Gets the stream word that selects canonical output.
+ */
+inline int CanonicalOutputIndex()
+{
+    static const int index = std::ios_base::xalloc();
+    return index;
+}
+}  // namespace multiset_detail
+
+/**
+ * @brief Stream manipulator that makes multisets, including nested ones, write their elements in canonical order.
+ *
+ * Equal multisets then write identical bytes, whatever order their hash
+ * tables iterate in. The order is cached per multiset, so repeated
+ * canonical output costs about as much as hash-order output.
+ *
+ * @param os The output stream.
+ * @return The output stream.
+ */
+inline std::ostream& CanonicalOrder(std::ostream& os)
+{
+    os.iword(multiset_detail::CanonicalOutputIndex()) = 1;
+    return os;
+}
+
+/**
+ * @brief Stream manipulator that restores the default output in hash-table order.
+ *
+ * @param os The output stream.
+ * @return The output stream.
+ */
+inline std::ostream& HashOrder(std::ostream& os)
+{
+    os.iword(multiset_detail::CanonicalOutputIndex()) = 0;
+    return os;
+}
+
+/**
+ * @brief Checks whether a stream writes multisets in canonical order.
+ *
+ * @param os The output stream.
+ * @return True if CanonicalOrder is in effect.
+ */
+inline bool IsCanonicalOrder(std::ostream& os) { return os.iword(multiset_detail::CanonicalOutputIndex()) != 0; }
+
+/**
+ * @brief Calls visit(entry) for every entry of a multiset in the order selected on an output stream.
+ *
+ * @param os The output stream.
+ * @param multiset The multiset.
+ * @param visit The visitor.
+ */
+template <typename Set, typename Visitor>
+void ForEachInOutputOrder(std::ostream& os, const Set& multiset, Visitor&& visit)
+{
+    if (IsCanonicalOrder(os))
+    {
+        for (const auto* entry : multiset.CanonicalEntries())
+        {
+            visit(*entry);
+        }
+    }
+    else
+    {
+        for (const auto& entry : multiset.GetElements())
+        {
+            visit(entry);
+        }
+    }
+}
+
+// Output operator for BasicMultiSet
+/**
+ * @brief Overloads the output stream operator for BasicMultiSet.
+ *
+ * This operator writes the contents of a multiset to the output stream,
+ * formatted as a comma-separated list of elements enclosed in braces.
+ * Elements come in hash-table order unless CanonicalOrder was applied
+ * to the stream.
+ *
+ * @param os The output stream to write to.
+ * @param multiset The multiset to output.
+ * @return The modified output stream.
+ */
+template <typename T, typename Hash, typename Eq, typename Count, typename Derived>
+std::ostream& operator<<(std::ostream& os, const BasicMultiSet<T, Hash, Eq, Count, Derived>& multiset)
+{
+    os << "{";
+    bool first = true;
+    ForEachInOutputOrder(os, multiset,
+                         [&](const auto& elem)
+                         {
+                             for (Count i = 0; i < elem.second; ++i)
+                             {
+                                 if (!first)
+                                 {
+                                     os << ", ";
+                                 }
+                                 first = false;
+                                 os << elem.first;
+                             }
+                         });
+    os << "}";
+    return os;
+}
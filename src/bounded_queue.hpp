@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Bounded lock-free queue between one producer thread and one consumer thread.
+ *
+ * The queue is a ring of capacity + 1 slots with a head index written only
+ * by the consumer and a tail index written only by the producer, so each
+ * operation is a few loads and one release store with no lock or
+ * read-modify-write. A full queue makes Push() wait and an empty one makes
+ * Pop() wait, which bounds the memory held between pipeline stages and
+ * lets a fast stage run ahead of a slow one by at most capacity items.
+ * Waiting spins briefly, then yields, then sleeps, so a stage blocked on
+ * I/O does not keep a core busy.
+ *
+ * Either side may Close() the queue. The consumer still drains the items
+ * pushed before, and Push() fails once the queue is closed and full, which
+ * is how a consumer that stops early releases its producer.
+ *
+ * @tparam T The item type, which must be default-constructible and movable.
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+    /**
+     * @brief Constructs an empty queue.
+     *
+     * @param capacity The number of items the queue holds at most; at least one.
+     */
+    explicit BoundedQueue(std::size_t capacity) : slots_(capacity + 1) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * @brief Appends an item, waiting while the queue is full. Called by the producer only.
+     *
+     * @param item The item to append.
+     * @return True if the item was appended, false if the queue was closed while full.
+     */
+    bool Push(T item)
+    {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        std::size_t next = Next(tail);
+        for (int attempt = 0; next == head_.load(std::memory_order_acquire); ++attempt)
+        {
+            if (closed_.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            Wait(attempt);
+        }
+        slots_[tail] = std::move(item);
+        tail_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest item, waiting while the queue is empty. Called by the consumer only.
+     *
+     * @param item Receives the item.
+     * @return True if an item was removed, false if the queue is closed and drained.
+     */
+    bool Pop(T& item)
+    {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+        for (int attempt = 0; head == tail_.load(std::memory_order_acquire); ++attempt)
+        {
+            // Items pushed before Close() are visible once the closed flag is
+            if (closed_.load(std::memory_order_acquire) && head == tail_.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            Wait(attempt);
+        }
+        item = std::move(slots_[head]);
+        slots_[head] = T();  // Release the slot's resources now rather than when it is reused
+        head_.store(Next(head), std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Closes the queue; no item can be appended once it is full.
+     */
+    void Close() { closed_.store(true, std::memory_order_release); }
+
+private:
+    std::size_t Next(std::size_t index) const { return index + 1 == slots_.size() ? 0 : index + 1; }
+
+    static void Wait(int attempt)
+    {
+        if (attempt < 64)
+        {
+            return;
+        }
+        if (attempt < 128)
+        {
+            std::this_thread::yield();
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    std::vector<T> slots_;
+    // Each index has its own cache line, so the two threads do not invalidate each other's line on every operation
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0};
+    std::atomic<bool> closed_{false};
+};
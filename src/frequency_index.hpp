@@ -0,0 +1,372 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <list>
+#include <memory_resource>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Index of elements bucketed by their count, in the style of an LFU cache.
+ *
+ * Each distinct count has a bucket holding the elements with that count,
+ * and the buckets form a list ordered by increasing count. Incrementing
+ * or decrementing the count of an element moves it to the neighbouring
+ * bucket, creating or dropping buckets as needed, in O(1). Queries walk
+ * the buckets from the highest count down, so a threshold query only
+ * visits buckets it reports.
+ *
+ * The index keeps its own copy of each element. Hash and Eq are
+ * default-constructed where needed.
+ *
+ * @tparam T The element type.
+ * @tparam Count The type of the per-element counts.
+ * @tparam Hash The hash functor for elements.
+ * @tparam Eq The equality functor for elements.
+ */
+template <typename T, typename Count, typename Hash, typename Eq>
+class FrequencyIndex
+{
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    explicit FrequencyIndex(const allocator_type& alloc = {}) : buckets_(alloc), positions_(alloc) {}
+
+    /**
+     * @brief Copies an index, using the given allocator.
+     *
+     * @param other The index to copy.
+     * @param alloc The allocator to use for the copy.
+     */
+    FrequencyIndex(const FrequencyIndex& other, const allocator_type& alloc) : FrequencyIndex(alloc)
+    {
+        for (const auto& bucket : other.buckets_)
+        {
+            auto target = buckets_.emplace(buckets_.end(), bucket.count, alloc);
+            for (const auto& element : bucket.elements)
+            {
+                auto node = target->elements.insert(target->elements.end(), element);
+                positions_.emplace(&*node, Position{target, node});
+            }
+        }
+    }
+
+    // Positions refer into the bucket list, so copies must go through the rebuilding constructor. Moving the
+    // containers keeps their nodes, and with them the positions, valid.
+    FrequencyIndex(const FrequencyIndex&) = delete;
+    FrequencyIndex(FrequencyIndex&&) = default;
+
+    /**
+     * @brief Replaces the contents with a copy of another index, keeping this index's allocator.
+     *
+     * @param other The index to copy.
+     * @return A reference to this index.
+     */
+    FrequencyIndex& operator=(const FrequencyIndex& other)
+    {
+        if (this != &other)
+        {
+            *this = FrequencyIndex(other, get_allocator());
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Takes over the contents of another index, keeping this index's allocator.
+     *
+     * The nodes are taken over if the allocators compare equal. Otherwise
+     * the containers would move element by element into new nodes, so the
+     * index is rebuilt as a copy instead.
+     *
+     * @param other The index to move from.
+     * @return A reference to this index.
+     */
+    FrequencyIndex& operator=(FrequencyIndex&& other)
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+        if (get_allocator() != other.get_allocator())
+        {
+            return *this = static_cast<const FrequencyIndex&>(other);
+        }
+        buckets_ = std::move(other.buckets_);
+        positions_ = std::move(other.positions_);
+        return *this;
+    }
+
+    allocator_type get_allocator() const { return buckets_.get_allocator(); }
+
+    /**
+     * @brief Gets the number of distinct elements in the index.
+     */
+    std::size_t size() const { return positions_.size(); }
+
+    /**
+     * @brief Gets the count of an element.
+     *
+     * @param element The element to look up.
+     * @return The count, or zero if the element is not in the index.
+     */
+    Count Get(const T& element) const
+    {
+        auto it = positions_.find(&element);
+        return it == positions_.end() ? Count() : it->second.bucket->count;
+    }
+
+    /**
+     * @brief Gets the smallest count in the index.
+     *
+     * @return The smallest count, or zero if the index is empty.
+     */
+    Count MinCount() const { return buckets_.empty() ? Count() : buckets_.front().count; }
+
+    /**
+     * @brief Adds occurrences of an element.
+     *
+     * The element moves up past the buckets with counts below its new
+     * count, so adding one occurrence is O(1) and adding more costs one
+     * step per distinct count skipped.
+     *
+     * @param element The element whose count grows.
+     * @param by The positive number of occurrences to add.
+     */
+    void Increment(const T& element, Count by = 1)
+    {
+        auto it = positions_.find(&element);
+        if (it == positions_.end())
+        {
+            auto bucket = FindBucket(buckets_.begin(), by);
+            bucket->elements.push_back(element);
+            positions_.emplace(&bucket->elements.back(), Position{bucket, std::prev(bucket->elements.end())});
+            return;
+        }
+
+        Position& position = it->second;
+        Move(position, FindBucket(std::next(position.bucket), position.bucket->count + by));
+    }
+
+    /**
+     * @brief Removes one occurrence of an element, dropping it when its count reaches zero.
+     *
+     * @param element An element that is in the index.
+     */
+    void Decrement(const T& element)
+    {
+        auto it = positions_.find(&element);
+        if (it == positions_.end())
+        {
+            return;
+        }
+
+        Position& position = it->second;
+        if (position.bucket->count == 1)
+        {
+            auto bucket = position.bucket;
+            auto node = position.element;
+            positions_.erase(it);
+            bucket->elements.erase(node);
+            if (bucket->elements.empty())
+            {
+                buckets_.erase(bucket);
+            }
+            return;
+        }
+
+        auto previous = position.bucket;
+        if (previous == buckets_.begin() || (--previous)->count != position.bucket->count - 1)
+        {
+            previous = buckets_.emplace(position.bucket, position.bucket->count - 1, get_allocator());
+        }
+        Move(position, previous);
+    }
+
+    /**
+     * @brief Replaces an element with the smallest count by a new element, which then gets one more occurrence.
+     *
+     * The new element takes over the count of the evicted one, as the
+     * Space-Saving algorithm requires. The index must not be empty and
+     * must not contain the new element.
+     *
+     * @param element The element to insert.
+     * @return The evicted element.
+     */
+    T ReplaceLeastFrequent(const T& element)
+    {
+        auto bucket = buckets_.begin();
+        auto node = bucket->elements.begin();
+        positions_.erase(&*node);
+        T evicted = std::move(*node);
+        *node = element;
+        positions_.emplace(&*node, Position{bucket, node});
+        Increment(*node);
+        return evicted;
+    }
+
+    /**
+     * @brief Replaces the contents of the index with the given (element, count) entries.
+     *
+     * @param entries A range of pairs of an element and its positive count.
+     */
+    template <typename Range>
+    void Rebuild(const Range& entries)
+    {
+        positions_.clear();
+        buckets_.clear();
+
+        std::vector<std::pair<Count, const T*>> by_count;
+        for (const auto& entry : entries)
+        {
+            by_count.emplace_back(entry.second, &entry.first);
+        }
+        std::sort(by_count.begin(), by_count.end(),
+                  [](const auto& left, const auto& right) { return left.first < right.first; });
+
+        positions_.reserve(by_count.size());
+        for (const auto& entry : by_count)
+        {
+            if (buckets_.empty() || buckets_.back().count != entry.first)
+            {
+                buckets_.emplace_back(entry.first, get_allocator());
+            }
+            auto bucket = std::prev(buckets_.end());
+            bucket->elements.push_back(*entry.second);
+            positions_.emplace(&bucket->elements.back(), Position{bucket, std::prev(bucket->elements.end())});
+        }
+    }
+
+    /**
+     * @brief Calls visit(element, count) for every element whose count is at least the threshold.
+     *
+     * Elements are visited by decreasing count.
+     *
+     * @param threshold The smallest count to report.
+     * @param visit The visitor.
+     */
+    template <typename Visitor>
+    void ForEachAtLeast(Count threshold, Visitor&& visit) const
+    {
+        for (auto bucket = buckets_.rbegin(); bucket != buckets_.rend() && bucket->count >= threshold; ++bucket)
+        {
+            for (const auto& element : bucket->elements)
+            {
+                visit(element, bucket->count);
+            }
+        }
+    }
+
+    /**
+     * @brief Calls visit(element, count) for every element whose count lies in [low, high].
+     *
+     * Elements are visited by decreasing count. Buckets above high are
+     * skipped one by one, so the cost also grows with the number of
+     * distinct counts above high.
+     *
+     * @param low The smallest count to report.
+     * @param high The largest count to report.
+     * @param visit The visitor.
+     */
+    template <typename Visitor>
+    void ForEachInRange(Count low, Count high, Visitor&& visit) const
+    {
+        for (auto bucket = buckets_.rbegin(); bucket != buckets_.rend() && bucket->count >= low; ++bucket)
+        {
+            if (bucket->count > high)
+            {
+                continue;
+            }
+            for (const auto& element : bucket->elements)
+            {
+                visit(element, bucket->count);
+            }
+        }
+    }
+
+    /**
+     * @brief Counts the distinct elements whose count lies in [low, high].
+     *
+     * Only bucket sizes are summed, so the cost is one step per distinct
+     * count of at least low.
+     *
+     * @param low The smallest count to include.
+     * @param high The largest count to include.
+     * @return The number of distinct elements.
+     */
+    std::size_t CountInRange(Count low, Count high) const
+    {
+        std::size_t result = 0;
+        for (auto bucket = buckets_.rbegin(); bucket != buckets_.rend() && bucket->count >= low; ++bucket)
+        {
+            if (bucket->count <= high)
+            {
+                result += bucket->elements.size();
+            }
+        }
+        return result;
+    }
+
+private:
+    struct Bucket
+    {
+        Bucket(Count bucket_count, const allocator_type& alloc) : count(bucket_count), elements(alloc) {}
+
+        Count count;
+        std::pmr::list<T> elements;
+    };
+
+    using BucketList = std::pmr::list<Bucket>;
+
+    struct Position
+    {
+        typename BucketList::iterator bucket;
+        typename std::pmr::list<T>::iterator element;
+    };
+
+    // Elements are keyed by the address of their copy in a bucket, which list splicing keeps stable
+    struct PointeeHash
+    {
+        std::size_t operator()(const T* element) const { return Hash()(*element); }
+    };
+
+    struct PointeeEqual
+    {
+        bool operator()(const T* left, const T* right) const { return Eq()(*left, *right); }
+    };
+
+    /**
+     * @brief Finds the bucket for a count at or after the given one, creating it if needed.
+     */
+    typename BucketList::iterator FindBucket(typename BucketList::iterator bucket, Count count)
+    {
+        while (bucket != buckets_.end() && bucket->count < count)
+        {
+            ++bucket;
+        }
+        if (bucket == buckets_.end() || bucket->count != count)
+        {
+            bucket = buckets_.emplace(bucket, count, get_allocator());
+        }
+        return bucket;
+    }
+
+    /**
+     * @brief Moves an element to another bucket and drops its old bucket if that became empty.
+     */
+    void Move(Position& position, typename BucketList::iterator target)
+    {
+        auto source = position.bucket;
+        target->elements.splice(target->elements.end(), source->elements, position.element);
+        position.bucket = target;
+        if (source->elements.empty())
+        {
+            buckets_.erase(source);
+        }
+    }
+
+    BucketList buckets_;
+    std::pmr::unordered_map<const T*, Position, PointeeHash, PointeeEqual> positions_;
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Hashing primitives shared by the multiset classes.
+//
+// HashString is a wyhash-style byte hash: it consumes 16 to 48 bytes per
+// step and mixes with 64x64->128-bit multiplications. MixHash is a strong
+// 64-bit finalizer for values whose own hash is weak, such as std::hash of
+// integers, which is the identity. Hash values are not stable across
+// platforms and must not be persisted.
+
+namespace hash_detail
+{
+constexpr std::uint64_t kSecret0 = 0xa0761d6478bd642full;
+constexpr std::uint64_t kSecret1 = 0xe7037ed1a0b428dbull;
+constexpr std::uint64_t kSecret2 = 0x8ebc6af09c88c6e3ull;
+constexpr std::uint64_t kSecret3 = 0x589965cc75374cc3ull;
+
+/**
+ * @brief Multiplies two 64-bit values and folds the 128-bit product.
+ */
+inline std::uint64_t Mum(std::uint64_t a, std::uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = static_cast<__uint128_t>(a) * b;
+    return static_cast<std::uint64_t>(product) ^ static_cast<std::uint64_t>(product >> 64);
+#else
+    std::uint64_t a_hi = a >> 32, a_lo = static_cast<std::uint32_t>(a);
+    std::uint64_t b_hi = b >> 32, b_lo = static_cast<std::uint32_t>(b);
+    std::uint64_t hh = a_hi * b_hi, hl = a_hi * b_lo, lh = a_lo * b_hi, ll = a_lo * b_lo;
+    std::uint64_t mid = (ll >> 32) + static_cast<std::uint32_t>(hl) + static_cast<std::uint32_t>(lh);
+    std::uint64_t lo = (mid << 32) | static_cast<std::uint32_t>(ll);
+    std::uint64_t hi = hh + (hl >> 32) + (lh >> 32) + (mid >> 32);
+    return lo ^ hi;
+#endif
+}
+
+inline std::uint64_t Read8(const unsigned char* p)
+{
+    std::uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline std::uint64_t Read4(const unsigned char* p)
+{
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline std::uint64_t Read3(const unsigned char* p, std::size_t len)
+{
+    return (static_cast<std::uint64_t>(p[0]) << 16) | (static_cast<std::uint64_t>(p[len >> 1]) << 8) | p[len - 1];
+}
+}  // namespace hash_detail
+
+/**
+ * @brief Mixes a 64-bit value so that every input bit affects every output bit.
+ *
+ * @param value The value to mix.
+ * @return The mixed value.
+ */
+inline std::uint64_t MixHash(std::uint64_t value)
+{
+    return hash_detail::Mum(value ^ hash_detail::kSecret0, hash_detail::kSecret1 ^ (value >> 32));
+}
+
+/**
+ * @brief Hashes a byte string.
+ *
+ * @param text The bytes to hash.
+ * @param seed A seed to derive independent hash functions from.
+ * @return The hash value.
+ */
+inline std::uint64_t HashString(std::string_view text, std::uint64_t seed = 0)
+{
+    using namespace hash_detail;
+
+    const auto* p = reinterpret_cast<const unsigned char*>(text.data());
+    std::size_t len = text.size();
+    std::uint64_t a = 0;
+    std::uint64_t b = 0;
+
+    seed ^= Mum(seed ^ kSecret0, kSecret1);
+    if (len <= 16)
+    {
+        if (len >= 4)
+        {
+            std::size_t shift = (len >> 3) << 2;
+            a = (Read4(p) << 32) | Read4(p + shift);
+            b = (Read4(p + len - 4) << 32) | Read4(p + len - 4 - shift);
+        }
+        else if (len > 0)
+        {
+            a = Read3(p, len);
+        }
+    }
+    else
+    {
+        std::size_t remaining = len;
+        if (remaining > 48)
+        {
+            std::uint64_t seed1 = seed;
+            std::uint64_t seed2 = seed;
+            do
+            {
+                seed = Mum(Read8(p) ^ kSecret1, Read8(p + 8) ^ seed);
+                seed1 = Mum(Read8(p + 16) ^ kSecret2, Read8(p + 24) ^ seed1);
+                seed2 = Mum(Read8(p + 32) ^ kSecret3, Read8(p + 40) ^ seed2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (remaining > 16)
+        {
+            seed = Mum(Read8(p) ^ kSecret1, Read8(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+        a = Read8(p + remaining - 16);
+        b = Read8(p + remaining - 8);
+    }
+    return Mum(kSecret1 ^ len, Mum(a ^ kSecret1, b ^ seed));
+}
+
+/**
+ * @brief Combines the hash of one element and its count into an entry hash.
+ *
+ * Entry hashes are meant to be summed: addition is commutative, so the
+ * result does not depend on iteration order, and unlike XOR equal
+ * entry hashes do not cancel out.
+ *
+ * @param element_hash The hash of the element.
+ * @param count The number of occurrences of the element.
+ * @return The hash of the (element, count) entry.
+ */
+inline std::uint64_t HashEntry(std::uint64_t element_hash, std::uint64_t count)
+{
+    return MixHash(element_hash + MixHash(count));
+}
@@ -0,0 +1,149 @@
+#include "heavy_hitters_multiset.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+/**
+ * @brief Constructs an empty summary.
+ * @param capacity The largest number of elements to track.
+ * @param alloc The allocator to use for the tracked elements.
+ */
+HeavyHittersMultiSet::HeavyHittersMultiSet(std::size_t capacity, const allocator_type& alloc)
+    : capacity_(capacity), index_(alloc), errors_(alloc)
+{
+    if (capacity == 0)
+    {
+        throw std::invalid_argument("Heavy hitters capacity must be positive");
+    }
+}
+
+/**
+ * @brief Copies a summary, using the given allocator.
+ * @param other The summary to copy.
+ * @param alloc The allocator to use for the copy.
+ */
+HeavyHittersMultiSet::HeavyHittersMultiSet(const HeavyHittersMultiSet& other, const allocator_type& alloc)
+    : capacity_(other.capacity_), total_(other.total_), index_(other.index_, alloc), errors_(other.errors_, alloc)
+{
+}
+
+/**
+ * @brief Adds one occurrence of an element, evicting the least frequent element if the summary is full.
+ * @param element The element to add.
+ */
+void HeavyHittersMultiSet::AddElement(const Element& element)
+{
+    ++total_;
+    if (!IsFull() || index_.Get(element) != 0)
+    {
+        index_.Increment(element);
+        return;
+    }
+
+    std::int64_t error = index_.MinCount();
+    errors_.erase(index_.ReplaceLeastFrequent(element));
+    errors_[element] = error;
+}
+
+/**
+ * @brief Gets the largest possible overestimate in the count of an element.
+ * @param element The element to look up.
+ * @return The error of the count.
+ */
+std::int64_t HeavyHittersMultiSet::Error(const Element& element) const
+{
+    auto it = errors_.find(element);
+    return it == errors_.end() ? 0 : it->second;
+}
+
+/**
+ * @brief Gets the most frequent tracked elements.
+ * @param k The number of elements to return.
+ * @return Up to k pairs of an element and its estimated count, ordered by decreasing count.
+ */
+std::vector<std::pair<const HeavyHittersMultiSet::Element*, std::int64_t>> HeavyHittersMultiSet::TopK(
+    std::size_t k) const
+{
+    std::vector<std::pair<const Element*, std::int64_t>> result;
+    result.reserve(std::min(k, index_.size()));
+    index_.ForEachAtLeast(1, [&](const Element& element, std::int64_t count) {
+        if (result.size() < k)
+        {
+            result.emplace_back(&element, count);
+        }
+    });
+    return result;
+}
+
+/**
+ * @brief Merges two summaries into a new one that uses the allocator of this summary.
+ * @param other The summary to merge with.
+ * @return A new summary of the concatenated streams.
+ */
+HeavyHittersMultiSet HeavyHittersMultiSet::operator+(const HeavyHittersMultiSet& other) const
+{
+    HeavyHittersMultiSet result(*this, get_allocator());
+    result += other;
+    return result;
+}
+
+/**
+ * @brief Merges another summary into this one.
+ * @param other The summary to merge.
+ * @return A reference to this summary.
+ */
+HeavyHittersMultiSet& HeavyHittersMultiSet::operator+=(const HeavyHittersMultiSet& other)
+{
+    if (capacity_ != other.capacity_)
+    {
+        throw std::invalid_argument("Heavy hitters summaries with different capacities cannot be merged");
+    }
+
+    // An element a full summary does not track may still have occurred as often as its least frequent element
+    const std::int64_t floor = IsFull() ? index_.MinCount() : 0;
+    const std::int64_t other_floor = other.IsFull() ? other.index_.MinCount() : 0;
+
+    // Merged (count, error) per element
+    std::pmr::unordered_map<Element, std::pair<std::int64_t, std::int64_t>, VariantHash, VariantEqual> merged(
+        get_allocator());
+    merged.reserve(index_.size() + other.index_.size());
+    index_.ForEachAtLeast(1, [&](const Element& element, std::int64_t count) {
+        merged.emplace(element, std::make_pair(count + other_floor, Error(element) + other_floor));
+    });
+    other.index_.ForEachAtLeast(1, [&](const Element& element, std::int64_t count) {
+        auto [it, inserted] = merged.try_emplace(element, count + floor, other.Error(element) + floor);
+        if (!inserted)
+        {
+            it->second.first += count - other_floor;
+            it->second.second += other.Error(element) - other_floor;
+        }
+    });
+
+    std::vector<decltype(merged)::iterator> kept;
+    kept.reserve(merged.size());
+    for (auto it = merged.begin(); it != merged.end(); ++it)
+    {
+        kept.push_back(it);
+    }
+    if (kept.size() > capacity_)
+    {
+        std::nth_element(kept.begin(), kept.begin() + capacity_, kept.end(),
+                         [](const auto& left, const auto& right) { return left->second.first > right->second.first; });
+        kept.resize(capacity_);
+    }
+
+    std::vector<std::pair<Element, std::int64_t>> entries;
+    entries.reserve(kept.size());
+    errors_.clear();
+    for (auto it : kept)
+    {
+        entries.emplace_back(it->first, it->second.first);
+        if (it->second.second != 0)
+        {
+            errors_.emplace(it->first, it->second.second);
+        }
+    }
+    index_.Rebuild(entries);
+    total_ += other.total_;
+    return *this;
+}
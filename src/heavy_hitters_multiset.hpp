@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "frequency_index.hpp"
+#include "multiset.hpp"
+
+/**
+ * @brief Bounded-memory multiset that tracks the most frequent elements of a stream with Space-Saving.
+ *
+ * At most Capacity() elements are tracked, each with a counter kept in
+ * a FrequencyIndex. A new element takes over the counter of the least
+ * frequent tracked element, whose count becomes the error of the new
+ * one. Every update is O(1) and each element is hashed with
+ * VariantHash.
+ *
+ * Count() never underestimates a tracked element and overestimates it
+ * by at most Error(), which is at most Size() / Capacity(). Every
+ * element occurring more than Size() / Capacity() times is tracked.
+ *
+ * A summary is not synchronized. To count a stream on several threads,
+ * give each thread its own summary and merge them with + afterwards;
+ * the merged summary keeps the same guarantees for the combined stream.
+ */
+class HeavyHittersMultiSet
+{
+public:
+    using Element = MultiSet::Element;
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    /**
+     * @brief Constructs an empty summary.
+     *
+     * @param capacity The largest number of elements to track.
+     * @param alloc The allocator to use for the tracked elements.
+     * @throws std::invalid_argument If capacity is zero.
+     */
+    explicit HeavyHittersMultiSet(std::size_t capacity, const allocator_type& alloc = {});
+
+    /**
+     * @brief Copies a summary, using the given allocator.
+     *
+     * @param other The summary to copy.
+     * @param alloc The allocator to use for the copy.
+     */
+    HeavyHittersMultiSet(const HeavyHittersMultiSet& other, const allocator_type& alloc = {});
+
+    HeavyHittersMultiSet(HeavyHittersMultiSet&&) = default;
+
+    HeavyHittersMultiSet& operator=(const HeavyHittersMultiSet&) = default;
+
+    HeavyHittersMultiSet& operator=(HeavyHittersMultiSet&&) = default;
+
+    /**
+     * @brief Gets the allocator used by the summary.
+     *
+     * @return The allocator of the summary.
+     */
+    allocator_type get_allocator() const { return index_.get_allocator(); }
+
+    /**
+     * @brief Adds one occurrence of an element.
+     *
+     * @param element The element to add.
+     */
+    void AddElement(const Element& element);
+
+    /**
+     * @brief Estimates the number of occurrences of an element.
+     *
+     * @param element The element to look up.
+     * @return An upper bound on the count of a tracked element, or zero if the element is not tracked.
+     */
+    std::int64_t Count(const Element& element) const { return index_.Get(element); }
+
+    /**
+     * @brief Gets the largest possible overestimate in the count of an element.
+     *
+     * @param element The element to look up.
+     * @return The error of the count, so Count(element) - Error(element) is a lower bound.
+     */
+    std::int64_t Error(const Element& element) const;
+
+    /**
+     * @brief Gets the most frequent tracked elements.
+     *
+     * @param k The number of elements to return.
+     * @return Up to k pairs of an element and its estimated count, ordered by decreasing count.
+     */
+    std::vector<std::pair<const Element*, std::int64_t>> TopK(std::size_t k) const;
+
+    /**
+     * @brief Gets the total number of occurrences added, which is exact.
+     *
+     * @return The length of the summarized stream.
+     */
+    std::int64_t Size() const { return total_; }
+
+    std::size_t Capacity() const { return capacity_; }
+
+    /**
+     * @brief Checks whether the summary tracks as many elements as it can.
+     *
+     * @return True if adding a new element evicts a tracked one.
+     */
+    bool IsFull() const { return index_.size() == capacity_; }
+
+    /**
+     * @brief Merges two summaries, summarizing the concatenation of their streams.
+     *
+     * @param other The summary to merge with.
+     * @return A new summary that uses the allocator of this summary.
+     * @throws std::invalid_argument If the capacities differ.
+     */
+    HeavyHittersMultiSet operator+(const HeavyHittersMultiSet& other) const;
+
+    /**
+     * @brief Merges another summary into this one.
+     *
+     * An element missing from a full summary may have occurred up to the
+     * smallest count of that summary, so that count is added to both its
+     * count and its error. The Capacity() largest merged counts are kept.
+     *
+     * @param other The summary to merge.
+     * @return A reference to this summary.
+     * @throws std::invalid_argument If the capacities differ.
+     */
+    HeavyHittersMultiSet& operator+=(const HeavyHittersMultiSet& other);
+
+private:
+    std::size_t capacity_;
+    std::int64_t total_ = 0;
+    FrequencyIndex<Element, std::int64_t, VariantHash, VariantEqual> index_;
+    // Errors of the tracked elements that replaced an evicted one; all others are exact
+    std::pmr::unordered_map<Element, std::int64_t, VariantHash, VariantEqual> errors_;
+};
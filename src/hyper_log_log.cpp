@@ -0,0 +1,295 @@
+#include "hyper_log_log.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "hash.hpp"
+
+namespace
+{
+constexpr std::uint8_t kFormatVersion = 1;
+constexpr int kRegisterBits = 6;
+constexpr std::size_t kMergeBlock = 16;
+static_assert((std::size_t{1} << HyperLogLog::kMinPrecision) % kMergeBlock == 0, "merge blocks must tile registers");
+
+/**
+ * @brief Counts the leading zero bits of a non-zero value.
+ */
+int CountLeadingZeros(std::uint64_t value)
+{
+#if defined(__GNUC__)
+    return __builtin_clzll(value);
+#else
+    int zeros = 0;
+    for (std::uint64_t bit = 1ull << 63; (value & bit) == 0; bit >>= 1)
+    {
+        ++zeros;
+    }
+    return zeros;
+#endif
+}
+
+// Helper series of Ertl's improved estimator ("New cardinality estimation algorithms for HyperLogLog sketches")
+double Sigma(double x)
+{
+    if (x == 1.0)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    double y = 1.0;
+    double z = x;
+    double previous;
+    do
+    {
+        x *= x;
+        previous = z;
+        z += x * y;
+        y += y;
+    } while (z != previous);
+    return z;
+}
+
+double Tau(double x)
+{
+    if (x == 0.0 || x == 1.0)
+    {
+        return 0.0;
+    }
+    double y = 1.0;
+    double z = 1.0 - x;
+    double previous;
+    do
+    {
+        x = std::sqrt(x);
+        previous = z;
+        y *= 0.5;
+        z -= (1.0 - x) * (1.0 - x) * y;
+    } while (z != previous);
+    return z / 3.0;
+}
+}  // namespace
+
+/**
+ * @brief Constructs an empty summary with 2^precision registers.
+ * @param precision The base-2 logarithm of the number of registers.
+ * @param alloc The allocator to use for the registers.
+ */
+HyperLogLog::HyperLogLog(int precision, const allocator_type& alloc) : precision_(precision), registers_(alloc)
+{
+    if (precision < kMinPrecision || precision > kMaxPrecision)
+    {
+        throw std::invalid_argument("HyperLogLog precision must lie in [4, 18]");
+    }
+    registers_.assign(std::size_t{1} << precision, 0);
+}
+
+/**
+ * @brief Builds a summary of the distinct elements of a MultiSet.
+ * @param multiset The multiset to summarize.
+ * @param precision The base-2 logarithm of the number of registers.
+ * @param alloc The allocator to use for the registers.
+ * @return The summary.
+ */
+HyperLogLog HyperLogLog::FromMultiSet(const MultiSet& multiset, int precision, const allocator_type& alloc)
+{
+    HyperLogLog summary(precision, alloc);
+    summary.AddMultiSet(multiset);
+    return summary;
+}
+
+/**
+ * @brief Reads a summary written by Serialize().
+ * @param bytes The serialized summary.
+ * @param alloc The allocator to use for the registers.
+ * @return The summary.
+ */
+HyperLogLog HyperLogLog::Deserialize(std::string_view bytes, const allocator_type& alloc)
+{
+    if (bytes.size() < 2 || static_cast<std::uint8_t>(bytes[0]) != kFormatVersion)
+    {
+        throw std::runtime_error("Unsupported HyperLogLog format");
+    }
+    int precision = static_cast<std::uint8_t>(bytes[1]);
+    if (precision < kMinPrecision || precision > kMaxPrecision)
+    {
+        throw std::runtime_error("Invalid HyperLogLog precision");
+    }
+
+    HyperLogLog summary(precision, alloc);
+    std::size_t packed_size = (summary.registers_.size() * kRegisterBits + 7) / 8;
+    if (bytes.size() != 2 + packed_size)
+    {
+        throw std::runtime_error("Truncated HyperLogLog registers");
+    }
+
+    const auto max_rank = static_cast<std::uint8_t>(64 - precision + 1);
+    std::uint32_t buffer = 0;
+    int buffered = 0;
+    std::size_t next = 2;
+    for (auto& value : summary.registers_)
+    {
+        if (buffered < kRegisterBits)
+        {
+            buffer |= static_cast<std::uint32_t>(static_cast<std::uint8_t>(bytes[next++])) << buffered;
+            buffered += 8;
+        }
+        value = static_cast<std::uint8_t>(buffer & ((1u << kRegisterBits) - 1));
+        buffer >>= kRegisterBits;
+        buffered -= kRegisterBits;
+        if (value > max_rank)
+        {
+            throw std::runtime_error("Invalid HyperLogLog register");
+        }
+    }
+    return summary;
+}
+
+/**
+ * @brief Adds an element.
+ * @param element The element to add.
+ */
+void HyperLogLog::AddElement(const Element& element) { AddHash(VariantHash{}(element)); }
+
+/**
+ * @brief Adds a string element, hashed as VariantHash hashes strings.
+ * @param text The string to add.
+ */
+void HyperLogLog::AddString(std::string_view text) { AddHash(HashString(text)); }
+
+/**
+ * @brief Adds all distinct elements of a MultiSet; counts do not matter.
+ * @param multiset The multiset whose elements to add.
+ */
+void HyperLogLog::AddMultiSet(const MultiSet& multiset)
+{
+    for (const auto& element : multiset.GetElements())
+    {
+        AddElement(element.first);
+    }
+}
+
+/**
+ * @brief Estimates the number of distinct elements from the histogram of register values.
+ * @return The estimated number of distinct elements.
+ */
+double HyperLogLog::Estimate() const
+{
+    const int rank_bits = 64 - precision_;
+    std::vector<std::uint32_t> histogram(rank_bits + 2, 0);
+    for (std::uint8_t value : registers_)
+    {
+        ++histogram[value];
+    }
+
+    const auto m = static_cast<double>(registers_.size());
+    double z = m * Tau(1.0 - histogram[rank_bits + 1] / m);
+    for (int k = rank_bits; k >= 1; --k)
+    {
+        z = 0.5 * (z + histogram[k]);
+    }
+    z += m * Sigma(histogram[0] / m);
+    return 0.5 / std::log(2.0) * m * m / z;
+}
+
+/**
+ * @brief Computes the summary of the union of two summarized sets.
+ * @param other The summary to unite with.
+ * @return A new summary of the union, using the allocator of this summary.
+ */
+HyperLogLog HyperLogLog::operator+(const HyperLogLog& other) const
+{
+    HyperLogLog result(precision_, get_allocator());
+    result.registers_ = registers_;
+    result += other;
+    return result;
+}
+
+/**
+ * @brief Merges another summary into this one by taking the register-wise maximum.
+ * @param other The summary to merge.
+ * @return A reference to this summary.
+ */
+HyperLogLog& HyperLogLog::operator+=(const HyperLogLog& other)
+{
+    if (!IsCompatible(other))
+    {
+        throw std::invalid_argument("HyperLogLog summaries with different precisions cannot be merged");
+    }
+    // Branch-free byte-wise maximum over blocks of 16 registers, which compilers turn into one vector max per
+    // block (pmaxub on x86, umax on ARM) even at -O2. Copying each block into locals rules out aliasing between
+    // the two summaries, and the register count is always a multiple of 16.
+    std::uint8_t* target = registers_.data();
+    const std::uint8_t* source = other.registers_.data();
+    const std::size_t size = registers_.size();
+    for (std::size_t block = 0; block < size; block += kMergeBlock)
+    {
+        std::uint8_t merged[kMergeBlock];
+        std::uint8_t incoming[kMergeBlock];
+        std::memcpy(merged, target + block, kMergeBlock);
+        std::memcpy(incoming, source + block, kMergeBlock);
+        for (std::size_t i = 0; i < kMergeBlock; ++i)
+        {
+            merged[i] = std::max(merged[i], incoming[i]);
+        }
+        std::memcpy(target + block, merged, kMergeBlock);
+    }
+    return *this;
+}
+
+/**
+ * @brief Checks whether two summaries have the same precision and registers.
+ * @param other The summary to compare with.
+ * @return True if the summaries are equal.
+ */
+bool HyperLogLog::operator==(const HyperLogLog& other) const
+{
+    return precision_ == other.precision_ && std::equal(registers_.begin(), registers_.end(), other.registers_.begin());
+}
+
+/**
+ * @brief Writes the summary to a byte string.
+ * @return The serialized summary.
+ */
+std::string HyperLogLog::Serialize() const
+{
+    std::string bytes;
+    bytes.reserve(2 + (registers_.size() * kRegisterBits + 7) / 8);
+    bytes.push_back(static_cast<char>(kFormatVersion));
+    bytes.push_back(static_cast<char>(precision_));
+
+    std::uint32_t buffer = 0;
+    int buffered = 0;
+    for (std::uint8_t value : registers_)
+    {
+        buffer |= static_cast<std::uint32_t>(value) << buffered;
+        buffered += kRegisterBits;
+        while (buffered >= 8)
+        {
+            bytes.push_back(static_cast<char>(buffer & 0xff));
+            buffer >>= 8;
+            buffered -= 8;
+        }
+    }
+    if (buffered > 0)
+    {
+        bytes.push_back(static_cast<char>(buffer & 0xff));
+    }
+    return bytes;
+}
+
+/**
+ * @brief Updates the register selected by the top bits of the hash with the rank of the remaining bits.
+ * @param hash The element hash.
+ */
+void HyperLogLog::AddHash(std::uint64_t hash)
+{
+    // Mix once more so that the index and the rank bits stay independent even for weak element hashes
+    hash = MixHash(hash);
+    std::size_t index = hash >> (64 - precision_);
+    std::uint64_t rest = hash << precision_;
+    auto rank = static_cast<std::uint8_t>(rest == 0 ? 64 - precision_ + 1 : CountLeadingZeros(rest) + 1);
+    registers_[index] = std::max(registers_[index], rank);
+}
@@ -0,0 +1,245 @@
+#include "ingestion_pipeline.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "bounded_queue.hpp"
+
+namespace
+{
+/**
+ * @brief Whole lines read from the stream, with the stream offset of their first byte.
+ */
+struct Block
+{
+    std::string text;
+    std::size_t offset = 0;
+};
+
+/**
+ * @brief The records and errors of one block; error positions are relative to the block.
+ */
+struct ParsedBlock
+{
+    std::vector<MultiSet> records;
+    std::vector<ParseResult> errors;
+    std::size_t offset = 0;
+    std::size_t newlines = 0;
+};
+
+template <typename T>
+using QueueList = std::vector<std::unique_ptr<BoundedQueue<T>>>;
+
+template <typename T>
+QueueList<T> MakeQueues(std::size_t count, std::size_t capacity)
+{
+    QueueList<T> queues;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        queues.push_back(std::make_unique<BoundedQueue<T>>(capacity));
+    }
+    return queues;
+}
+
+template <typename T>
+void CloseAll(QueueList<T>& queues)
+{
+    for (auto& queue : queues)
+    {
+        queue->Close();
+    }
+}
+
+/**
+ * @brief Reader stage: cuts the stream into blocks after the last newline and deals them to the parsers in turn.
+ * @param input The stream to read.
+ * @param block_size The number of bytes to request at a time.
+ * @param queues The input queues of the parsers.
+ */
+void ReadBlocks(std::istream& input, std::size_t block_size, QueueList<Block>& queues)
+{
+    std::string pending;
+    std::size_t offset = 0;
+    std::size_t turn = 0;
+    // Sends the first length bytes of pending and keeps the rest, which is at most one partial line
+    auto send = [&](std::size_t length)
+    {
+        Block block{std::move(pending), offset};
+        pending = block.text.substr(length);
+        block.text.resize(length);
+        offset += length;
+        return queues[turn++ % queues.size()]->Push(std::move(block));
+    };
+
+    while (input)
+    {
+        std::size_t size = pending.size();
+        pending.resize(size + block_size);
+        input.read(&pending[size], static_cast<std::streamsize>(block_size));
+        pending.resize(size + static_cast<std::size_t>(input.gcount()));
+
+        std::size_t last_newline = pending.rfind('\n');
+        if (last_newline != std::string::npos && !send(last_newline + 1))
+        {
+            return;
+        }
+    }
+    if (!pending.empty())
+    {
+        send(pending.size());
+    }
+}
+
+/**
+ * @brief Parser stage: parses each block of its input queue into its output queue.
+ * @param blocks The blocks to parse.
+ * @param parsed Where to send the parsed blocks.
+ */
+void ParseBlocks(BoundedQueue<Block>& blocks, BoundedQueue<ParsedBlock>& parsed)
+{
+    Block block;
+    while (blocks.Pop(block))
+    {
+        ParsedBlock result;
+        result.offset = block.offset;
+        result.newlines = static_cast<std::size_t>(std::count(block.text.begin(), block.text.end(), '\n'));
+        ForEachRecord(
+            block.text, [&result](MultiSet&& set) { result.records.push_back(std::move(set)); },
+            [&result](const ParseResult& error) { result.errors.push_back(error); });
+        if (!parsed.Push(std::move(result)))
+        {
+            return;
+        }
+    }
+}
+}  // namespace
+
+/**
+ * @brief Reads records from a stream through a reader thread, parser threads and the calling thread.
+ * @param input The stream to read.
+ * @param sink Called with each record.
+ * @param options The pipeline settings.
+ * @param errors Where to report malformed records, or nullptr to throw on the first one.
+ * @return The number of records passed to the sink.
+ */
+std::size_t IngestRecords(std::istream& input, const std::function<void(MultiSet&&)>& sink,
+                          const IngestOptions& options, std::vector<ParseResult>* errors)
+{
+    if (options.block_size == 0 || options.queue_capacity == 0 || options.parser_threads == 0)
+    {
+        throw std::invalid_argument("Ingestion block size, queue capacity and parser threads must be positive");
+    }
+
+    const std::size_t parsers = options.parser_threads;
+    QueueList<Block> blocks = MakeQueues<Block>(parsers, options.queue_capacity);
+    QueueList<ParsedBlock> parsed = MakeQueues<ParsedBlock>(parsers, options.queue_capacity);
+
+    // Slot 0 is the calling thread, slot 1 the reader and the rest the parsers. A stage that ends, normally or
+    // not, closes its queues on both sides, which lets its neighbours finish as well.
+    std::vector<std::exception_ptr> failures(parsers + 2);
+    std::vector<std::thread> workers;
+    std::size_t records = 0;
+    try
+    {
+        workers.emplace_back(
+            [&]
+            {
+                try
+                {
+                    ReadBlocks(input, options.block_size, blocks);
+                }
+                catch (...)
+                {
+                    failures[1] = std::current_exception();
+                }
+                CloseAll(blocks);
+            });
+        for (std::size_t i = 0; i < parsers; ++i)
+        {
+            workers.emplace_back(
+                [&, i]
+                {
+                    try
+                    {
+                        ParseBlocks(*blocks[i], *parsed[i]);
+                    }
+                    catch (...)
+                    {
+                        failures[i + 2] = std::current_exception();
+                    }
+                    blocks[i]->Close();
+                    parsed[i]->Close();
+                });
+        }
+
+        // Blocks come back in the order the reader dealt them
+        std::size_t lines = 0;
+        ParsedBlock block;
+        for (std::size_t turn = 0; parsed[turn % parsers]->Pop(block); ++turn)
+        {
+            for (const ParseResult& error : block.errors)
+            {
+                ParseResult result{error.error, block.offset + error.offset, lines + error.line};
+                if (errors == nullptr)
+                {
+                    throw std::runtime_error(DescribeParseFailure(result));
+                }
+                errors->push_back(result);
+            }
+            lines += block.newlines;
+            for (MultiSet& record : block.records)
+            {
+                sink(std::move(record));
+                ++records;
+            }
+        }
+    }
+    catch (...)
+    {
+        failures[0] = std::current_exception();
+    }
+
+    // Also releases the reader if a parser thread could not be started
+    CloseAll(blocks);
+    CloseAll(parsed);
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    for (const auto& failure : failures)
+    {
+        if (failure)
+        {
+            std::rethrow_exception(failure);
+        }
+    }
+    return records;
+}
+
+/**
+ * @brief Sums the records of a stream with the ingestion pipeline.
+ * @param input The stream to read.
+ * @param options The pipeline settings.
+ * @param errors Where to report malformed records, or nullptr to throw on the first one.
+ * @return The sum of the records.
+ */
+MultiSet IngestSum(std::istream& input, const IngestOptions& options, std::vector<ParseResult>* errors)
+{
+    MultiSet sum;
+    IngestRecords(
+        input,
+        [&sum](MultiSet&& record)
+        {
+            for (const auto& [element, count] : record.GetElements())
+            {
+                sum.AddElement(element, count);
+            }
+        },
+        options, errors);
+    return sum;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <vector>
+
+#include "multiset.hpp"
+#include "multiset_parser.hpp"
+
+/**
+ * @brief Settings of the ingestion pipeline.
+ */
+struct IngestOptions
+{
+    /// The number of bytes the reader requests from the stream at a time.
+    std::size_t block_size = std::size_t{1} << 20;
+    /// The number of blocks each queue between two stages holds at most.
+    std::size_t queue_capacity = 4;
+    /// The number of threads parsing blocks.
+    std::size_t parser_threads = 1;
+};
+
+/**
+ * @brief Reads records from a stream through a reader, parser and aggregator pipeline.
+ *
+ * The stream holds one multiset per line. A reader thread reads it in
+ * blocks cut after the last complete line, parser threads turn blocks
+ * into MultiSets with ForEachRecord(), and the calling thread passes the
+ * records to the sink in input order. The stages are connected by
+ * BoundedQueues, so reading, parsing and aggregation overlap while at
+ * most a few blocks per stage are held in memory. Blocks are dealt to the
+ * parsers in turn and collected in the same turn, which keeps every queue
+ * single-producer and single-consumer.
+ *
+ * Given an error list, malformed records are skipped and reported there
+ * in input order, with offsets and lines relative to the whole stream.
+ * Records cannot span lines: a record left open at the end of a block
+ * is reported as ParseError::kUnexpectedEnd.
+ *
+ * An exception thrown by the sink or a stage stops the pipeline and is
+ * rethrown once all threads have finished.
+ *
+ * @param input The stream to read.
+ * @param sink Called on the calling thread with each record as an rvalue.
+ * @param options The pipeline settings.
+ * @param errors Where to report malformed records, or nullptr to throw on the first one.
+ * @return The number of records passed to the sink.
+ * @throws std::invalid_argument If the block size, queue capacity or number of parser threads is zero.
+ * @throws std::runtime_error If a record is malformed and no error list is given; the message gives its position.
+ */
+std::size_t IngestRecords(std::istream& input, const std::function<void(MultiSet&&)>& sink,
+                          const IngestOptions& options = {}, std::vector<ParseResult>* errors = nullptr);
+
+/**
+ * @brief Sums the records of a stream with the ingestion pipeline.
+ *
+ * The aggregator adds each record to the sum as it arrives, so no record
+ * is kept once it has been counted. Parameters are as for IngestRecords().
+ *
+ * @param input The stream to read.
+ * @param options The pipeline settings.
+ * @param errors Where to report malformed records, or nullptr to throw on the first one.
+ * @return The sum of the records.
+ */
+MultiSet IngestSum(std::istream& input, const IngestOptions& options = {}, std::vector<ParseResult>* errors = nullptr);
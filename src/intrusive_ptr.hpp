@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+/**
+ * @brief Non-atomic reference counter.
+ *
+ * Used when the counted objects are never shared between threads.
+ * Increments and decrements are plain integer operations.
+ */
+class NonAtomicRefCount
+{
+public:
+    void Increment() noexcept { ++count_; }
+
+    std::uint32_t Decrement() noexcept { return --count_; }
+
+    std::uint32_t Get() const noexcept { return count_; }
+
+private:
+    std::uint32_t count_ = 0;
+};
+
+/**
+ * @brief Atomic reference counter.
+ *
+ * Safe to use when the counted objects are shared between threads.
+ */
+class AtomicRefCount
+{
+public:
+    void Increment() noexcept { count_.fetch_add(1, std::memory_order_relaxed); }
+
+    std::uint32_t Decrement() noexcept { return count_.fetch_sub(1, std::memory_order_acq_rel) - 1; }
+
+    std::uint32_t Get() const noexcept { return count_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<std::uint32_t> count_{0};
+};
+
+#ifdef MULTISET_SINGLE_THREADED
+using DefaultRefCount = NonAtomicRefCount;
+#else
+using DefaultRefCount = AtomicRefCount;
+#endif
+
+/**
+ * @brief Base class that embeds a reference count into the derived object.
+ *
+ * Objects deriving from this class can be owned by IntrusivePtr, which
+ * needs no separate control block. Copying an object does not copy its
+ * reference count. When the last reference is released the object is
+ * destroyed through Derived::DestroyIntrusive, which defaults to delete
+ * and may be hidden by the derived class (a private one requires the
+ * derived class to befriend this base).
+ *
+ * @tparam Derived The derived class.
+ * @tparam Counter The counter type, NonAtomicRefCount or AtomicRefCount.
+ */
+template <typename Derived, typename Counter = DefaultRefCount>
+class IntrusiveRefCounted
+{
+public:
+    /**
+     * @brief Gets the number of IntrusivePtr handles owning the object.
+     *
+     * @return The current reference count.
+     */
+    std::uint32_t UseCount() const noexcept { return refs_.Get(); }
+
+    friend void IntrusiveAddRef(const Derived* ptr) noexcept { ptr->refs_.Increment(); }
+
+    friend void IntrusiveRelease(const Derived* ptr) noexcept { Release(ptr); }
+
+protected:
+    IntrusiveRefCounted() noexcept = default;
+    IntrusiveRefCounted(const IntrusiveRefCounted&) noexcept {}
+    IntrusiveRefCounted& operator=(const IntrusiveRefCounted&) noexcept { return *this; }
+    ~IntrusiveRefCounted() = default;
+
+    static void DestroyIntrusive(Derived* ptr) noexcept { delete ptr; }
+
+private:
+    static void Release(const Derived* ptr) noexcept
+    {
+        if (ptr->refs_.Decrement() == 0)
+        {
+            Derived::DestroyIntrusive(const_cast<Derived*>(ptr));
+        }
+    }
+
+    mutable Counter refs_;
+};
+
+/**
+ * @brief Smart pointer that owns an object through its embedded reference count.
+ *
+ * The pointee must provide IntrusiveAddRef and IntrusiveRelease functions
+ * found by argument-dependent lookup, as IntrusiveRefCounted does.
+ *
+ * @tparam T The type of the pointee.
+ */
+template <typename T>
+class IntrusivePtr
+{
+public:
+    using element_type = T;
+
+    IntrusivePtr() noexcept = default;
+
+    IntrusivePtr(std::nullptr_t) noexcept {}
+
+    /**
+     * @brief Takes a reference to the given object.
+     *
+     * @param ptr The object to reference, or nullptr.
+     */
+    explicit IntrusivePtr(T* ptr) noexcept : ptr_(ptr)
+    {
+        if (ptr_)
+        {
+            IntrusiveAddRef(ptr_);
+        }
+    }
+
+    IntrusivePtr(const IntrusivePtr& other) noexcept : IntrusivePtr(other.ptr_) {}
+
+    IntrusivePtr(IntrusivePtr&& other) noexcept : ptr_(std::exchange(other.ptr_, nullptr)) {}
+
+    ~IntrusivePtr()
+    {
+        if (ptr_)
+        {
+            IntrusiveRelease(ptr_);
+        }
+    }
+
+    IntrusivePtr& operator=(const IntrusivePtr& other) noexcept
+    {
+        IntrusivePtr(other).swap(*this);
+        return *this;
+    }
+
+    IntrusivePtr& operator=(IntrusivePtr&& other) noexcept
+    {
+        IntrusivePtr(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    void swap(IntrusivePtr& other) noexcept { std::swap(ptr_, other.ptr_); }
+
+    void reset() noexcept { IntrusivePtr().swap(*this); }
+
+    T* get() const noexcept { return ptr_; }
+
+    T& operator*() const noexcept { return *ptr_; }
+
+    T* operator->() const noexcept { return ptr_; }
+
+    explicit operator bool() const noexcept { return ptr_ != nullptr; }
+
+    friend bool operator==(const IntrusivePtr& lhs, const IntrusivePtr& rhs) noexcept { return lhs.ptr_ == rhs.ptr_; }
+
+    friend bool operator!=(const IntrusivePtr& lhs, const IntrusivePtr& rhs) noexcept { return lhs.ptr_ != rhs.ptr_; }
+
+private:
+    T* ptr_ = nullptr;
+};
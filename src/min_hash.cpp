@@ -0,0 +1,140 @@
+#include "min_hash.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "hash.hpp"
+
+namespace
+{
+// Odd step between the seeds of consecutive hash functions
+constexpr std::uint64_t kHashStep = 0x9e3779b97f4a7c15ull;
+constexpr std::size_t kCompareBlock = 16;
+
+/**
+ * @brief Maps a hash to a uniform double in (0, 1).
+ */
+double Uniform(std::uint64_t hash) { return (static_cast<double>(hash >> 11) + 0.5) * 0x1.0p-53; }
+
+/**
+ * @brief Draws a Gamma(2, 1) variable from two hashes.
+ */
+double Gamma2(std::uint64_t first, std::uint64_t second) { return -std::log(Uniform(first) * Uniform(second)); }
+}  // namespace
+
+/**
+ * @brief Constructs a hasher.
+ * @param num_hashes The number of hash functions.
+ * @param mode Whether counts are taken into account.
+ * @param seed A seed to derive the hash functions from.
+ */
+MinHash::MinHash(std::size_t num_hashes, Mode mode, std::uint64_t seed)
+    : num_hashes_(num_hashes), mode_(mode), seed_(seed)
+{
+    if (num_hashes == 0)
+    {
+        throw std::invalid_argument("MinHash needs at least one hash function");
+    }
+}
+
+/**
+ * @brief Estimates the similarity of two multisets from their signatures.
+ * @param left The signature of one multiset.
+ * @param right The signature of the other multiset.
+ * @return The fraction of positions where the signatures agree.
+ */
+double MinHash::Similarity(const Signature& left, const Signature& right)
+{
+    if (left.size() != right.size())
+    {
+        throw std::invalid_argument("MinHash signatures of different lengths cannot be compared");
+    }
+    return Similarity(left.data(), right.data(), left.size());
+}
+
+/**
+ * @brief Estimates the similarity of two multisets from signatures stored elsewhere.
+ * @param x The first value of the signature of one multiset.
+ * @param y The first value of the signature of the other multiset.
+ * @param size The length of both signatures.
+ * @return The fraction of positions where the signatures agree.
+ */
+double MinHash::Similarity(const std::uint32_t* x, const std::uint32_t* y, std::size_t size)
+{
+    if (size == 0)
+    {
+        return 1.0;
+    }
+
+    // Fixed-size blocks with a branch-free match count, which compilers turn into vector compares even at -O2
+    std::size_t matches = 0;
+    std::size_t i = 0;
+    for (; i + kCompareBlock <= size; i += kCompareBlock)
+    {
+        std::uint32_t block_matches = 0;
+        for (std::size_t j = 0; j < kCompareBlock; ++j)
+        {
+            block_matches += x[i + j] == y[i + j];
+        }
+        matches += block_matches;
+    }
+    for (; i < size; ++i)
+    {
+        matches += x[i] == y[i];
+    }
+    return static_cast<double>(matches) / static_cast<double>(size);
+}
+
+/**
+ * @brief Updates every position of a signature with one element.
+ *
+ * In kWeighted mode each position draws r, c ~ Gamma(2, 1) and beta ~
+ * U(0, 1) from the element hash, quantizes ln(count) to the step
+ * t = floor(ln(count) / r + beta) and keeps the element and step with
+ * the smallest key c / exp(r * (t - beta + 1)), compared in log space.
+ *
+ * @param hash The element hash.
+ * @param count The number of occurrences of the element.
+ * @param signature The signature to update.
+ * @param keys The smallest key seen at each position, for kWeighted mode.
+ */
+void MinHash::AddElement(std::uint64_t hash, std::uint64_t count, Signature& signature,
+                         std::vector<double>& keys) const
+{
+    // Mix once more so that weak element hashes, such as std::hash of integers, give independent hash functions
+    hash = MixHash(hash);
+    if (mode_ == Mode::kSet)
+    {
+        for (std::size_t k = 0; k < num_hashes_; ++k)
+        {
+            auto value = static_cast<std::uint32_t>(MixHash(hash ^ (seed_ + (k + 1) * kHashStep)) >> 32);
+            signature[k] = std::min(signature[k], value);
+        }
+        return;
+    }
+
+    const double log_count = std::log(static_cast<double>(count));
+    for (std::size_t k = 0; k < num_hashes_; ++k)
+    {
+        // Chain the draws through MixHash; mixing nearby inputs such as base + 1 and base + 2 gives correlated values
+        std::uint64_t base = MixHash(hash ^ (seed_ + (k + 1) * kHashStep));
+        std::uint64_t draws[5];
+        draws[0] = MixHash(base);
+        for (std::size_t i = 1; i < 5; ++i)
+        {
+            draws[i] = MixHash(draws[i - 1]);
+        }
+        double r = Gamma2(draws[0], draws[1]);
+        double c = Gamma2(draws[2], draws[3]);
+        double beta = Uniform(draws[4]);
+        double t = std::floor(log_count / r + beta);
+        double log_key = std::log(c) - r * (t - beta + 1.0);
+        if (log_key < keys[k])
+        {
+            keys[k] = log_key;
+            auto step = static_cast<std::uint64_t>(static_cast<std::int64_t>(t));
+            signature[k] = static_cast<std::uint32_t>(MixHash(base ^ MixHash(step)) >> 32);
+        }
+    }
+}
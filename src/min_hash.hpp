@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/**
+ * @brief Computes MinHash signatures of multisets for estimating Jaccard similarity.
+ *
+ * A signature holds one 32-bit value per hash function. The fraction of
+ * positions where two signatures agree estimates the similarity of the
+ * multisets, with a standard error of about 1 / sqrt(NumHashes()).
+ *
+ * In kSet mode counts are ignored and the estimate is the Jaccard
+ * similarity of the distinct elements. In kWeighted mode each position
+ * is a consistent weighted sample (Ioffe's ICWS) and the estimate is
+ * the weighted Jaccard similarity that BasicMultiSet::WeightedJaccard()
+ * computes exactly. Either way every element is hashed once with the
+ * hash functor of the multiset and the cost is one step per distinct
+ * element and hash function.
+ *
+ * Signatures are only comparable if they were computed by hashers with
+ * the same number of hash functions, mode and seed.
+ */
+class MinHash
+{
+public:
+    using Signature = std::vector<std::uint32_t>;
+
+    /**
+     * @brief Which similarity signatures estimate.
+     */
+    enum class Mode
+    {
+        kSet,
+        kWeighted
+    };
+
+    /**
+     * @brief Constructs a hasher.
+     *
+     * @param num_hashes The number of hash functions, which is the length of the signatures.
+     * @param mode Whether counts are taken into account.
+     * @param seed A seed to derive the hash functions from.
+     * @throws std::invalid_argument If num_hashes is zero.
+     */
+    explicit MinHash(std::size_t num_hashes, Mode mode = Mode::kWeighted, std::uint64_t seed = 0);
+
+    std::size_t NumHashes() const { return num_hashes_; }
+
+    Mode GetMode() const { return mode_; }
+
+    std::uint64_t Seed() const { return seed_; }
+
+    /**
+     * @brief Computes the signature of a multiset.
+     *
+     * @param set A BasicMultiSet or a class derived from one.
+     * @return The signature.
+     */
+    template <typename Set>
+    Signature Compute(const Set& set) const
+    {
+        Signature signature(num_hashes_, std::numeric_limits<std::uint32_t>::max());
+        std::vector<double> keys;
+        if (mode_ == Mode::kWeighted)
+        {
+            keys.assign(num_hashes_, std::numeric_limits<double>::infinity());
+        }
+        typename Set::HashType hash;
+        for (const auto& entry : set.GetElements())
+        {
+            AddElement(static_cast<std::uint64_t>(hash(entry.first)), static_cast<std::uint64_t>(entry.second),
+                       signature, keys);
+        }
+        return signature;
+    }
+
+    /**
+     * @brief Estimates the similarity of two multisets from their signatures.
+     *
+     * @param left The signature of one multiset.
+     * @param right The signature of the other multiset.
+     * @return The fraction of positions where the signatures agree.
+     * @throws std::invalid_argument If the signatures have different lengths.
+     */
+    static double Similarity(const Signature& left, const Signature& right);
+
+    /**
+     * @brief Estimates the similarity of two multisets from signatures stored elsewhere.
+     *
+     * @param left The first value of the signature of one multiset.
+     * @param right The first value of the signature of the other multiset.
+     * @param size The length of both signatures.
+     * @return The fraction of positions where the signatures agree, or 1 if size is zero.
+     */
+    static double Similarity(const std::uint32_t* left, const std::uint32_t* right, std::size_t size);
+
+private:
+    void AddElement(std::uint64_t hash, std::uint64_t count, Signature& signature, std::vector<double>& keys) const;
+
+    std::size_t num_hashes_;
+    Mode mode_;
+    std::uint64_t seed_;
+};
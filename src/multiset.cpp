@@ -1,46 +1,34 @@
 #include "multiset.hpp"
 
+#include "hash.hpp"
+
+
 // Hash functions
 
 /**
  * @brief Computes a hash value for a MultiSet.
  *
- * This function iterates over each element of the MultiSet, hashes the element and its count,
- * and combines these hashes using XOR and shifting to produce a single hash value.
+ * This function returns the structural hash of the MultiSet, which hashes each element together with its count
+ * and sums the entry hashes. The sum is commutative, so the result does not depend on iteration order, and unlike
+ * XOR it does not cancel equal entry hashes out. The value is cached by the MultiSet until it is modified.
  *
  * @param ms The MultiSet to hash.
  * @return The computed hash value.
  */
-std::size_t MultiSetHash::operator()(const MultiSet& ms) const
-{
-    std::size_t hash_value = 0;
-
-    for (const auto& elem : ms.GetElements())
-    {
-        // Hash the element (variant) using VariantHash
-        std::size_t element_hash = std::visit(VariantHash{}, elem.first);
-
-        // Hash the count of the element
-        std::size_t count_hash = std::hash<int>{}(elem.second);
-
-        // Combine hashes (XOR with shifting)
-        hash_value ^= element_hash ^ (count_hash << 1);
-    }
-
-    return hash_value;
-}
+std::size_t MultiSetHash::operator()(const MultiSet& ms) const { return ms.StructuralHash(); }
 
 /**
- * @brief Computes a hash value for a std::variant containing either a string or a shared_ptr to MultiSet.
+ * @brief Computes a hash value for a std::variant containing a string, a handle to a MultiSet or a Symbol.
  *
  * This function dispatches the hashing based on the type contained in the variant. If the variant holds
- * a string, it hashes it using std::hash. If it holds a shared_ptr to MultiSet, it hashes the MultiSet using
- * MultiSetHash.
+ * a string, it hashes it using HashString. If it holds a Symbol, it returns the precomputed hash of its text,
+ * which matches the hash of the same text as a string. If it holds a handle to a MultiSet, it hashes the
+ * MultiSet using MultiSetHash.
  *
  * @param v The std::variant to hash.
  * @return The computed hash value.
  */
-std::size_t VariantHash::operator()(const std::variant<std::string, std::shared_ptr<MultiSet>>& v) const
+std::size_t VariantHash::operator()(const std::variant<std::string, MultiSetPtr, Symbol>& v) const
 {
     return std::visit(
         [](const auto& value) -> std::size_t
@@ -49,7 +37,11 @@ std::size_t VariantHash::operator()(const std::variant<std::string, std::shared_
                                                       // type modifiers
             if constexpr (std::is_same_v<T, std::string>)
             {
-                return std::hash<std::string>{}(value);
+                return static_cast<std::size_t>(HashString(value));
+            }
+            else if constexpr (std::is_same_v<T, Symbol>)
+            {
+                return value.Hash();
             }
             else
             {
@@ -60,17 +52,19 @@ std::size_t VariantHash::operator()(const std::variant<std::string, std::shared_
 }
 
 /**
- * @brief Checks for equality between two std::variant objects containing either a string or a shared_ptr to MultiSet.
+ * @brief Checks for equality between two std::variant objects containing a string, a handle to a MultiSet or a
+ * Symbol.
  *
- * This function compares the values contained in the variants. If both variants hold a shared_ptr to MultiSet,
- * the comparison is made based on the content of the MultiSets rather than their addresses.
+ * This function compares the values contained in the variants. If both variants hold a handle to a MultiSet,
+ * the comparison is made based on the content of the MultiSets rather than their addresses. A string and a
+ * Symbol are compared by text, so interned and plain strings are interchangeable.
  *
  * @param lhs The left-hand side variant to compare.
  * @param rhs The right-hand side variant to compare.
  * @return True if the variants are equal, false otherwise.
  */
-bool VariantEqual::operator()(const std::variant<std::string, std::shared_ptr<MultiSet>>& lhs,
-                              const std::variant<std::string, std::shared_ptr<MultiSet>>& rhs) const
+bool VariantEqual::operator()(const std::variant<std::string, MultiSetPtr, Symbol>& lhs,
+                              const std::variant<std::string, MultiSetPtr, Symbol>& rhs) const
 {
     return std::visit(
         [](const auto& left, const auto& right) -> bool
@@ -79,17 +73,25 @@ bool VariantEqual::operator()(const std::variant<std::string, std::shared_ptr<Mu
             using RightType = std::decay_t<decltype(right)>;
             if constexpr (std::is_same_v<LeftType, RightType>)
             {
-                if constexpr (std::is_same_v<LeftType, std::shared_ptr<MultiSet>>)
+                if constexpr (std::is_same_v<LeftType, MultiSetPtr>)
                 {
                     // For correct comparison, it is necessary to compare multisets by their content,
-                    // not by their address, so we use dereferencing
-                    return *left == *right;
+                    // not by their address, so we use dereferencing. Shared nested sets are equal without that
+                    return left == right || *left == *right;
                 }
                 else
                 {
                     return left == right;
                 }
             }
+            else if constexpr (std::is_same_v<LeftType, Symbol> && std::is_same_v<RightType, std::string>)
+            {
+                return left.Text() == right;
+            }
+            else if constexpr (std::is_same_v<LeftType, std::string> && std::is_same_v<RightType, Symbol>)
+            {
+                return left == right.Text();
+            }
             // Different types (1 != {1})
             return false;
         },
@@ -98,274 +100,84 @@ bool VariantEqual::operator()(const std::variant<std::string, std::shared_ptr<Mu
 
 // Implementations of MultiSet methods
 
-/**
- * @brief Adds an element to the multiset. If the element already exists, its count is incremented.
- * @param element The element to be added to the multiset.
- */
-void MultiSet::AddElement(const Element& element)
-{
-    auto it = elements_.find(element);
-
-    if (it != elements_.end())
-    {
-        ++it->second;
-    }
-    else
-    {
-        elements_[element] = 1;
-    }
-}
+template class BasicMultiSet<MultiSet::Element, VariantHash, VariantEqual, int, MultiSet>;
 
 /**
- * @brief Removes an element from the multiset. If the element's count reaches zero, it is removed from the multiset.
- * @param element The element to be removed from the multiset.
- * @throws std::runtime_error If the element does not exist in the multiset.
+ * @brief Constructs an empty multiset that allocates from the given allocator.
+ * @param alloc The allocator to use.
  */
-void MultiSet::RemoveElement(const Element& element)
-{
-    auto it = elements_.find(element);
-
-    if (it == elements_.end())
-    {
-        throw std::runtime_error("Element does not exist in the multiset");
-    }
-
-    if (--(it->second) == 0)
-    {
-        elements_.erase(it);
-    }
-}
+MultiSet::MultiSet(const allocator_type& alloc) : Base(alloc) {}
 
 /**
- * @brief Checks if the multiset contains a specific element.
- * @param element The element to check for presence in the multiset.
- * @return true if the element is in the multiset, false otherwise.
+ * @brief Copy-constructs a multiset using the given allocator.
+ * @param other The multiset to copy.
+ * @param alloc The allocator to use for the copy.
  */
-bool MultiSet::IsContains(const Element& element) const
+MultiSet::MultiSet(const MultiSet& other, const allocator_type& alloc)
+    : Base(other, alloc), symbols_(other.symbols_)
 {
-    auto it = elements_.find(element);
-    return it != elements_.end();
 }
 
 /**
- * @brief Checks if the multiset is empty.
- * @return true if the multiset is empty, false otherwise.
+ * @brief Move-constructs a multiset using the given allocator.
+ * @param other The multiset to move from.
+ * @param alloc The allocator to use for the new multiset.
  */
-bool MultiSet::IsEmpty() const { return elements_.empty(); }
-
-/**
- * @brief Returns the total number of elements in the multiset, counting duplicates.
- * @return The size of the multiset.
- */
-size_t MultiSet::Size() const
+MultiSet::MultiSet(MultiSet&& other, const allocator_type& alloc)
+    : Base(std::move(other), alloc), symbols_(other.symbols_)
 {
-    size_t res = 0;
-    for (const auto& element : elements_)
-    {
-        res += element.second;
-    }
-    return res;
 }
 
 /**
- * @brief Builds a boolean multiset where each element is present with a count of 1.
- * @return A new MultiSet object representing the boolean version of the original multiset.
+ * @brief Destroys a multiset released by its last IntrusivePtr and returns its memory to its allocator.
+ * @param ptr The multiset to destroy.
  */
-MultiSet MultiSet::BuildBoolean() const
+void MultiSet::DestroyIntrusive(MultiSet* ptr) noexcept
 {
-    MultiSet booleanSet;
-    for (const auto& element : elements_)
-    {
-        booleanSet.elements_[element.first] = 1;
-    }
-    return booleanSet;
+    std::pmr::polymorphic_allocator<MultiSet> alloc(ptr->get_allocator());
+    ptr->~MultiSet();
+    alloc.deallocate(ptr, 1);
 }
 
-// Override operators
-
 /**
- * @brief Compares two multisets for equality.
- * @param other The other multiset to compare with.
- * @return true if both multisets are equal, false otherwise.
+ * @brief Sets the symbol table used to intern string elements.
+ * @param symbols The symbol table, or nullptr to store strings as they are.
  */
-bool MultiSet::operator==(const MultiSet& other) const { return elements_ == other.elements_; }
+void MultiSet::SetSymbolTable(SymbolTable* symbols) { symbols_ = symbols; }
 
 /**
- * @brief Compares two multisets for inequality.
- * @param other The other multiset to compare with.
- * @return true if the multisets are not equal, false otherwise.
+ * @brief Returns the symbol table used to intern string elements.
+ * @return The symbol table, or nullptr if strings are not interned.
  */
-bool MultiSet::operator!=(const MultiSet& other) const { return !(*this == other); }
+SymbolTable* MultiSet::GetSymbolTable() const { return symbols_; }
 
 /**
- * @brief Computes the union of two multisets.
- * @param other The other multiset to unite with.
- * @return A new MultiSet that is the union of the two multisets.
+ * @brief Adds an element to the multiset. If the element already exists, its count is increased.
+ * @param element The element to be added to the multiset.
+ * @param count The number of occurrences to add.
  */
-MultiSet MultiSet::operator+(const MultiSet& other) const
+void MultiSet::AddElement(const Element& element, int count)
 {
-    MultiSet result;
-    result.elements_ = elements_;
-    for (const auto& el : other.elements_)
+    if (symbols_ != nullptr && std::holds_alternative<std::string>(element))
     {
-        const Element& element = el.first;
-        int count_other = el.second;
-        if (result.elements_.find(element) != result.elements_.end())
-        {
-            result.elements_[element] = std::max(result.elements_[element], count_other);
-        }
-        else
-        {
-            result.elements_[element] = count_other;
-        }
+        Base::AddElement(symbols_->Intern(std::get<std::string>(element)), count);
+        return;
     }
-    return result;
-}
 
-/**
- * @brief Adds elements from another multiset to this multiset (union).
- * @param other The other multiset to add.
- * @return A reference to the updated multiset.
- */
-MultiSet& MultiSet::operator+=(const MultiSet& other)
-{
-    for (const auto& el : other.elements_)
-    {
-        const Element& element = el.first;
-        int count_other = el.second;
-        if (elements_.find(element) != elements_.end())
-        {
-            elements_[element] = std::max(elements_[element], count_other);
-        }
-        else
-        {
-            elements_[element] = count_other;
-        }
-    }
-    return *this;
+    Base::AddElement(element, count);
 }
 
 /**
- * @brief Computes the intersection of two multisets.
- * @param other The other multiset to intersect with.
- * @return A new MultiSet that is the intersection of the two multisets.
+ * @brief Creates an empty multiset sharing this multiset's allocator and symbol table.
+ * @return An empty multiset to hold the result of an operation.
  */
-MultiSet MultiSet::operator*(const MultiSet& other) const
+MultiSet MultiSet::EmptyLike() const
 {
-    MultiSet result;
-    for (const auto& elem : elements_)
-    {
-        const Element& element = elem.first;
-        int count_this = elem.second;
-        auto it = other.elements_.find(element);
-        if (it != other.elements_.end())
-        {
-            int count_other = it->second;
-            result.elements_[element] = std::min(count_this, count_other);
-        }
-    }
+    MultiSet result(get_allocator());
+    result.symbols_ = symbols_;
     return result;
 }
 
-/**
- * @brief Updates this multiset by intersecting it with another multiset.
- * @param other The other multiset to intersect with.
- * @return A reference to the updated multiset.
- */
-MultiSet& MultiSet::operator*=(const MultiSet& other)
-{
-    std::unordered_map<Element, int, VariantHash, VariantEqual> result;
-    for (const auto& elem : elements_)
-    {
-        const Element& element = elem.first;
-        int count_this = elem.second;
-        auto it = other.elements_.find(element);
-        if (it != other.elements_.end())
-        {
-            int count_other = it->second;
-            result[element] = std::min(count_this, count_other);
-        }
-    }
-    elements_ = std::move(result);
-    return *this;
-}
-
-/**
- * @brief Computes the difference of two multisets (this - other).
- * @param other The other multiset to subtract.
- * @return A new MultiSet that represents the difference of the two multisets.
- */
-MultiSet MultiSet::operator-(const MultiSet& other) const
-{
-    MultiSet result;
-    for (const auto& el : elements_)
-    {
-        const Element& thisElement = el.first;
-        const int& thisCount = el.second;
-        auto it = other.elements_.find(thisElement);
-        if (it != other.elements_.end())
-        {
-            const int& otherCount = it->second;
-            if (thisCount > otherCount)
-            {
-                result.elements_[thisElement] = thisCount - otherCount;
-            }
-        }
-        else
-        {
-            result.elements_[thisElement] = thisCount;
-        }
-    }
-    for (const auto& el : other.elements_)
-    {
-        const Element& otherElement = el.first;
-        if (elements_.find(otherElement) == elements_.end())
-        {
-            result.elements_[otherElement] = el.second;
-        }
-    }
-    return result;
-}
-
-/**
- * @brief Updates this multiset by subtracting elements from another multiset.
- * @param other The other multiset to subtract.
- * @return A reference to the updated multiset.
- */
-MultiSet& MultiSet::operator-=(const MultiSet& other)
-{
-    std::unordered_map<Element, int, VariantHash, VariantEqual> result;
-
-    for (const auto& el : elements_)
-    {
-        const Element& thisElement = el.first;
-        const int& thisCount = el.second;
-        auto it = other.elements_.find(thisElement);
-        if (it != other.elements_.end())
-        {
-            const int& otherCount = it->second;
-            if (thisCount > otherCount)
-            {
-                result[thisElement] = thisCount - otherCount;
-            }
-        }
-        else
-        {
-            result[thisElement] = thisCount;
-        }
-    }
-    for (const auto& el : other.elements_)
-    {
-        const Element& otherElement = el.first;
-        if (elements_.find(otherElement) == elements_.end())
-        {
-            result[otherElement] = el.second;
-        }
-    }
-    elements_ = std::move(result);
-    return *this;
-}
-
 // Input operator for MultiSet
 /**
  * @brief Overloads the input stream operator for the MultiSet class.
@@ -389,7 +201,8 @@ std::istream& operator>>(std::istream& is, MultiSet& multiset)
         return is;
     }
 
-    std::unordered_map<MultiSet::Element, int, VariantHash, VariantEqual> elements;
+    // Nested sets and hash nodes are allocated from the target's memory resource
+    MultiSet::ElementMap elements(multiset.get_allocator());
 
     while (true)
     {
@@ -397,7 +210,8 @@ std::istream& operator>>(std::istream& is, MultiSet& multiset)
 
         if (is.peek() == '{')  // Multiset case
         {
-            auto nested_multiset = std::make_shared<MultiSet>();
+            auto nested_multiset = AllocateMultiSet(multiset.get_allocator());
+            nested_multiset->symbols_ = multiset.symbols_;
             is >> *nested_multiset;
             element = nested_multiset;
         }
@@ -414,14 +228,24 @@ std::istream& operator>>(std::istream& is, MultiSet& multiset)
                 str_element += c;
             }
 
-            element = std::move(str_element);
+            if (multiset.symbols_ != nullptr)
+            {
+                element = multiset.symbols_->Intern(str_element);
+            }
+            else
+            {
+                element = std::move(str_element);
+            }
         }
 
         elements[element]++;
 
         is >> std::ws;
 
-        is >> ch;
+        if (!(is >> ch))  // Truncated input or a malformed nested set
+        {
+            return is;
+        }
 
         if (ch == '}')
         {
@@ -434,7 +258,7 @@ std::istream& operator>>(std::istream& is, MultiSet& multiset)
         }
     }
 
-    multiset.SetElements(elements);
+    multiset.SetElements(std::move(elements));
     return is;
 }
 
@@ -442,14 +266,14 @@ std::istream& operator>>(std::istream& is, MultiSet& multiset)
 /**
  * @brief Overloads the output stream operator for std::variant.
  *
- * This operator writes a std::variant containing either a
- * std::string or a shared pointer to a MultiSet to the output stream.
+ * This operator writes a std::variant containing a std::string,
+ * a handle to a MultiSet or a Symbol to the output stream.
  *
  * @param os The output stream to write to.
  * @param v The std::variant to output.
  * @return The modified output stream.
  */
-std::ostream& operator<<(std::ostream& os, const std::variant<std::string, std::shared_ptr<MultiSet>>& v)
+std::ostream& operator<<(std::ostream& os, const std::variant<std::string, MultiSetPtr, Symbol>& v)
 {
     std::visit(
         [&os](const auto& value)
@@ -459,6 +283,10 @@ std::ostream& operator<<(std::ostream& os, const std::variant<std::string, std::
             {
                 os << value;
             }
+            else if constexpr (std::is_same_v<ValueType, Symbol>)
+            {
+                os << value.Text();
+            }
             else
             {
                 os << *value;  // Use MultiSet's operator<<
@@ -468,59 +296,71 @@ std::ostream& operator<<(std::ostream& os, const std::variant<std::string, std::
     return os;
 }
 
-// Output operator for MultiSet
 /**
- * @brief Overloads the output stream operator for the MultiSet class.
+ * @brief Orders strings and Symbols by text before nested sets, which are ordered by CanonicalCompare.
  *
- * This operator writes the contents of a MultiSet to the output stream,
- * formatted as a comma-separated list of elements enclosed in braces.
+ * Texts are compared as string_views, so interned and plain strings
+ * order the same way and no string is copied. Nested sets compare their
+ * cached canonical entries, and a set shared by both sides is equal to
+ * itself without a look inside.
  *
- * @param os The output stream to write to.
- * @param multiset The MultiSet instance to output.
- * @return The modified output stream.
+ * @param left The first element.
+ * @param right The second element.
+ * @return True if left orders before right.
  */
-std::ostream& operator<<(std::ostream& os, const MultiSet& multiset)
+bool CanonicalLess<MultiSet::Element>::operator()(const MultiSet::Element& left, const MultiSet::Element& right) const
 {
-    os << "{";
-    bool first = true;
-    for (const auto& elem : multiset.GetElements())
+    const auto* left_set = std::get_if<MultiSetPtr>(&left);
+    const auto* right_set = std::get_if<MultiSetPtr>(&right);
+    if (left_set == nullptr && right_set == nullptr)
     {
-        for (int i = 0; i < elem.second; ++i)
+        auto text = [](const MultiSet::Element& element) -> std::string_view
         {
-            if (!first)
+            if (const auto* symbol = std::get_if<Symbol>(&element))
             {
-                os << ", ";
+                return symbol->Text();
             }
-            first = false;
-            os << elem.first;  // This calls the variant operator<< if the element is a variant
-        }
+            return std::get<std::string>(element);
+        };
+        return text(left) < text(right);
     }
-    os << "}";
-    return os;
-}
-
-/**
- * @brief Sets the elements of the MultiSet.
- *
- * This method populates the MultiSet with a given set of elements and
- * their counts.
- *
- * @param elements A map of elements and their respective counts to set.
- */
-void MultiSet::SetElements(const std::unordered_map<Element, int, VariantHash, VariantEqual>& elements)
-{
-    elements_ = elements;
+    if (left_set == nullptr || right_set == nullptr)
+    {
+        return left_set == nullptr;
+    }
+    return left_set->get() != right_set->get() && (*left_set)->CanonicalCompare(**right_set) < 0;
 }
 
+// Output operator for MultiSet
 /**
- * @brief Retrieves the elements of the MultiSet.
+ * @brief Overloads the output stream operator for the MultiSet class.
  *
- * This method returns a constant reference to the internal map of
- * elements and their counts in the MultiSet.
+ * This operator writes the contents of a MultiSet to the output stream,
+ * formatted as a comma-separated list of elements enclosed in braces.
+ * With CanonicalOrder applied to the stream, the elements of this set
+ * and of all nested sets are written in canonical order.
  *
- * @return A constant reference to the unordered_map of elements and counts.
+ * @param os The output stream to write to.
+ * @param multiset The MultiSet instance to output.
+ * @return The modified output stream.
  */
-const std::unordered_map<MultiSet::Element, int, VariantHash, VariantEqual>& MultiSet::GetElements() const
+std::ostream& operator<<(std::ostream& os, const MultiSet& multiset)
 {
-    return elements_;
+    os << "{";
+    bool first = true;
+    ForEachInOutputOrder(os, multiset,
+                         [&](const auto& elem)
+                         {
+                             for (int i = 0; i < elem.second; ++i)
+                             {
+                                 if (!first)
+                                 {
+                                     os << ", ";
+                                 }
+                                 first = false;
+                                 os << elem.first;  // This calls the variant operator<< if the element is a variant
+                             }
+                         });
+    os << "}";
+    return os;
 }
@@ -5,11 +5,32 @@
 #include <string>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
 #include <algorithm>
 
+#include "basic_multiset.hpp"
+#include "intrusive_ptr.hpp"
+#include "symbol_table.hpp"
+
 // Forward declaration of MultiSet
 class MultiSet;
 
+/**
+ * @brief Owning handle to a nested MultiSet.
+ * 
+ * By default nested sets are held by std::shared_ptr. When
+ * MULTISET_INTRUSIVE_NESTED is defined they are held by IntrusivePtr,
+ * which keeps the reference count inside the MultiSet itself and needs
+ * no separate control block; MULTISET_SINGLE_THREADED additionally makes
+ * that count non-atomic. Create handles with MakeMultiSet or
+ * AllocateMultiSet to stay independent of the chosen mode.
+ */
+#ifdef MULTISET_INTRUSIVE_NESTED
+using MultiSetPtr = IntrusivePtr<MultiSet>;
+#else
+using MultiSetPtr = std::shared_ptr<MultiSet>;
+#endif
+
 /**
  * @brief Hash functor for the MultiSet class.
  * 
@@ -22,183 +43,195 @@ struct MultiSetHash {
 };
 
 /**
- * @brief Hash functor for std::variant containing string or MultiSet.
+ * @brief Hash functor for std::variant containing string, MultiSet or Symbol.
  * 
  * This structure provides a way to generate a hash value for 
- * std::variant objects that can hold either a string or a 
- * shared pointer to a MultiSet.
+ * std::variant objects that can hold a string, a handle to a 
+ * MultiSet or an interned string. A Symbol hashes like its text.
  */
 struct VariantHash {
-    std::size_t operator()(const std::variant<std::string, std::shared_ptr<MultiSet>>& v) const;
+    std::size_t operator()(const std::variant<std::string, MultiSetPtr, Symbol>& v) const;
 };
 
 /**
- * @brief Equality functor for std::variant containing string or MultiSet.
+ * @brief Equality functor for std::variant containing string, MultiSet or Symbol.
  * 
  * This structure provides a way to compare two std::variant 
- * objects for equality, handling both possible types.
+ * objects for equality, handling all possible types. A string 
+ * and a Symbol are equal when their texts are equal.
  */
 struct VariantEqual {
-    bool operator()(const std::variant<std::string, std::shared_ptr<MultiSet>>& lhs,
-                    const std::variant<std::string, std::shared_ptr<MultiSet>>& rhs) const;
+    bool operator()(const std::variant<std::string, MultiSetPtr, Symbol>& lhs,
+                    const std::variant<std::string, MultiSetPtr, Symbol>& rhs) const;
 };
 
 /**
  * @brief Class representing a multiset of elements.
  * 
  * The MultiSet class allows for the storage and manipulation of 
- * a collection of elements, which can be either strings or 
- * nested MultiSets. It supports operations such as addition, 
+ * a collection of elements, which can be strings, interned 
+ * strings (Symbols) or nested MultiSets. It supports operations such as addition, 
  * removal, and various set operations (union, intersection, 
- * difference).
+ * difference), which it inherits from BasicMultiSet, and can be 
+ * read from and written to streams.
  */
 class MultiSet
+    : public BasicMultiSet<std::variant<std::string, MultiSetPtr, Symbol>, VariantHash, VariantEqual, int, MultiSet>,
+      public IntrusiveRefCounted<MultiSet>
 {
-public:
-    using Element = std::variant<std::string, std::shared_ptr<MultiSet>>;
+    using Base = BasicMultiSet<std::variant<std::string, MultiSetPtr, Symbol>, VariantHash, VariantEqual, int, MultiSet>;
 
+public:
     MultiSet() = default;
 
     /**
-     * @brief Adds an element to the MultiSet.
+     * @brief Constructs an empty MultiSet that allocates from the given allocator.
      * 
-     * This method increases the count of the specified element 
-     * in the multiset.
+     * All hash nodes of this set, and all nested sets created by reading
+     * it from a stream, are allocated from the allocator's memory resource.
      * 
-     * @param element The element to add.
+     * @param alloc The allocator to use.
      */
-    void AddElement(const Element &element);
+    explicit MultiSet(const allocator_type& alloc);
 
-    /**
-     * @brief Removes an element from the MultiSet.
-     * 
-     * This method decreases the count of the specified element 
-     * in the multiset, removing it completely if the count reaches zero.
-     * 
-     * @param element The element to remove.
-     */
-    void RemoveElement(const Element& element);
+    MultiSet(const MultiSet& other) = default;
 
     /**
-     * @brief Checks if the MultiSet contains a specific element.
+     * @brief Copy-constructs a MultiSet using the given allocator.
      * 
-     * @param element The element to check for.
-     * @return True if the element is contained in the multiset, false otherwise.
+     * @param other The MultiSet to copy.
+     * @param alloc The allocator to use for the copy.
      */
-    bool IsContains(const Element& element) const;
+    MultiSet(const MultiSet& other, const allocator_type& alloc);
 
-    /**
-     * @brief Checks if the MultiSet is empty.
-     * 
-     * @return True if the multiset has no elements, false otherwise.
-     */
-    bool IsEmpty() const;
-
-    /**
-     * @brief Gets the number of elements in the MultiSet.
-     * 
-     * @return The size of the multiset.
-     */
-    size_t Size() const;
+    MultiSet(MultiSet&& other) = default;
 
     /**
-     * @brief Builds a boolean representation of the MultiSet.
+     * @brief Move-constructs a MultiSet using the given allocator.
      * 
-     * This method returns a MultiSet that represents the boolean 
-     * logic of the current set.
+     * The elements are moved if the allocators compare equal and copied otherwise.
      * 
-     * @return A MultiSet representing the boolean logic.
+     * @param other The MultiSet to move from.
+     * @param alloc The allocator to use for the new MultiSet.
      */
-    MultiSet BuildBoolean() const;
+    MultiSet(MultiSet&& other, const allocator_type& alloc);
 
-    // Operators overload
-    /**
-     * @brief Checks for equality between two MultiSets.
-     * 
-     * @param other The other MultiSet to compare with.
-     * @return True if the two MultiSets are equal, false otherwise.
-     */
-    bool operator==(const MultiSet& other) const;
+    MultiSet& operator=(const MultiSet& other) = default;
+    MultiSet& operator=(MultiSet&& other) = default;
 
     /**
-     * @brief Checks for inequality between two MultiSets.
+     * @brief Sets the symbol table used to intern string elements.
      * 
-     * @param other The other MultiSet to compare with.
-     * @return True if the two MultiSets are not equal, false otherwise.
-     */
-    bool operator!=(const MultiSet& other) const;
-
-    /**
-     * @brief Performs the union operation between two MultiSets.
-     * 
-     * @param other The other MultiSet to union with.
-     * @return A new MultiSet representing the union of both.
-     */
-    MultiSet operator+(const MultiSet& other) const;
-
-    /**
-     * @brief Performs the union operation in place.
+     * While a table is set, string elements passed to AddElement or 
+     * read by operator>> are stored as Symbols of that table. Nested 
+     * sets read by operator>> use the same table. Pass nullptr to 
+     * store strings as they are.
      * 
-     * @param other The other MultiSet to union with.
-     * @return A reference to this MultiSet after the union.
+     * @param symbols The symbol table, which must outlive the stored Symbols.
      */
-    MultiSet& operator+=(const MultiSet& other);
+    void SetSymbolTable(SymbolTable* symbols);
 
     /**
-     * @brief Performs the intersection operation between two MultiSets.
+     * @brief Gets the symbol table used to intern string elements.
      * 
-     * @param other The other MultiSet to intersect with.
-     * @return A new MultiSet representing the intersection of both.
+     * @return The symbol table, or nullptr if strings are not interned.
      */
-    MultiSet operator*(const MultiSet& other) const;
+    SymbolTable* GetSymbolTable() const;
 
     /**
-     * @brief Performs the intersection operation in place.
-     * 
-     * @param other The other MultiSet to intersect with.
-     * @return A reference to this MultiSet after the intersection.
-     */
-    MultiSet& operator*=(const MultiSet& other);
-
-    /**
-     * @brief Performs the difference operation between two MultiSets.
+     * @brief Adds an element to the MultiSet.
      * 
-     * @param other The other MultiSet to subtract.
-     * @return A new MultiSet representing the difference of both.
-     */
-    MultiSet operator-(const MultiSet& other) const;
-
-    /**
-     * @brief Performs the difference operation in place.
+     * This method increases the count of the specified element 
+     * in the multiset. Strings are interned if a symbol table is set.
      * 
-     * @param other The other MultiSet to subtract.
-     * @return A reference to this MultiSet after the difference.
+     * @param element The element to add.
+     * @param count The number of occurrences to add; adding zero does nothing.
      */
-    MultiSet& operator-=(const MultiSet& other);
+    void AddElement(const Element &element, int count = 1);
 
     friend std::istream& operator>>(std::istream& is, MultiSet& multiset);
     friend std::ostream& operator<<(std::ostream& os, const MultiSet& multiset);
 
+private:
+    friend Base;
+    friend class IntrusiveRefCounted<MultiSet>;
+
     /**
-     * @brief Sets the elements of the MultiSet.
+     * @brief Creates an empty MultiSet to hold the result of an operation.
      * 
-     * This method populates the MultiSet with a given set of elements 
-     * and their counts.
+     * The result shares this MultiSet's allocator and symbol table.
      * 
-     * @param elements A map of elements and their respective counts to set.
+     * @return An empty MultiSet.
      */
-    void SetElements(const std::unordered_map<Element, int, VariantHash, VariantEqual>& elements);
+    MultiSet EmptyLike() const;
 
     /**
-     * @brief Retrieves the elements of the MultiSet.
+     * @brief Destroys a MultiSet whose last IntrusivePtr was released.
      * 
-     * This method returns a constant reference to the internal map of 
-     * elements and their counts in the MultiSet.
+     * Memory is returned to the MultiSet's own allocator, which is the
+     * one AllocateMultiSet obtained it from.
      * 
-     * @return A constant reference to the unordered_map of elements and counts.
+     * @param ptr The MultiSet to destroy.
      */
-    const std::unordered_map<Element, int, VariantHash, VariantEqual>& GetElements() const;
+    static void DestroyIntrusive(MultiSet* ptr) noexcept;
 
-private:
-    std::unordered_map<Element, int, VariantHash, VariantEqual> elements_;
+    SymbolTable* symbols_ = nullptr;
+};
+
+/**
+ * @brief Canonical order of MultiSet elements: strings and Symbols by text, then nested sets recursively.
+ */
+template <>
+struct CanonicalLess<MultiSet::Element>
+{
+    bool operator()(const MultiSet::Element& left, const MultiSet::Element& right) const;
 };
+
+extern template class BasicMultiSet<MultiSet::Element, VariantHash, VariantEqual, int, MultiSet>;
+
+/**
+ * @brief Creates a nested MultiSet handle allocated from the given allocator.
+ * 
+ * The MultiSet is constructed from the given arguments and uses the
+ * allocator for its own elements as well.
+ * 
+ * @param alloc The allocator to allocate the MultiSet from.
+ * @param args The arguments to construct the MultiSet from.
+ * @return A handle owning the new MultiSet.
+ */
+template <typename... Args>
+MultiSetPtr AllocateMultiSet(const MultiSet::allocator_type& alloc, Args&&... args)
+{
+#ifdef MULTISET_INTRUSIVE_NESTED
+    std::pmr::polymorphic_allocator<MultiSet> multiset_alloc(alloc);
+    MultiSet* ptr = multiset_alloc.allocate(1);
+    try
+    {
+        multiset_alloc.construct(ptr, std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        multiset_alloc.deallocate(ptr, 1);
+        throw;
+    }
+    return MultiSetPtr(ptr);
+#else
+    return std::allocate_shared<MultiSet>(alloc, std::forward<Args>(args)...);
+#endif
+}
+
+/**
+ * @brief Creates a nested MultiSet handle using the default allocator.
+ * 
+ * @param args The arguments to construct the MultiSet from.
+ * @return A handle owning the new MultiSet.
+ */
+template <typename... Args>
+MultiSetPtr MakeMultiSet(Args&&... args)
+{
+#ifdef MULTISET_INTRUSIVE_NESTED
+    return AllocateMultiSet(MultiSet::allocator_type{}, std::forward<Args>(args)...);
+#else
+    return std::make_shared<MultiSet>(std::forward<Args>(args)...);
+#endif
+}
@@ -0,0 +1,329 @@
+#include "multiset_batch.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+/**
+ * @brief Constructs an empty batch.
+ * @param alloc The allocator to use for the arrays and the dictionary.
+ */
+MultiSetBatch::MultiSetBatch(const allocator_type& alloc)
+    : ids_(alloc), dictionary_(alloc), offsets_(1, 0, alloc), element_ids_(alloc), counts_(alloc)
+{
+}
+
+/**
+ * @brief Copies a batch, using the given allocator.
+ * @param other The batch to copy.
+ * @param alloc The allocator to use for the copy.
+ */
+MultiSetBatch::MultiSetBatch(const MultiSetBatch& other, const allocator_type& alloc)
+    : ids_(other.ids_, alloc),
+      dictionary_(alloc),
+      offsets_(other.offsets_, alloc),
+      element_ids_(other.element_ids_, alloc),
+      counts_(other.counts_, alloc)
+{
+    RebuildDictionary();
+}
+
+/**
+ * @brief Moves a batch, leaving the source empty.
+ * @param other The batch to move from.
+ */
+MultiSetBatch::MultiSetBatch(MultiSetBatch&& other) : MultiSetBatch(std::move(other), other.get_allocator()) {}
+
+/**
+ * @brief Moves a batch into the given allocator; the elements are copied if the allocators differ.
+ * @param other The batch to move from, which is left empty.
+ * @param alloc The allocator to use for the new batch.
+ */
+MultiSetBatch::MultiSetBatch(MultiSetBatch&& other, const allocator_type& alloc)
+    : ids_(std::move(other.ids_), alloc),
+      dictionary_(alloc),
+      offsets_(std::move(other.offsets_), alloc),
+      element_ids_(std::move(other.element_ids_), alloc),
+      counts_(std::move(other.counts_), alloc)
+{
+    RebuildDictionary();
+    other.Clear();
+}
+
+/**
+ * @brief Copies the rows and the dictionary of another batch, keeping this batch's allocator.
+ * @param other The batch to copy.
+ * @return A reference to this batch.
+ */
+MultiSetBatch& MultiSetBatch::operator=(const MultiSetBatch& other)
+{
+    if (this != &other)
+    {
+        ids_ = other.ids_;
+        offsets_ = other.offsets_;
+        element_ids_ = other.element_ids_;
+        counts_ = other.counts_;
+        RebuildDictionary();
+    }
+    return *this;
+}
+
+/**
+ * @brief Moves the rows and the dictionary of another batch, keeping this batch's allocator.
+ * @param other The batch to move from, which is left empty.
+ * @return A reference to this batch.
+ */
+MultiSetBatch& MultiSetBatch::operator=(MultiSetBatch&& other)
+{
+    if (this != &other)
+    {
+        ids_ = std::move(other.ids_);
+        offsets_ = std::move(other.offsets_);
+        element_ids_ = std::move(other.element_ids_);
+        counts_ = std::move(other.counts_);
+        RebuildDictionary();
+        other.Clear();
+    }
+    return *this;
+}
+
+/**
+ * @brief Gets the number of bytes used by the offsets, ids and counts.
+ * @return The memory used by the rows.
+ */
+std::size_t MultiSetBatch::MemoryUsage() const
+{
+    return offsets_.capacity() * sizeof(std::size_t) + element_ids_.capacity() * sizeof(ElementId) +
+           counts_.capacity() * sizeof(int);
+}
+
+/**
+ * @brief Appends a multiset as a new row, sorted by element id.
+ * @param set The multiset to append.
+ * @return The index of the new row.
+ */
+std::size_t MultiSetBatch::Append(const MultiSet& set)
+{
+    std::vector<std::pair<ElementId, int>> row;
+    row.reserve(set.GetElements().size());
+    for (const auto& entry : set.GetElements())
+    {
+        row.emplace_back(Intern(entry.first), entry.second);
+    }
+    AppendRow(row);
+    return Rows() - 1;
+}
+
+/**
+ * @brief Converts a row back to a MultiSet.
+ * @param row The row index.
+ * @param alloc The allocator of the new MultiSet.
+ * @return The multiset of the row.
+ */
+MultiSet MultiSetBatch::ToMultiSet(std::size_t row, const allocator_type& alloc) const
+{
+    if (row >= Rows())
+    {
+        throw std::out_of_range("Row is not in the batch");
+    }
+    MultiSet set(alloc);
+    MultiSet::ElementMap elements(alloc);
+    elements.reserve(offsets_[row + 1] - offsets_[row]);
+    for (std::size_t k = offsets_[row]; k < offsets_[row + 1]; ++k)
+    {
+        elements.try_emplace(*dictionary_[element_ids_[k]], counts_[k]);
+    }
+    set.SetElements(std::move(elements));
+    return set;
+}
+
+/**
+ * @brief Looks up the id of an element.
+ * @param element The element.
+ * @return The id, or nothing if no row holds the element.
+ */
+auto MultiSetBatch::Find(const Element& element) const -> std::optional<ElementId>
+{
+    auto it = ids_.find(element);
+    if (it == ids_.end())
+    {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+/**
+ * @brief Computes the size of every row by summing its counts.
+ * @return The sizes, one per row.
+ */
+std::vector<std::int64_t> MultiSetBatch::Sizes() const
+{
+    std::vector<std::int64_t> sizes(Rows());
+    const int* counts = counts_.data();
+    for (std::size_t row = 0; row < sizes.size(); ++row)
+    {
+        std::int64_t size = 0;
+        for (std::size_t k = offsets_[row]; k < offsets_[row + 1]; ++k)
+        {
+            size += counts[k];
+        }
+        sizes[row] = size;
+    }
+    return sizes;
+}
+
+/**
+ * @brief Gets the count of an element in every row with a branch-free scan of the id array.
+ * @param element The element.
+ * @return The counts, one per row.
+ */
+std::vector<int> MultiSetBatch::CountAcrossRows(const Element& element) const
+{
+    std::vector<int> result(Rows(), 0);
+    std::optional<ElementId> id = Find(element);
+    if (!id)
+    {
+        return result;
+    }
+
+    const ElementId target = *id;
+    const ElementId* ids = element_ids_.data();
+    const int* counts = counts_.data();
+    for (std::size_t row = 0; row < result.size(); ++row)
+    {
+        int count = 0;
+        for (std::size_t k = offsets_[row]; k < offsets_[row + 1]; ++k)
+        {
+            count += ids[k] == target ? counts[k] : 0;
+        }
+        result[row] = count;
+    }
+    return result;
+}
+
+/**
+ * @brief Computes the size of the intersection of every row with a query.
+ * @param query The multiset to intersect with.
+ * @return The sizes of the intersections, one per row.
+ */
+std::vector<std::int64_t> MultiSetBatch::IntersectionSizes(const MultiSet& query) const
+{
+    const std::vector<int> dense = DenseCounts(query);
+    std::vector<std::int64_t> sizes(Rows());
+    const ElementId* ids = element_ids_.data();
+    const int* counts = counts_.data();
+    for (std::size_t row = 0; row < sizes.size(); ++row)
+    {
+        std::int64_t size = 0;
+        for (std::size_t k = offsets_[row]; k < offsets_[row + 1]; ++k)
+        {
+            size += std::min(counts[k], dense[ids[k]]);
+        }
+        sizes[row] = size;
+    }
+    return sizes;
+}
+
+/**
+ * @brief Intersects every row with a query into a batch with its own dictionary.
+ * @param query The multiset to intersect with.
+ * @return A batch whose rows are the intersections.
+ */
+MultiSetBatch MultiSetBatch::Intersect(const MultiSet& query) const
+{
+    const std::vector<int> dense = DenseCounts(query);
+    MultiSetBatch result(get_allocator());
+    result.offsets_.reserve(offsets_.size());
+    std::vector<std::pair<ElementId, int>> row;
+    for (std::size_t r = 0; r < Rows(); ++r)
+    {
+        row.clear();
+        for (std::size_t k = offsets_[r]; k < offsets_[r + 1]; ++k)
+        {
+            int count = std::min(counts_[k], dense[element_ids_[k]]);
+            if (count > 0)
+            {
+                row.emplace_back(result.Intern(*dictionary_[element_ids_[k]]), count);
+            }
+        }
+        result.AppendRow(row);
+    }
+    return result;
+}
+
+/**
+ * @brief Appends a row of (id, count) entries after sorting them by id.
+ * @param row The entries of the row.
+ */
+void MultiSetBatch::AppendRow(std::vector<std::pair<ElementId, int>>& row)
+{
+    std::sort(row.begin(), row.end());
+    for (const auto& [id, count] : row)
+    {
+        element_ids_.push_back(id);
+        counts_.push_back(count);
+    }
+    offsets_.push_back(element_ids_.size());
+}
+
+/**
+ * @brief Gets the id of an element, adding it to the dictionary if needed.
+ * @param element The element.
+ * @return The id of the element.
+ */
+auto MultiSetBatch::Intern(const Element& element) -> ElementId
+{
+    if (dictionary_.size() > std::numeric_limits<ElementId>::max())
+    {
+        throw std::runtime_error("MultiSetBatch holds too many distinct elements");
+    }
+    auto [it, inserted] = ids_.try_emplace(element, static_cast<ElementId>(dictionary_.size()));
+    if (inserted)
+    {
+        dictionary_.push_back(&it->first);
+    }
+    return it->second;
+}
+
+/**
+ * @brief Points the dictionary at the keys of the element map, which may have been copied or moved.
+ */
+void MultiSetBatch::RebuildDictionary()
+{
+    dictionary_.assign(ids_.size(), nullptr);
+    for (const auto& [element, id] : ids_)
+    {
+        dictionary_[id] = &element;
+    }
+}
+
+/**
+ * @brief Removes all rows and elements.
+ */
+void MultiSetBatch::Clear()
+{
+    ids_.clear();
+    dictionary_.clear();
+    offsets_.assign(1, 0);
+    element_ids_.clear();
+    counts_.clear();
+}
+
+/**
+ * @brief Expands a query into its count per element id, ignoring elements no row holds.
+ * @param query The query.
+ * @return The counts, indexed by element id.
+ */
+std::vector<int> MultiSetBatch::DenseCounts(const MultiSet& query) const
+{
+    std::vector<int> dense(dictionary_.size(), 0);
+    for (const auto& entry : query.GetElements())
+    {
+        if (auto id = Find(entry.first))
+        {
+            dense[*id] = entry.second;
+        }
+    }
+    return dense;
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "multiset.hpp"
+
+/**
+ * @brief Many small MultiSets stored as rows of one compressed sparse row (CSR) layout.
+ *
+ * Every distinct element is stored once in a dictionary and referred to
+ * by a 32-bit ElementId. Row r holds the ids and counts at positions
+ * [offsets[r], offsets[r + 1]) of two flat arrays, sorted by id. A row
+ * therefore costs 8 bytes per distinct element plus one offset, with no
+ * hash table, bucket array or object header per multiset.
+ *
+ * Batch operations are branch-free loops over the flat arrays, which
+ * read memory sequentially and leave compilers free to vectorize. Rows
+ * are appended and never modified; convert a row back to a MultiSet to
+ * change it.
+ */
+class MultiSetBatch
+{
+public:
+    using Element = MultiSet::Element;
+    using ElementId = std::uint32_t;
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    /**
+     * @brief Constructs an empty batch.
+     *
+     * @param alloc The allocator to use for the arrays and the dictionary.
+     */
+    explicit MultiSetBatch(const allocator_type& alloc = {});
+
+    /**
+     * @brief Copies a batch, using the given allocator.
+     *
+     * @param other The batch to copy.
+     * @param alloc The allocator to use for the copy.
+     */
+    MultiSetBatch(const MultiSetBatch& other, const allocator_type& alloc = {});
+
+    MultiSetBatch(MultiSetBatch&& other);
+
+    /**
+     * @brief Moves a batch into the given allocator, copying its contents if the allocators differ.
+     *
+     * @param other The batch to move from, which is left empty.
+     * @param alloc The allocator to use for the new batch.
+     */
+    MultiSetBatch(MultiSetBatch&& other, const allocator_type& alloc);
+
+    // The dictionary points into the keys of the element map, so every copy or move re-points it
+    MultiSetBatch& operator=(const MultiSetBatch& other);
+    MultiSetBatch& operator=(MultiSetBatch&& other);
+
+    allocator_type get_allocator() const { return counts_.get_allocator(); }
+
+    /**
+     * @brief Gets the number of rows.
+     */
+    std::size_t Rows() const { return offsets_.size() - 1; }
+
+    /**
+     * @brief Gets the number of distinct elements over all rows.
+     */
+    std::size_t DistinctElements() const { return dictionary_.size(); }
+
+    /**
+     * @brief Gets the number of bytes used by the offsets, ids and counts.
+     *
+     * @return The memory used by the rows, excluding the dictionary.
+     */
+    std::size_t MemoryUsage() const;
+
+    /**
+     * @brief Appends a multiset as a new row.
+     *
+     * @param set The multiset to append.
+     * @return The index of the new row.
+     * @throws std::runtime_error If the batch would exceed 2^32 distinct elements.
+     */
+    std::size_t Append(const MultiSet& set);
+
+    /**
+     * @brief Converts a row back to a MultiSet.
+     *
+     * @param row The row index.
+     * @param alloc The allocator of the new MultiSet.
+     * @return The multiset of the row.
+     * @throws std::out_of_range If row is not in the batch.
+     */
+    MultiSet ToMultiSet(std::size_t row, const allocator_type& alloc = {}) const;
+
+    /**
+     * @brief Looks up the id of an element.
+     *
+     * @param element The element.
+     * @return The id, or nothing if no row holds the element.
+     */
+    std::optional<ElementId> Find(const Element& element) const;
+
+    /**
+     * @brief Gets the element with a given id.
+     *
+     * @param id An id returned by Find().
+     * @return The element.
+     */
+    const Element& GetElement(ElementId id) const { return *dictionary_[id]; }
+
+    /**
+     * @brief Computes the size of every row, counting duplicates.
+     *
+     * @return The sizes, one per row.
+     */
+    std::vector<std::int64_t> Sizes() const;
+
+    /**
+     * @brief Gets the count of an element in every row.
+     *
+     * @param element The element.
+     * @return The counts, one per row, zero where the row does not hold the element.
+     */
+    std::vector<int> CountAcrossRows(const Element& element) const;
+
+    /**
+     * @brief Computes the size of the intersection of every row with a query.
+     *
+     * The query is expanded into a dense count per ElementId once, so
+     * the cost is one pass over the rows plus one over the dictionary.
+     *
+     * @param query The multiset to intersect with.
+     * @return The sizes of the intersections, one per row.
+     */
+    std::vector<std::int64_t> IntersectionSizes(const MultiSet& query) const;
+
+    /**
+     * @brief Intersects every row with a query.
+     *
+     * @param query The multiset to intersect with.
+     * @return A batch whose rows are the intersections, in the allocator of this batch.
+     */
+    MultiSetBatch Intersect(const MultiSet& query) const;
+
+private:
+    ElementId Intern(const Element& element);
+
+    void AppendRow(std::vector<std::pair<ElementId, int>>& row);
+
+    std::vector<int> DenseCounts(const MultiSet& query) const;
+
+    void RebuildDictionary();
+
+    void Clear();
+
+    // Maps each element to its id; dictionary_ points back at the keys, which unordered_map keeps in place
+    std::pmr::unordered_map<Element, ElementId, VariantHash, VariantEqual> ids_;
+    std::pmr::vector<const Element*> dictionary_;
+    std::pmr::vector<std::size_t> offsets_;
+    std::pmr::vector<ElementId> element_ids_;
+    std::pmr::vector<int> counts_;
+};
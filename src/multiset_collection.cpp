@@ -0,0 +1,308 @@
+#include "multiset_collection.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+/**
+ * @brief Appends a value as a little-endian base-128 varint.
+ */
+void PutVarint(std::pmr::vector<std::uint8_t>& bytes, std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        bytes.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<std::uint8_t>(value));
+}
+
+/**
+ * @brief Reads a varint and advances the cursor past it.
+ */
+std::uint64_t GetVarint(const std::uint8_t*& cursor)
+{
+    std::uint64_t value = 0;
+    for (int shift = 0;; shift += 7)
+    {
+        std::uint8_t byte = *cursor++;
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (byte < 0x80)
+        {
+            return value;
+        }
+    }
+}
+
+/**
+ * @brief Gets the count of an element in a multiset, or zero.
+ */
+int CountOf(const MultiSet& set, const MultiSet::Element& element)
+{
+    auto it = set.GetElements().find(element);
+    return it == set.GetElements().end() ? 0 : it->second;
+}
+
+/**
+ * @brief Intersects two sorted id lists.
+ *
+ * Lists of similar length are merged without data-dependent branches.
+ * A much longer second list is searched with galloping instead, so the
+ * cost follows the shorter list.
+ */
+std::vector<std::size_t> IntersectSorted(const std::vector<std::size_t>& shorter,
+                                         const std::vector<std::size_t>& longer)
+{
+    std::vector<std::size_t> result(shorter.size());
+    std::size_t k = 0;
+    if (longer.size() / 32 > shorter.size())
+    {
+        auto from = longer.begin();
+        for (std::size_t id : shorter)
+        {
+            std::size_t step = 1;
+            auto bound = from;
+            while (bound != longer.end() && *bound < id)
+            {
+                from = bound + 1;
+                bound = static_cast<std::size_t>(longer.end() - from) > step ? from + step : longer.end();
+                step *= 2;
+            }
+            from = std::lower_bound(from, bound, id);
+            if (from != longer.end() && *from == id)
+            {
+                result[k++] = id;
+            }
+        }
+    }
+    else
+    {
+        std::size_t i = 0;
+        std::size_t j = 0;
+        while (i < shorter.size() && j < longer.size())
+        {
+            std::size_t left = shorter[i];
+            std::size_t right = longer[j];
+            result[k] = left;
+            k += left == right;
+            i += left <= right;
+            j += right <= left;
+        }
+    }
+    result.resize(k);
+    return result;
+}
+}  // namespace
+
+/**
+ * @brief Constructs an empty collection.
+ * @param alloc The allocator to use for the multisets and the index.
+ */
+MultiSetCollection::MultiSetCollection(const allocator_type& alloc) : sets_(alloc), empty_sets_(alloc), postings_(alloc)
+{
+}
+
+/**
+ * @brief Adds a multiset and appends its id to the posting list of each of its elements.
+ * @param set The multiset.
+ * @return The id of the multiset.
+ */
+auto MultiSetCollection::Add(MultiSet set) -> Id
+{
+    Id id = sets_.size();
+    sets_.push_back(std::move(set));
+    const MultiSet& stored = sets_.back();
+    if (stored.IsEmpty())
+    {
+        empty_sets_.push_back(id);
+    }
+    for (const auto& entry : stored.GetElements())
+    {
+        auto it = postings_.try_emplace(VariantHash{}(entry.first), get_allocator()).first;
+        PostingList& list = it->second;
+        // Colliding elements of one multiset share a list, so the same id can follow itself with a zero delta
+        PutVarint(list.bytes, id - list.last);
+        PutVarint(list.bytes, static_cast<std::uint64_t>(entry.second));
+        list.last = id;
+    }
+    return id;
+}
+
+/**
+ * @brief Gets a multiset of the collection.
+ * @param id The id returned by Add().
+ * @return The multiset.
+ */
+const MultiSet& MultiSetCollection::Get(Id id) const
+{
+    if (id >= sets_.size())
+    {
+        throw std::out_of_range("Multiset id is not in the collection");
+    }
+    return sets_[id];
+}
+
+/**
+ * @brief Gets the number of bytes of the encoded posting lists.
+ * @return The memory used by the postings.
+ */
+std::size_t MultiSetCollection::PostingBytes() const
+{
+    std::size_t bytes = 0;
+    for (const auto& entry : postings_)
+    {
+        bytes += entry.second.bytes.capacity();
+    }
+    return bytes;
+}
+
+/**
+ * @brief Finds the multisets that contain an element at least a given number of times.
+ * @param element The element to look for.
+ * @param min_count The smallest count to report.
+ * @return The ids of the matching multisets in increasing order.
+ */
+auto MultiSetCollection::Containing(const Element& element, int min_count) const -> std::vector<Id>
+{
+    std::vector<Id> result;
+    const PostingList* list = Find(element);
+    if (list == nullptr)
+    {
+        return result;
+    }
+
+    std::vector<Posting> postings;
+    Decode(*list, postings);
+    for (const auto& posting : postings)
+    {
+        if (posting.count >= min_count && (result.empty() || result.back() != posting.id) &&
+            CountOf(sets_[posting.id], element) >= min_count)
+        {
+            result.push_back(posting.id);
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Finds the multisets that contain every element of a query at least as often as the query.
+ * @param query The multiset to look for.
+ * @return The ids of the matching multisets in increasing order.
+ */
+auto MultiSetCollection::ContainingAll(const MultiSet& query) const -> std::vector<Id>
+{
+    std::vector<Id> result;
+    if (query.IsEmpty())
+    {
+        result.resize(sets_.size());
+        for (Id id = 0; id < result.size(); ++id)
+        {
+            result[id] = id;
+        }
+        return result;
+    }
+
+    std::vector<std::vector<Id>> lists;
+    std::vector<Posting> postings;
+    for (const auto& entry : query.GetElements())
+    {
+        const PostingList* list = Find(entry.first);
+        if (list == nullptr)
+        {
+            return result;
+        }
+        Decode(*list, postings);
+        std::vector<Id> ids;
+        for (const auto& posting : postings)
+        {
+            if (posting.count >= entry.second && (ids.empty() || ids.back() != posting.id))
+            {
+                ids.push_back(posting.id);
+            }
+        }
+        lists.push_back(std::move(ids));
+    }
+
+    std::sort(lists.begin(), lists.end(),
+              [](const std::vector<Id>& left, const std::vector<Id>& right) { return left.size() < right.size(); });
+    result = std::move(lists.front());
+    for (std::size_t i = 1; i < lists.size() && !result.empty(); ++i)
+    {
+        result = IntersectSorted(result, lists[i]);
+    }
+    result.erase(std::remove_if(result.begin(), result.end(), [&](Id id) { return !query.IsSubMultiSetOf(sets_[id]); }),
+                 result.end());
+    return result;
+}
+
+/**
+ * @brief Finds the multisets that are sub-multisets of a query by counting matched elements per multiset.
+ * @param query The multiset to look in.
+ * @return The ids of the sub-multisets of the query, in increasing order.
+ */
+auto MultiSetCollection::SubMultiSetsOf(const MultiSet& query) const -> std::vector<Id>
+{
+    std::unordered_map<Id, std::size_t> matched;
+    std::vector<Posting> postings;
+    for (const auto& entry : query.GetElements())
+    {
+        const PostingList* list = Find(entry.first);
+        if (list == nullptr)
+        {
+            continue;
+        }
+        Decode(*list, postings);
+        for (const auto& posting : postings)
+        {
+            if (posting.count <= entry.second)
+            {
+                ++matched[posting.id];
+            }
+        }
+    }
+
+    // Every element of a true sub-multiset is matched by its own query entry, so fewer matches rule a multiset
+    // out. Colliding elements can add matches, so more than one per element only makes it a candidate.
+    std::vector<Id> result(empty_sets_.begin(), empty_sets_.end());
+    for (const auto& [id, count] : matched)
+    {
+        if (count >= sets_[id].GetElements().size() && sets_[id].IsSubMultiSetOf(query))
+        {
+            result.push_back(id);
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+/**
+ * @brief Finds the posting list of an element hash.
+ * @param element The element.
+ * @return The posting list, or nullptr if no multiset holds an element with that hash.
+ */
+auto MultiSetCollection::Find(const Element& element) const -> const PostingList*
+{
+    auto it = postings_.find(VariantHash{}(element));
+    return it == postings_.end() ? nullptr : &it->second;
+}
+
+/**
+ * @brief Decodes a posting list.
+ * @param list The list to decode.
+ * @param postings Receives the postings in increasing id order.
+ */
+void MultiSetCollection::Decode(const PostingList& list, std::vector<Posting>& postings)
+{
+    postings.clear();
+    const std::uint8_t* cursor = list.bytes.data();
+    const std::uint8_t* end = cursor + list.bytes.size();
+    Id id = 0;
+    while (cursor != end)
+    {
+        id += static_cast<Id>(GetVarint(cursor));
+        auto count = static_cast<int>(GetVarint(cursor));
+        postings.push_back(Posting{id, count});
+    }
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+#include "multiset.hpp"
+
+/**
+ * @brief Collection of MultiSets with an inverted index for containment queries.
+ *
+ * Every element hash maps to a posting list of the ids of the multisets
+ * holding the element, each with the element's count there. Ids are
+ * assigned in insertion order, so a posting list only grows at its end
+ * and is stored as delta-encoded varints: a dense list costs one or two
+ * bytes per entry. Queries decode only the lists of the elements they
+ * name and never scan the collection.
+ *
+ * Postings are keyed by VariantHash, and every result is checked
+ * against the stored multiset, so hash collisions cannot produce wrong
+ * answers. Adding is not synchronized, but concurrent queries are safe.
+ */
+class MultiSetCollection
+{
+public:
+    using Id = std::size_t;
+    using Element = MultiSet::Element;
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    /**
+     * @brief Constructs an empty collection.
+     *
+     * @param alloc The allocator to use for the multisets and the index.
+     */
+    explicit MultiSetCollection(const allocator_type& alloc = {});
+
+    allocator_type get_allocator() const { return postings_.get_allocator(); }
+
+    /**
+     * @brief Adds a multiset to the collection.
+     *
+     * @param set The multiset, which is moved into the allocator of the collection.
+     * @return The id of the multiset, which is the number of multisets added before it.
+     */
+    Id Add(MultiSet set);
+
+    /**
+     * @brief Gets a multiset of the collection.
+     *
+     * @param id The id returned by Add().
+     * @return The multiset.
+     * @throws std::out_of_range If id is not in the collection.
+     */
+    const MultiSet& Get(Id id) const;
+
+    /**
+     * @brief Gets the number of multisets in the collection.
+     */
+    std::size_t Size() const { return sets_.size(); }
+
+    /**
+     * @brief Gets the number of bytes of the encoded posting lists.
+     *
+     * @return The memory used by the postings, excluding the table that maps element hashes to them.
+     */
+    std::size_t PostingBytes() const;
+
+    /**
+     * @brief Finds the multisets that contain an element at least a given number of times.
+     *
+     * @param element The element to look for.
+     * @param min_count The smallest count to report.
+     * @return The ids of the matching multisets in increasing order.
+     */
+    std::vector<Id> Containing(const Element& element, int min_count = 1) const;
+
+    /**
+     * @brief Finds the multisets that contain every element of a query at least as often as the query.
+     *
+     * The posting lists of the query elements are intersected, starting
+     * with the shortest one.
+     *
+     * @param query The multiset to look for.
+     * @return The ids of the multisets of which the query is a sub-multiset, in increasing order.
+     */
+    std::vector<Id> ContainingAll(const MultiSet& query) const;
+
+    /**
+     * @brief Finds the multisets that are sub-multisets of a query.
+     *
+     * Only the posting lists of the query elements are read. A multiset
+     * is a candidate when at least as many of its postings were found
+     * with small enough counts as it has distinct elements, and every
+     * candidate is confirmed with IsSubMultiSetOf(). Empty multisets
+     * always match.
+     *
+     * @param query The multiset to look in.
+     * @return The ids of the sub-multisets of the query, in increasing order.
+     */
+    std::vector<Id> SubMultiSetsOf(const MultiSet& query) const;
+
+private:
+    struct PostingList
+    {
+        explicit PostingList(const allocator_type& alloc) : bytes(alloc) {}
+
+        // Varint pairs of (id - previous id, count)
+        std::pmr::vector<std::uint8_t> bytes;
+        Id last = 0;
+    };
+
+    struct Posting
+    {
+        Id id;
+        int count;
+    };
+
+    const PostingList* Find(const Element& element) const;
+
+    static void Decode(const PostingList& list, std::vector<Posting>& postings);
+
+    std::pmr::vector<MultiSet> sets_;
+    std::pmr::vector<Id> empty_sets_;
+    std::pmr::unordered_map<std::uint64_t, PostingList> postings_;
+};
@@ -0,0 +1,172 @@
+#include "multiset_loader.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include "parallel.hpp"
+
+namespace
+{
+using multiset_detail::RunParallel;
+
+/**
+ * @brief Reads the records of one chunk and calls visit(set) for each.
+ * @param input The whole input.
+ * @param begin The offset of the chunk.
+ * @param end The end offset of the chunk.
+ * @param errors Where to report malformed records, or nullptr to throw on the first one.
+ * @param visit The visitor, which receives each multiset as an rvalue.
+ */
+template <typename Visitor>
+void ReadChunk(std::string_view input, std::size_t begin, std::size_t end, std::vector<ParseResult>* errors,
+               Visitor&& visit)
+{
+    // Errors are rare, so lines before the chunk are only counted on the first one
+    std::optional<std::size_t> lines_before;
+    ForEachRecord(input.substr(begin, end - begin), visit,
+                  [&](const ParseResult& result)
+                  {
+                      if (!lines_before)
+                      {
+                          lines_before = static_cast<std::size_t>(
+                              std::count(input.begin(), input.begin() + begin, '\n'));
+                      }
+                      ParseResult error{result.error, begin + result.offset, *lines_before + result.line};
+                      if (errors == nullptr)
+                      {
+                          throw std::runtime_error(DescribeParseFailure(error));
+                      }
+                      errors->push_back(error);
+                  });
+}
+
+/**
+ * @brief Splits the input into one chunk per usable thread.
+ */
+std::vector<std::size_t> SplitForThreads(std::string_view input, std::size_t threads)
+{
+#ifdef MULTISET_SINGLE_THREADED
+    threads = 1;
+#endif
+    return SplitRecords(input, std::max<std::size_t>(threads, 1));
+}
+
+/**
+ * @brief Appends the errors of all chunks, in input order, to the caller's list.
+ */
+void CollectErrors(const std::vector<std::vector<ParseResult>>& chunk_errors, std::vector<ParseResult>* errors)
+{
+    if (errors == nullptr)
+    {
+        return;
+    }
+    for (const auto& chunk : chunk_errors)
+    {
+        errors->insert(errors->end(), chunk.begin(), chunk.end());
+    }
+}
+}  // namespace
+
+/**
+ * @brief Splits input into chunks of whole lines by scanning brace depth.
+ * @param input The records.
+ * @param chunks The number of chunks wanted.
+ * @return The chunk boundaries, starting with 0 and ending with input.size().
+ */
+std::vector<std::size_t> SplitRecords(std::string_view input, std::size_t chunks)
+{
+    std::vector<std::size_t> bounds = {0};
+    std::size_t depth = 0;
+    for (std::size_t i = 0; i < input.size() && bounds.size() < chunks; ++i)
+    {
+        if (input[i] == '{')
+        {
+            ++depth;
+        }
+        // Stray closing braces are left for the parser to report
+        else if (input[i] == '}' && depth > 0)
+        {
+            --depth;
+        }
+        else if (input[i] == '\n' && depth == 0 && i + 1 >= input.size() / chunks * bounds.size())
+        {
+            bounds.push_back(i + 1);
+        }
+    }
+    if (bounds.size() == 1 || bounds.back() != input.size())
+    {
+        bounds.push_back(input.size());
+    }
+    return bounds;
+}
+
+/**
+ * @brief Parses every top-level multiset in the input, one chunk per thread.
+ * @param input The records.
+ * @param threads The number of threads to use.
+ * @param errors Where to report malformed records, or nullptr to throw on the first one.
+ * @return The multisets in input order.
+ */
+std::vector<MultiSet> ParseRecords(std::string_view input, std::size_t threads, std::vector<ParseResult>* errors)
+{
+    std::vector<std::size_t> bounds = SplitForThreads(input, threads);
+    std::vector<std::vector<MultiSet>> chunks(bounds.size() - 1);
+    std::vector<std::vector<ParseResult>> chunk_errors(chunks.size());
+    RunParallel(chunks.size(),
+                [&](std::size_t i)
+                {
+                    ReadChunk(input, bounds[i], bounds[i + 1], errors != nullptr ? &chunk_errors[i] : nullptr,
+                              [&chunk = chunks[i]](MultiSet&& set) { chunk.push_back(std::move(set)); });
+                });
+    CollectErrors(chunk_errors, errors);
+
+    std::size_t total = 0;
+    for (const auto& chunk : chunks)
+    {
+        total += chunk.size();
+    }
+    std::vector<MultiSet> result;
+    result.reserve(total);
+    for (auto& chunk : chunks)
+    {
+        std::move(chunk.begin(), chunk.end(), std::back_inserter(result));
+    }
+    return result;
+}
+
+/**
+ * @brief Sums every top-level multiset in the input, one partial sum per thread.
+ * @param input The records.
+ * @param threads The number of threads to use.
+ * @param errors Where to report malformed records, or nullptr to throw on the first one.
+ * @return The sum of the multisets.
+ */
+MultiSet SumRecords(std::string_view input, std::size_t threads, std::vector<ParseResult>* errors)
+{
+    std::vector<std::size_t> bounds = SplitForThreads(input, threads);
+    std::vector<MultiSet> partials(bounds.size() - 1);
+    std::vector<std::vector<ParseResult>> chunk_errors(partials.size());
+    RunParallel(partials.size(),
+                [&](std::size_t i)
+                {
+                    ReadChunk(input, bounds[i], bounds[i + 1], errors != nullptr ? &chunk_errors[i] : nullptr,
+                              [&partial = partials[i]](MultiSet&& set)
+                              {
+                                  for (const auto& [element, count] : set.GetElements())
+                                  {
+                                      partial.AddElement(element, count);
+                                  }
+                              });
+                });
+    CollectErrors(chunk_errors, errors);
+
+    std::vector<const MultiSet*> pointers;
+    for (const auto& partial : partials)
+    {
+        pointers.push_back(&partial);
+    }
+    return MultiSet::SumAll(pointers.begin(), pointers.end(), partials.size());
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include "multiset.hpp"
+#include "multiset_parser.hpp"
+
+/**
+ * @brief Splits input holding many top-level multisets into chunks of whole records.
+ *
+ * The input is scanned once for brace depth, and each chunk ends after
+ * the first newline at or after its share of the bytes where no brace is
+ * open. No record straddles two chunks, and each chunk starts at a line
+ * start, which is also where ForEachRecord() resumes after a malformed
+ * record, so parsing the chunks separately gives the same records and
+ * errors as parsing the whole input, malformed or not. Chunks are
+ * roughly equal in size; there are fewer of them than requested if the
+ * lines are too few or too long. A record with unbalanced braces throws
+ * off the depth for the rest of the input, which then lands in fewer
+ * chunks.
+ *
+ * @param input The records, e.g. one multiset per line.
+ * @param chunks The number of chunks wanted.
+ * @return The byte offsets of the chunk boundaries, starting with 0 and ending with input.size().
+ */
+std::vector<std::size_t> SplitRecords(std::string_view input, std::size_t chunks);
+
+/**
+ * @brief Parses every top-level multiset in the input, using several threads.
+ *
+ * The input is split with SplitRecords() and each chunk is read in place
+ * with ParseMultiSet() on its own thread. Records may be separated by any
+ * whitespace, but input is only split at newlines. The multisets use the default allocator. Threads are
+ * ignored if MULTISET_SINGLE_THREADED is defined.
+ *
+ * Given an error list, malformed records are skipped as ForEachRecord()
+ * does and reported there in input order, with offsets and lines
+ * relative to the whole input.
+ *
+ * @param input The records.
+ * @param threads The number of threads to use.
+ * @param errors Where to report malformed records, or nullptr to throw on the first one.
+ * @return The multisets in input order.
+ * @throws std::runtime_error If a record is malformed and no error list is given; the message gives its position.
+ */
+std::vector<MultiSet> ParseRecords(std::string_view input, std::size_t threads = 1,
+                                   std::vector<ParseResult>* errors = nullptr);
+
+/**
+ * @brief Sums every top-level multiset in the input, using several threads.
+ *
+ * Each thread adds the records of its chunk into one partial sum as it
+ * reads them, so no more than one record per thread is held at a time.
+ * The partial sums are then combined with SumAll(). Parameters are as for
+ * ParseRecords().
+ *
+ * @param input The records.
+ * @param threads The number of threads to use.
+ * @param errors Where to report malformed records, or nullptr to throw on the first one.
+ * @return The sum of the multisets.
+ * @throws std::runtime_error If a record is malformed and no error list is given; the message gives its position.
+ */
+MultiSet SumRecords(std::string_view input, std::size_t threads = 1, std::vector<ParseResult>* errors = nullptr);
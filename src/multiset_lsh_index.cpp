@@ -0,0 +1,163 @@
+#include "multiset_lsh_index.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string_view>
+
+#include "hash.hpp"
+
+/**
+ * @brief Constructs an empty index.
+ * @param bands The number of bands.
+ * @param rows The number of signature values per band.
+ * @param mode Whether signatures take counts into account.
+ * @param seed A seed to derive the hash functions from.
+ * @param alloc The allocator to use for signatures and buckets.
+ */
+MultiSetLshIndex::MultiSetLshIndex(std::size_t bands, std::size_t rows, MinHash::Mode mode, std::uint64_t seed,
+                                   const allocator_type& alloc)
+    : bands_(bands),
+      rows_(rows),
+      hasher_(bands == 0 || rows == 0 ? 1 : bands * rows, mode, seed),
+      signatures_(alloc),
+      buckets_(alloc)
+{
+    if (bands == 0 || rows == 0)
+    {
+        throw std::invalid_argument("LSH bands and rows must be positive");
+    }
+}
+
+/**
+ * @brief Constructs an empty index whose S-curve is centred on a similarity threshold.
+ * @param threshold The similarity that queries will look for.
+ * @param num_hashes The largest signature length to use.
+ * @param mode Whether signatures take counts into account.
+ * @param seed A seed to derive the hash functions from.
+ * @param alloc The allocator to use for signatures and buckets.
+ * @return The index.
+ */
+MultiSetLshIndex MultiSetLshIndex::ForThreshold(double threshold, std::size_t num_hashes, MinHash::Mode mode,
+                                                std::uint64_t seed, const allocator_type& alloc)
+{
+    if (!(threshold > 0.0 && threshold < 1.0))
+    {
+        throw std::invalid_argument("LSH threshold must lie in (0, 1)");
+    }
+    if (num_hashes == 0)
+    {
+        throw std::invalid_argument("LSH needs at least one hash function");
+    }
+
+    std::size_t best_rows = 1;
+    double best_distance = 2.0;
+    for (std::size_t rows = 1; rows <= num_hashes; ++rows)
+    {
+        auto bands = static_cast<double>(num_hashes / rows);
+        double distance = std::abs(std::pow(1.0 / bands, 1.0 / static_cast<double>(rows)) - threshold);
+        if (distance < best_distance)
+        {
+            best_distance = distance;
+            best_rows = rows;
+        }
+    }
+    return MultiSetLshIndex(num_hashes / best_rows, best_rows, mode, seed, alloc);
+}
+
+/**
+ * @brief Adds a multiset by its signature.
+ * @param signature A signature computed by Hasher().
+ * @return The id of the multiset.
+ */
+auto MultiSetLshIndex::InsertSignature(const MinHash::Signature& signature) -> Id
+{
+    CheckSignature(signature);
+    Id id = size_;
+    signatures_.insert(signatures_.end(), signature.begin(), signature.end());
+    for (std::size_t band = 0; band < bands_; ++band)
+    {
+        buckets_[BandKey(signature.data(), band)].push_back(id);
+    }
+    ++size_;
+    return id;
+}
+
+/**
+ * @brief Finds the multisets whose estimated similarity to a signature is at least a threshold.
+ * @param signature A signature computed by Hasher().
+ * @param threshold The smallest estimated similarity to report.
+ * @return The ids of the matching multisets in increasing order.
+ */
+auto MultiSetLshIndex::QuerySignature(const MinHash::Signature& signature, double threshold) const
+    -> std::vector<Id>
+{
+    std::vector<Id> matches = Candidates(signature);
+    matches.erase(std::remove_if(matches.begin(), matches.end(),
+                                 [&](Id id) { return Similarity(signature, id) < threshold; }),
+                  matches.end());
+    return matches;
+}
+
+/**
+ * @brief Gets the multisets that share at least one bucket with a signature.
+ * @param signature A signature computed by Hasher().
+ * @return The ids of the candidates in increasing order.
+ */
+auto MultiSetLshIndex::Candidates(const MinHash::Signature& signature) const -> std::vector<Id>
+{
+    CheckSignature(signature);
+    std::vector<Id> candidates;
+    for (std::size_t band = 0; band < bands_; ++band)
+    {
+        auto it = buckets_.find(BandKey(signature.data(), band));
+        if (it != buckets_.end())
+        {
+            candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    return candidates;
+}
+
+/**
+ * @brief Estimates the similarity of a signature to an indexed multiset.
+ * @param signature A signature computed by Hasher().
+ * @param id The id of an indexed multiset.
+ * @return The fraction of positions where the signatures agree.
+ */
+double MultiSetLshIndex::Similarity(const MinHash::Signature& signature, Id id) const
+{
+    CheckSignature(signature);
+    if (id >= size_)
+    {
+        throw std::out_of_range("Multiset id is not in the LSH index");
+    }
+    const std::size_t length = hasher_.NumHashes();
+    return MinHash::Similarity(signature.data(), signatures_.data() + id * length, length);
+}
+
+/**
+ * @brief Hashes the values of one band together with the band index.
+ * @param signature The signature.
+ * @param band The band index.
+ * @return The key of the bucket of the band.
+ */
+std::uint64_t MultiSetLshIndex::BandKey(const std::uint32_t* signature, std::size_t band) const
+{
+    std::string_view bytes(reinterpret_cast<const char*>(signature + band * rows_), rows_ * sizeof(std::uint32_t));
+    return HashString(bytes, band);
+}
+
+/**
+ * @brief Checks that a signature was computed with the length of this index.
+ * @param signature The signature to check.
+ */
+void MultiSetLshIndex::CheckSignature(const MinHash::Signature& signature) const
+{
+    if (signature.size() != hasher_.NumHashes())
+    {
+        throw std::invalid_argument("Signature length does not match the LSH index");
+    }
+}
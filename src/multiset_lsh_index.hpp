@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+#include "min_hash.hpp"
+
+/**
+ * @brief Index for finding multisets similar to a query with banded locality-sensitive hashing.
+ *
+ * Every inserted multiset is reduced to a MinHash signature of
+ * Bands() * Rows() values. The signature is cut into bands of Rows()
+ * values, and each band is hashed into a bucket of its own table. Two
+ * multisets with similarity s share at least one bucket with
+ * probability 1 - (1 - s^Rows())^Bands(), an S-curve that rises
+ * steeply around (1 / Bands())^(1 / Rows()). A query only compares
+ * against the multisets in its buckets, so its cost grows with the
+ * number of similar multisets instead of the size of the index.
+ *
+ * Multisets are identified by the dense ids Insert() returns. The index
+ * keeps their signatures but not the multisets themselves. Inserting is
+ * not synchronized, but concurrent queries are safe.
+ */
+class MultiSetLshIndex
+{
+public:
+    using Id = std::size_t;
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    /**
+     * @brief Constructs an empty index.
+     *
+     * @param bands The number of bands.
+     * @param rows The number of signature values per band.
+     * @param mode Whether signatures take counts into account.
+     * @param seed A seed to derive the hash functions from.
+     * @param alloc The allocator to use for signatures and buckets.
+     * @throws std::invalid_argument If bands or rows is zero.
+     */
+    MultiSetLshIndex(std::size_t bands, std::size_t rows, MinHash::Mode mode = MinHash::Mode::kWeighted,
+                     std::uint64_t seed = 0, const allocator_type& alloc = {});
+
+    /**
+     * @brief Constructs an empty index whose S-curve is centred on a similarity threshold.
+     *
+     * Picks the number of rows r and bands b with b * r <= num_hashes for
+     * which (1 / b)^(1 / r) is closest to the threshold.
+     *
+     * @param threshold The similarity that queries will look for, in (0, 1).
+     * @param num_hashes The largest signature length to use.
+     * @param mode Whether signatures take counts into account.
+     * @param seed A seed to derive the hash functions from.
+     * @param alloc The allocator to use for signatures and buckets.
+     * @return The index.
+     * @throws std::invalid_argument If threshold is out of range or num_hashes is zero.
+     */
+    static MultiSetLshIndex ForThreshold(double threshold, std::size_t num_hashes = 128,
+                                         MinHash::Mode mode = MinHash::Mode::kWeighted, std::uint64_t seed = 0,
+                                         const allocator_type& alloc = {});
+
+    allocator_type get_allocator() const { return signatures_.get_allocator(); }
+
+    std::size_t Bands() const { return bands_; }
+
+    std::size_t Rows() const { return rows_; }
+
+    /**
+     * @brief Gets the hasher that computes the signatures of the index.
+     *
+     * @return The hasher, for computing signatures ahead of InsertSignature() or QuerySignature().
+     */
+    const MinHash& Hasher() const { return hasher_; }
+
+    /**
+     * @brief Gets the number of multisets in the index.
+     */
+    std::size_t Size() const { return size_; }
+
+    /**
+     * @brief Adds a multiset to the index.
+     *
+     * @param set A BasicMultiSet or a class derived from one.
+     * @return The id of the multiset, which is the number of multisets inserted before it.
+     */
+    template <typename Set>
+    Id Insert(const Set& set)
+    {
+        return InsertSignature(hasher_.Compute(set));
+    }
+
+    /**
+     * @brief Adds a multiset by its signature.
+     *
+     * @param signature A signature computed by Hasher().
+     * @return The id of the multiset.
+     * @throws std::invalid_argument If the signature has the wrong length.
+     */
+    Id InsertSignature(const MinHash::Signature& signature);
+
+    /**
+     * @brief Finds the multisets whose estimated similarity to a query is at least a threshold.
+     *
+     * Only multisets sharing a bucket with the query are considered, and
+     * their similarity is estimated from the stored signatures. Callers
+     * that need exact similarities can verify the results with
+     * WeightedJaccard().
+     *
+     * @param set A BasicMultiSet or a class derived from one.
+     * @param threshold The smallest estimated similarity to report.
+     * @return The ids of the matching multisets in increasing order.
+     */
+    template <typename Set>
+    std::vector<Id> Query(const Set& set, double threshold) const
+    {
+        return QuerySignature(hasher_.Compute(set), threshold);
+    }
+
+    /**
+     * @brief Finds the multisets whose estimated similarity to a signature is at least a threshold.
+     *
+     * @param signature A signature computed by Hasher().
+     * @param threshold The smallest estimated similarity to report.
+     * @return The ids of the matching multisets in increasing order.
+     * @throws std::invalid_argument If the signature has the wrong length.
+     */
+    std::vector<Id> QuerySignature(const MinHash::Signature& signature, double threshold) const;
+
+    /**
+     * @brief Gets the multisets that share at least one bucket with a signature.
+     *
+     * @param signature A signature computed by Hasher().
+     * @return The ids of the candidates in increasing order.
+     * @throws std::invalid_argument If the signature has the wrong length.
+     */
+    std::vector<Id> Candidates(const MinHash::Signature& signature) const;
+
+    /**
+     * @brief Estimates the similarity of a signature to an indexed multiset.
+     *
+     * @param signature A signature computed by Hasher().
+     * @param id The id of an indexed multiset.
+     * @return The fraction of positions where the signatures agree.
+     * @throws std::out_of_range If id is not in the index.
+     */
+    double Similarity(const MinHash::Signature& signature, Id id) const;
+
+private:
+    std::uint64_t BandKey(const std::uint32_t* signature, std::size_t band) const;
+
+    void CheckSignature(const MinHash::Signature& signature) const;
+
+    std::size_t bands_;
+    std::size_t rows_;
+    MinHash hasher_;
+    std::size_t size_ = 0;
+    // Signatures of all multisets, back to back in id order
+    std::pmr::vector<std::uint32_t> signatures_;
+    // Buckets of all bands in one table, keyed by a hash of the band index and its signature values
+    std::pmr::unordered_map<std::uint64_t, std::pmr::vector<Id>> buckets_;
+};
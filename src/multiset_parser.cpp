@@ -0,0 +1,122 @@
+#include "multiset_parser.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "symbol_table.hpp"
+
+namespace
+{
+/**
+ * @brief Event handler that builds a MultiSet, keeping one element map per open set.
+ */
+class MultiSetBuilder
+{
+public:
+    MultiSetBuilder(const MultiSet::allocator_type& alloc, SymbolTable* symbols) : alloc_(alloc), symbols_(symbols) {}
+
+    void OnBeginSet(std::size_t) { levels_.emplace_back(alloc_); }
+
+    void OnElement(std::string_view text, std::size_t)
+    {
+        if (symbols_ != nullptr)
+        {
+            levels_.back()[symbols_->Intern(text)]++;
+        }
+        else
+        {
+            levels_.back()[std::string(text)]++;
+        }
+    }
+
+    void OnEndSet(std::size_t depth)
+    {
+        MultiSet::ElementMap elements = std::move(levels_.back());
+        levels_.pop_back();
+        if (depth == 0)
+        {
+            result_ = std::move(elements);
+            return;
+        }
+        auto nested = AllocateMultiSet(alloc_);
+        nested->SetSymbolTable(symbols_);
+        nested->SetElements(std::move(elements));
+        levels_.back()[std::move(nested)]++;
+    }
+
+    MultiSet::ElementMap& Result() { return *result_; }
+
+private:
+    MultiSet::allocator_type alloc_;
+    SymbolTable* symbols_;
+    std::vector<MultiSet::ElementMap> levels_;
+    std::optional<MultiSet::ElementMap> result_;
+};
+}  // namespace
+
+/**
+ * @brief Describes a parse error.
+ * @param error The error.
+ * @return A short static description.
+ */
+std::string_view ParseErrorMessage(ParseError error)
+{
+    switch (error)
+    {
+        case ParseError::kNone:
+            return "no error";
+        case ParseError::kExpectedSet:
+            return "expected '{'";
+        case ParseError::kUnexpectedEnd:
+            return "unexpected end of input";
+        case ParseError::kUnexpectedBrace:
+            return "unexpected '{' in element";
+        case ParseError::kExpectedSeparator:
+            return "expected ',' or '}'";
+    }
+    return "unknown error";
+}
+
+/**
+ * @brief Describes a failed parse together with its position.
+ * @param result The failed result.
+ * @return The message.
+ */
+std::string DescribeParseFailure(const ParseResult& result)
+{
+    return "Malformed MultiSet record at byte " + std::to_string(result.offset) + ", line " +
+           std::to_string(result.line) + ": " + std::string(ParseErrorMessage(result.error));
+}
+
+/**
+ * @brief Builds a failed result, counting the lines up to the offending byte.
+ * @param input The parsed input.
+ * @param error The error.
+ * @param offset The position of the offending byte.
+ * @return The result.
+ */
+ParseResult multiset_detail::Failure(std::string_view input, ParseError error, std::size_t offset)
+{
+    auto newlines = std::count(input.begin(), input.begin() + offset, '\n');
+    return ParseResult{error, offset, static_cast<std::size_t>(newlines) + 1};
+}
+
+/**
+ * @brief Parses one multiset from the start of a buffer, leaving the target unchanged on failure.
+ * @param input The buffer.
+ * @param multiset The multiset to fill.
+ * @return The result.
+ */
+ParseResult ParseMultiSet(std::string_view input, MultiSet& multiset)
+{
+    MultiSetBuilder builder(multiset.get_allocator(), multiset.GetSymbolTable());
+    ParseResult result = ParseMultiSetEvents(input, builder);
+    if (result)
+    {
+        multiset.SetElements(std::move(builder.Result()));
+    }
+    return result;
+}
@@ -0,0 +1,358 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "multiset.hpp"
+
+/**
+ * @brief Why a multiset could not be parsed.
+ */
+enum class ParseError
+{
+    kNone,               ///< The input was parsed.
+    kExpectedSet,        ///< A record does not start with '{'.
+    kUnexpectedEnd,      ///< The input ends inside a set.
+    kUnexpectedBrace,    ///< A '{' appears inside element text.
+    kExpectedSeparator,  ///< A nested set is followed by something other than ',' or '}'.
+};
+
+/**
+ * @brief Describes a parse error.
+ *
+ * @param error The error.
+ * @return A short static description.
+ */
+std::string_view ParseErrorMessage(ParseError error);
+
+/**
+ * @brief Outcome of parsing one multiset from a buffer.
+ *
+ * The result is a plain value, so reporting an error costs neither an
+ * exception nor an allocation. On success offset is the position just
+ * after the closing brace, where the next record can be read; on failure
+ * it is the position of the offending byte, and line is its 1-based line.
+ * Lines are only counted once an error occurs.
+ */
+struct ParseResult
+{
+    ParseError error = ParseError::kNone;
+    std::size_t offset = 0;
+    std::size_t line = 0;
+
+    explicit operator bool() const { return error == ParseError::kNone; }
+};
+
+/**
+ * @brief Describes a failed parse together with its position.
+ *
+ * @param result The failed result.
+ * @return A message of the form "Malformed MultiSet record at byte N, line L: description".
+ */
+std::string DescribeParseFailure(const ParseResult& result);
+
+namespace multiset_detail
+{
+using CharTraits = std::char_traits<char>;
+
+/**
+ * @brief Character source reading a stream buffer, copying element text into a reused buffer.
+ */
+class StreamSource
+{
+public:
+    explicit StreamSource(std::streambuf& buffer) : buffer_(buffer) {}
+
+    CharTraits::int_type Peek() { return buffer_.sgetc(); }
+
+    CharTraits::int_type Next()
+    {
+        buffer_.sbumpc();
+        return buffer_.sgetc();
+    }
+
+    /**
+     * @brief Reads element text up to ',', '}', '{' or the end, leaving c at the character that stopped it.
+     */
+    std::string_view ReadText(CharTraits::int_type& c)
+    {
+        text_.clear();
+        while (c != ',' && c != '}' && c != '{' && c != CharTraits::eof())
+        {
+            text_.push_back(CharTraits::to_char_type(c));
+            c = buffer_.snextc();
+        }
+        return text_;
+    }
+
+private:
+    std::streambuf& buffer_;
+    std::string text_;
+};
+
+/**
+ * @brief Character source reading a buffer in place; element text is a view into the buffer.
+ */
+class BufferSource
+{
+public:
+    explicit BufferSource(std::string_view input) : input_(input) {}
+
+    CharTraits::int_type Peek() const
+    {
+        return position_ < input_.size() ? CharTraits::to_int_type(input_[position_]) : CharTraits::eof();
+    }
+
+    CharTraits::int_type Next()
+    {
+        ++position_;
+        return Peek();
+    }
+
+    std::string_view ReadText(CharTraits::int_type& c)
+    {
+        std::size_t begin = position_;
+        while (c != ',' && c != '}' && c != '{' && c != CharTraits::eof())
+        {
+            c = Next();
+        }
+        return input_.substr(begin, position_ - begin);
+    }
+
+    std::size_t Position() const { return position_; }
+
+private:
+    std::string_view input_;
+    std::size_t position_ = 0;
+};
+
+/**
+ * @brief Skips whitespace and returns the next character.
+ */
+template <typename Source>
+CharTraits::int_type SkipWhitespace(Source& source)
+{
+    auto c = source.Peek();
+    while (c != CharTraits::eof() && std::isspace(c))
+    {
+        c = source.Next();
+    }
+    return c;
+}
+
+/**
+ * @brief Parses one multiset from a character source, reporting events to the handler.
+ *
+ * On failure the source is left at the offending character.
+ */
+template <typename Source, typename Handler>
+ParseError ParseEvents(Source& source, Handler& handler)
+{
+    auto c = SkipWhitespace(source);
+    if (c != '{')
+    {
+        return c == CharTraits::eof() ? ParseError::kUnexpectedEnd : ParseError::kExpectedSet;
+    }
+    source.Next();
+    handler.OnBeginSet(std::size_t{0});
+
+    std::size_t depth = 0;
+    bool opened = true;  // Just after '{', where '}' closes an empty set
+    while (true)
+    {
+        c = SkipWhitespace(source);
+        if (c == '{')
+        {
+            source.Next();
+            handler.OnBeginSet(++depth);
+            opened = true;
+            continue;
+        }
+
+        if (c != '}' || !opened)
+        {
+            std::string_view text = source.ReadText(c);
+            if (c == '{')
+            {
+                return ParseError::kUnexpectedBrace;
+            }
+            if (c == CharTraits::eof())
+            {
+                return ParseError::kUnexpectedEnd;
+            }
+            handler.OnElement(text, depth);
+        }
+
+        // Close every set that ends here, then expect a separator
+        while (c == '}')
+        {
+            source.Next();
+            handler.OnEndSet(depth);
+            if (depth == 0)
+            {
+                return ParseError::kNone;
+            }
+            --depth;
+            c = SkipWhitespace(source);
+        }
+        if (c != ',')
+        {
+            return c == CharTraits::eof() ? ParseError::kUnexpectedEnd : ParseError::kExpectedSeparator;
+        }
+        source.Next();
+        opened = false;
+    }
+}
+
+/**
+ * @brief Fills in the line of a failed result by counting the newlines before its offset.
+ */
+ParseResult Failure(std::string_view input, ParseError error, std::size_t offset);
+}  // namespace multiset_detail
+
+/**
+ * @brief Reads one multiset in the brace format and reports it as a sequence of events.
+ *
+ * The input has the syntax operator>> reads, e.g. "{a,b,{c,a}}". Instead
+ * of building a MultiSet the parser calls, in input order:
+ *
+ *   handler.OnBeginSet(depth)          when a set opens,
+ *   handler.OnElement(text, depth)     for every string element,
+ *   handler.OnEndSet(depth)            when a set closes,
+ *
+ * where depth is 0 for the top-level set and grows by one per nesting
+ * level; an element reports the depth of the set holding it. The text of
+ * an element is only valid during its callback. The parser keeps a depth
+ * counter and one buffer for the current element, so memory stays
+ * bounded by the longest element however large or deep the input is.
+ *
+ * Elements are tokenized as operator>> does: leading whitespace is
+ * skipped and the text runs up to the next ',' or '}'. Two cases differ
+ * from operator>>: whitespace may precede a nested set, and "{}" is the
+ * empty set rather than a set holding one empty string. Braces cannot
+ * appear inside element text.
+ *
+ * Reading starts at the current position and stops right after the
+ * closing brace of the top-level set, so records can be read one after
+ * another from the same stream. Malformed input sets failbit; events
+ * reported before the error are not retracted.
+ *
+ * @param is The stream to read from.
+ * @param handler The event handler.
+ * @return True if a complete multiset was read.
+ */
+template <typename Handler>
+bool ParseMultiSetEvents(std::istream& is, Handler&& handler)
+{
+    std::istream::sentry sentry(is);  // Skips leading whitespace
+    if (!sentry)
+    {
+        return false;
+    }
+
+    multiset_detail::StreamSource source(*is.rdbuf());
+    ParseError error = multiset_detail::ParseEvents(source, handler);
+    if (error == ParseError::kUnexpectedEnd)
+    {
+        is.setstate(std::ios::eofbit | std::ios::failbit);
+    }
+    else if (error != ParseError::kNone)
+    {
+        is.setstate(std::ios::failbit);
+    }
+    return error == ParseError::kNone;
+}
+
+/**
+ * @brief Reads one multiset from the start of a buffer and reports it as a sequence of events.
+ *
+ * The events and the syntax are those of the stream overload, but the
+ * buffer is read in place: element text is a view into the input, and
+ * nothing is allocated.
+ *
+ * @param input The buffer; leading whitespace is skipped.
+ * @param handler The event handler.
+ * @return The result, whose offset on success is where the next record starts.
+ */
+template <typename Handler>
+ParseResult ParseMultiSetEvents(std::string_view input, Handler&& handler)
+{
+    multiset_detail::BufferSource source(input);
+    ParseError error = multiset_detail::ParseEvents(source, handler);
+    if (error != ParseError::kNone)
+    {
+        return multiset_detail::Failure(input, error, source.Position());
+    }
+    return ParseResult{ParseError::kNone, source.Position(), 0};
+}
+
+/**
+ * @brief Parses one multiset from the start of a buffer.
+ *
+ * The syntax is that of ParseMultiSetEvents(). Strings are interned if
+ * the target has a symbol table, and nested sets use the target's
+ * allocator and symbol table, as with operator>>. Unlike operator>>, the
+ * target is left unchanged if the input is malformed.
+ *
+ * @param input The buffer; leading whitespace is skipped.
+ * @param multiset The multiset to fill.
+ * @return The result, whose offset on success is where the next record starts.
+ */
+ParseResult ParseMultiSet(std::string_view input, MultiSet& multiset);
+
+/**
+ * @brief Parses a batch of records, skipping malformed ones.
+ *
+ * Records follow each other separated by whitespace, normally one per
+ * line. After a malformed record the parser resynchronizes at the line
+ * following the start of that record and goes on, so one bad record
+ * costs only itself. Offsets and lines in reported errors are relative to
+ * the whole input.
+ *
+ * @param input The records.
+ * @param visit Called with each parsed MultiSet as an rvalue.
+ * @param on_error Called with the ParseResult of each malformed record.
+ * @return The number of records parsed.
+ */
+template <typename RecordVisitor, typename ErrorVisitor>
+std::size_t ForEachRecord(std::string_view input, RecordVisitor&& visit, ErrorVisitor&& on_error)
+{
+    std::size_t records = 0;
+    std::size_t position = 0;
+    std::size_t lines = 0;    // Newlines before counted
+    std::size_t counted = 0;
+    while (true)
+    {
+        while (position < input.size() && std::isspace(static_cast<unsigned char>(input[position])))
+        {
+            ++position;
+        }
+        if (position == input.size())
+        {
+            return records;
+        }
+
+        MultiSet set;
+        ParseResult result = ParseMultiSet(input.substr(position), set);
+        if (result)
+        {
+            position += result.offset;
+            ++records;
+            visit(std::move(set));
+            continue;
+        }
+
+        // Lines are counted incrementally, so that many errors still cost one pass over the input
+        lines += static_cast<std::size_t>(std::count(input.begin() + counted, input.begin() + position, '\n'));
+        counted = position;
+        on_error(ParseResult{result.error, position + result.offset, lines + result.line});
+        std::size_t next_line = input.find('\n', position);
+        position = next_line == std::string_view::npos ? input.size() : next_line + 1;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace multiset_detail
+{
+/**
+ * @brief Runs task(0) ... task(tasks - 1) concurrently, one of them on the calling thread.
+ *
+ * Tasks that cannot get a thread run on the calling thread. The first exception thrown by a task is rethrown
+ * after all tasks have finished.
+ *
+ * @param tasks The number of tasks, at least one.
+ * @param task The task to run, called with the task index.
+ */
+template <typename Task>
+void RunParallel(std::size_t tasks, Task task)
+{
+    std::vector<std::exception_ptr> errors(tasks);
+    auto run = [&](std::size_t i)
+    {
+        try
+        {
+            task(i);
+        }
+        catch (...)
+        {
+            errors[i] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(tasks - 1);
+    for (std::size_t i = 1; i < tasks; ++i)
+    {
+        try
+        {
+            workers.emplace_back(run, i);
+        }
+        catch (const std::system_error&)
+        {
+            run(i);
+        }
+    }
+    run(0);
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    for (const auto& error : errors)
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+}
+}  // namespace multiset_detail
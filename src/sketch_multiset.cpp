@@ -0,0 +1,199 @@
+#include "sketch_multiset.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "hash.hpp"
+
+namespace
+{
+// Odd step between the seeds of consecutive rows
+constexpr std::uint64_t kRowStep = 0x9e3779b97f4a7c15ull;
+}  // namespace
+
+/**
+ * @brief Constructs an empty sketch with the given dimensions.
+ * @param width The number of counters per row.
+ * @param depth The number of rows.
+ * @param mode The sketch mode.
+ * @param seed A seed to derive the row hash functions from.
+ * @param alloc The allocator to use for the counters.
+ */
+SketchMultiSet::SketchMultiSet(std::size_t width, std::size_t depth, Mode mode, std::uint64_t seed,
+                               const allocator_type& alloc)
+    : width_(width), depth_(depth), mode_(mode), seed_(seed), counters_(alloc)
+{
+    if (width == 0 || depth == 0)
+    {
+        throw std::invalid_argument("Sketch dimensions must be positive");
+    }
+    if (depth > kMaxDepth)
+    {
+        throw std::invalid_argument("Sketch depth exceeds SketchMultiSet::kMaxDepth");
+    }
+    counters_.assign(width * depth, 0);
+}
+
+/**
+ * @brief Constructs an empty sketch sized for the given error bounds.
+ * @param epsilon The relative error.
+ * @param delta The failure probability.
+ * @param mode The sketch mode.
+ * @param seed A seed to derive the row hash functions from.
+ * @param alloc The allocator to use for the counters.
+ * @return The sketch.
+ */
+SketchMultiSet SketchMultiSet::WithErrorBounds(double epsilon, double delta, Mode mode, std::uint64_t seed,
+                                               const allocator_type& alloc)
+{
+    if (!(epsilon > 0.0 && epsilon < 1.0) || !(delta > 0.0 && delta < 1.0))
+    {
+        throw std::invalid_argument("Sketch error bounds must lie in (0, 1)");
+    }
+    // Count-Sketch needs O(1 / epsilon^2) counters per row for an L2 error bound
+    double width = mode == Mode::kCountMin ? std::exp(1.0) / epsilon : 3.0 / (epsilon * epsilon);
+    double depth = std::log(1.0 / delta);
+    return SketchMultiSet(static_cast<std::size_t>(std::ceil(width)),
+                          std::clamp<std::size_t>(static_cast<std::size_t>(std::ceil(depth)), 1, kMaxDepth), mode,
+                          seed, alloc);
+}
+
+/**
+ * @brief Adds occurrences of an element.
+ * @param element The element to add.
+ * @param count The number of occurrences to add.
+ */
+void SketchMultiSet::AddElement(const Element& element, std::int64_t count)
+{
+    AddHash(VariantHash{}(element), count);
+}
+
+/**
+ * @brief Adds occurrences of a string element, hashed as VariantHash hashes strings.
+ * @param text The string to add.
+ * @param count The number of occurrences to add.
+ */
+void SketchMultiSet::AddString(std::string_view text, std::int64_t count)
+{
+    AddHash(static_cast<std::size_t>(HashString(text)), count);
+}
+
+/**
+ * @brief Estimates the number of occurrences of an element.
+ * @param element The element to look up.
+ * @return The estimated count.
+ */
+std::int64_t SketchMultiSet::Count(const Element& element) const { return CountHash(VariantHash{}(element)); }
+
+/**
+ * @brief Estimates the number of occurrences of a string element.
+ * @param text The string to look up.
+ * @return The estimated count.
+ */
+std::int64_t SketchMultiSet::CountString(std::string_view text) const
+{
+    return CountHash(static_cast<std::size_t>(HashString(text)));
+}
+
+/**
+ * @brief Checks whether another sketch can be merged into this one.
+ * @param other The other sketch.
+ * @return True if both sketches have the same dimensions, mode and seed.
+ */
+bool SketchMultiSet::IsCompatible(const SketchMultiSet& other) const
+{
+    return width_ == other.width_ && depth_ == other.depth_ && mode_ == other.mode_ && seed_ == other.seed_;
+}
+
+/**
+ * @brief Merges two sketches into a new one that uses the allocator of this sketch.
+ * @param other The sketch to merge with.
+ * @return A new sketch of the sum.
+ */
+SketchMultiSet SketchMultiSet::operator+(const SketchMultiSet& other) const
+{
+    SketchMultiSet result(width_, depth_, mode_, seed_, get_allocator());
+    result.counters_ = counters_;
+    result.total_ = total_;
+    result += other;
+    return result;
+}
+
+/**
+ * @brief Merges another sketch into this one by adding its counters.
+ * @param other The sketch to merge.
+ * @return A reference to this sketch.
+ */
+SketchMultiSet& SketchMultiSet::operator+=(const SketchMultiSet& other)
+{
+    if (!IsCompatible(other))
+    {
+        throw std::invalid_argument("Sketches with different dimensions, modes or seeds cannot be merged");
+    }
+    for (std::size_t i = 0; i < counters_.size(); ++i)
+    {
+        counters_[i] += other.counters_[i];
+    }
+    total_ += other.total_;
+    return *this;
+}
+
+/**
+ * @brief Derives the hash for one row from the element hash.
+ * @param hash The element hash.
+ * @param row The row index.
+ * @return The row hash, whose remainder selects the counter and whose top bit is the Count-Sketch sign.
+ */
+std::uint64_t SketchMultiSet::RowHash(std::uint64_t hash, std::size_t row) const
+{
+    return MixHash(hash ^ (seed_ + (row + 1) * kRowStep));
+}
+
+/**
+ * @brief Adds a count to the counter of each row selected by the element hash.
+ * @param hash The element hash.
+ * @param count The number of occurrences to add.
+ */
+void SketchMultiSet::AddHash(std::uint64_t hash, std::int64_t count)
+{
+    for (std::size_t row = 0; row < depth_; ++row)
+    {
+        std::uint64_t row_hash = RowHash(hash, row);
+        std::int64_t delta = mode_ == Mode::kCountSketch && (row_hash >> 63) != 0 ? -count : count;
+        counters_[row * width_ + row_hash % width_] += delta;
+    }
+    total_ += count;
+}
+
+/**
+ * @brief Combines the counters selected by the element hash into an estimate.
+ * @param hash The element hash.
+ * @return The minimum over the rows in Count-Min mode, the median of the signed counters in Count-Sketch mode.
+ */
+std::int64_t SketchMultiSet::CountHash(std::uint64_t hash) const
+{
+    if (mode_ == Mode::kCountMin)
+    {
+        std::int64_t estimate = std::numeric_limits<std::int64_t>::max();
+        for (std::size_t row = 0; row < depth_; ++row)
+        {
+            estimate = std::min(estimate, counters_[row * width_ + RowHash(hash, row) % width_]);
+        }
+        return estimate;
+    }
+
+    // Queries may run concurrently on a const sketch, so the estimates go to a stack buffer rather than a member
+    std::array<std::int64_t, kMaxDepth> estimates;
+    for (std::size_t row = 0; row < depth_; ++row)
+    {
+        std::uint64_t row_hash = RowHash(hash, row);
+        std::int64_t counter = counters_[row * width_ + row_hash % width_];
+        estimates[row] = (row_hash >> 63) != 0 ? -counter : counter;
+    }
+    auto middle = estimates.begin() + depth_ / 2;
+    std::nth_element(estimates.begin(), middle, estimates.begin() + depth_);
+    return *middle;
+}
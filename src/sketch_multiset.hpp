@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+#include "multiset.hpp"
+
+/**
+ * @brief Approximate multiset of elements backed by a Count-Min or Count-Sketch.
+ *
+ * A SketchMultiSet stores a fixed depth x width grid of counters instead
+ * of the elements themselves, so its memory does not grow with the
+ * number of distinct elements. Each element is hashed once with
+ * VariantHash and mapped to one counter per row.
+ *
+ * In Count-Min mode an estimate is the minimum over the rows. It never
+ * underestimates, and with width = ceil(e / epsilon) and depth =
+ * ceil(ln(1 / delta)) it overestimates by more than epsilon * Size()
+ * with probability at most delta. In Count-Sketch mode each row adds a
+ * random sign and an estimate is the median over the rows, which is
+ * unbiased and bounds the error by the L2 norm of the counts instead.
+ *
+ * Sketches with the same dimensions, mode and seed can be merged by
+ * adding their counters, which sums the underlying multisets.
+ */
+class SketchMultiSet
+{
+public:
+    using Element = MultiSet::Element;
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    /**
+     * @brief How counters are updated and combined into estimates.
+     */
+    enum class Mode
+    {
+        kCountMin,
+        kCountSketch
+    };
+
+    /**
+     * @brief Largest number of rows, which bounds the per-query buffer of Count-Sketch estimates.
+     *
+     * The failure probability falls as exp(-depth), so deeper sketches gain nothing measurable.
+     */
+    static constexpr std::size_t kMaxDepth = 64;
+
+    /**
+     * @brief Constructs an empty sketch with the given dimensions.
+     *
+     * @param width The number of counters per row.
+     * @param depth The number of rows, at most kMaxDepth.
+     * @param mode The sketch mode.
+     * @param seed A seed to derive the row hash functions from.
+     * @param alloc The allocator to use for the counters.
+     * @throws std::invalid_argument If width or depth is zero or depth exceeds kMaxDepth.
+     */
+    SketchMultiSet(std::size_t width, std::size_t depth, Mode mode = Mode::kCountMin, std::uint64_t seed = 0,
+                   const allocator_type& alloc = {});
+
+    /**
+     * @brief Constructs an empty sketch sized for the given error bounds.
+     *
+     * In Count-Min mode estimates are within epsilon * Size() of the
+     * true count with probability 1 - delta. In Count-Sketch mode they
+     * are within epsilon times the L2 norm of the counts.
+     *
+     * @param epsilon The relative error, in (0, 1).
+     * @param delta The failure probability, in (0, 1); the depth is capped at kMaxDepth.
+     * @param mode The sketch mode.
+     * @param seed A seed to derive the row hash functions from.
+     * @param alloc The allocator to use for the counters.
+     * @return The sketch.
+     * @throws std::invalid_argument If epsilon or delta is out of range.
+     */
+    static SketchMultiSet WithErrorBounds(double epsilon, double delta, Mode mode = Mode::kCountMin,
+                                          std::uint64_t seed = 0, const allocator_type& alloc = {});
+
+    /**
+     * @brief Gets the allocator used by the sketch.
+     *
+     * @return The allocator of the sketch.
+     */
+    allocator_type get_allocator() const { return counters_.get_allocator(); }
+
+    /**
+     * @brief Adds occurrences of an element.
+     *
+     * @param element The element to add.
+     * @param count The number of occurrences to add.
+     */
+    void AddElement(const Element& element, std::int64_t count = 1);
+
+    /**
+     * @brief Adds occurrences of a string element without constructing an Element.
+     *
+     * @param text The string to add.
+     * @param count The number of occurrences to add.
+     */
+    void AddString(std::string_view text, std::int64_t count = 1);
+
+    /**
+     * @brief Estimates the number of occurrences of an element.
+     *
+     * @param element The element to look up.
+     * @return The estimated count.
+     */
+    std::int64_t Count(const Element& element) const;
+
+    /**
+     * @brief Estimates the number of occurrences of a string element.
+     *
+     * @param text The string to look up.
+     * @return The estimated count.
+     */
+    std::int64_t CountString(std::string_view text) const;
+
+    /**
+     * @brief Gets the total number of occurrences added, which is exact.
+     *
+     * @return The size of the underlying multiset.
+     */
+    std::int64_t Size() const { return total_; }
+
+    std::size_t Width() const { return width_; }
+
+    std::size_t Depth() const { return depth_; }
+
+    Mode GetMode() const { return mode_; }
+
+    /**
+     * @brief Gets the number of bytes used by the counters.
+     *
+     * @return The memory used by the sketch, excluding the object itself.
+     */
+    std::size_t MemoryUsage() const { return counters_.size() * sizeof(std::int64_t); }
+
+    /**
+     * @brief Checks whether another sketch can be merged into this one.
+     *
+     * @param other The other sketch.
+     * @return True if both sketches have the same dimensions, mode and seed.
+     */
+    bool IsCompatible(const SketchMultiSet& other) const;
+
+    /**
+     * @brief Merges two sketches, summing the underlying multisets.
+     *
+     * @param other The sketch to merge with.
+     * @return A new sketch of the sum.
+     * @throws std::invalid_argument If the sketches are not compatible.
+     */
+    SketchMultiSet operator+(const SketchMultiSet& other) const;
+
+    /**
+     * @brief Merges another sketch into this one.
+     *
+     * @param other The sketch to merge.
+     * @return A reference to this sketch.
+     * @throws std::invalid_argument If the sketches are not compatible.
+     */
+    SketchMultiSet& operator+=(const SketchMultiSet& other);
+
+private:
+    std::uint64_t RowHash(std::uint64_t hash, std::size_t row) const;
+
+    void AddHash(std::uint64_t hash, std::int64_t count);
+
+    std::int64_t CountHash(std::uint64_t hash) const;
+
+    std::size_t width_;
+    std::size_t depth_;
+    Mode mode_;
+    std::uint64_t seed_;
+    std::int64_t total_ = 0;
+    std::pmr::vector<std::int64_t> counters_;
+};
@@ -0,0 +1,566 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * @brief Hash map that stores up to N entries inline before switching to a hash table.
+ *
+ * While the map holds at most N entries they live in an inline array
+ * next to a parallel array of cached hash tags. A lookup hashes the key
+ * once, compares the tag against all N cached tags in a branch-free loop
+ * the compiler can vectorize, and only calls Eq on tag matches. Inserting
+ * entry N + 1 moves all entries into a std::pmr::unordered_map allocated
+ * from the map's allocator, so small maps never allocate. The inline
+ * array shares its storage with the pointer to that table, so a promoted
+ * map carries no more than the unused inline bytes.
+ *
+ * Inline entries are stored as std::pair<K, V> so that moving them moves
+ * the key, and are exposed through iterators as the layout-identical
+ * value_type. Moving a map therefore does not copy keys and is noexcept
+ * whenever K and V move without throwing.
+ *
+ * The interface is the subset of std::unordered_map used by the multiset
+ * classes. Inserting may invalidate iterators and references in inline
+ * mode, and erasing an entry moves the last inline entry into its place.
+ * Hash and Eq are default-constructed where needed.
+ *
+ * @tparam K The key type.
+ * @tparam V The mapped type.
+ * @tparam Hash The hash functor for keys.
+ * @tparam Eq The equality functor for keys.
+ * @tparam N The number of inline entries.
+ */
+template <typename K, typename V, typename Hash, typename Eq, std::size_t N>
+class SmallHashMap
+{
+    static_assert(N > 0 && N <= 32, "inline capacity must fit the tag match mask");
+
+    using Map = std::pmr::unordered_map<K, V, Hash, Eq>;
+    using Slot = std::pair<K, V>;
+
+    template <bool IsConst>
+    class Iterator;
+
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<const K, V>;
+    using size_type = std::size_t;
+    using hasher = Hash;
+    using key_equal = Eq;
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    static constexpr std::size_t kInlineCapacity = N;
+
+    SmallHashMap() = default;
+
+    explicit SmallHashMap(const allocator_type& alloc) : alloc_(alloc) {}
+
+    SmallHashMap(const SmallHashMap& other) : SmallHashMap(other, allocator_type()) {}
+
+    SmallHashMap(const SmallHashMap& other, const allocator_type& alloc) : alloc_(alloc) { CopyFrom(other); }
+
+    SmallHashMap(SmallHashMap&& other) noexcept(std::is_nothrow_move_constructible_v<Slot>)
+        : alloc_(other.alloc_)
+    {
+        StealFrom(other);
+    }
+
+    SmallHashMap(SmallHashMap&& other, const allocator_type& alloc) : alloc_(alloc)
+    {
+        if (alloc_ == other.alloc_)
+        {
+            StealFrom(other);
+        }
+        else
+        {
+            CopyFrom(other);
+        }
+    }
+
+    ~SmallHashMap() { clear(); }
+
+    SmallHashMap& operator=(const SmallHashMap& other)
+    {
+        if (this != &other)
+        {
+            clear();
+            CopyFrom(other);
+        }
+        return *this;
+    }
+
+    SmallHashMap& operator=(SmallHashMap&& other)
+    {
+        if (this != &other)
+        {
+            clear();
+            if (alloc_ == other.alloc_)
+            {
+                StealFrom(other);
+            }
+            else
+            {
+                CopyFrom(other);
+            }
+        }
+        return *this;
+    }
+
+    allocator_type get_allocator() const { return alloc_; }
+
+    hasher hash_function() const { return Hash(); }
+
+    key_equal key_eq() const { return Eq(); }
+
+    /**
+     * @brief Checks whether the entries are stored inline.
+     *
+     * @return True if the map has not been promoted to a hash table.
+     */
+    bool IsInline() const { return !promoted_; }
+
+    size_type size() const { return promoted_ ? map_->size() : size_; }
+
+    bool empty() const { return size() == 0; }
+
+    iterator begin() { return promoted_ ? iterator(map_->begin()) : iterator(Slots()); }
+
+    iterator end() { return promoted_ ? iterator(map_->end()) : iterator(Slots() + size_); }
+
+    const_iterator begin() const { return promoted_ ? const_iterator(map_->cbegin()) : const_iterator(Slots()); }
+
+    const_iterator end() const { return promoted_ ? const_iterator(map_->cend()) : const_iterator(Slots() + size_); }
+
+    const_iterator cbegin() const { return begin(); }
+
+    const_iterator cend() const { return end(); }
+
+    iterator find(const K& key)
+    {
+        if (promoted_)
+        {
+            return iterator(map_->find(key));
+        }
+        return iterator(Slots() + FindInline(key, Tag(Hash()(key))));
+    }
+
+    const_iterator find(const K& key) const
+    {
+        if (promoted_)
+        {
+            return const_iterator(map_->find(key));
+        }
+        return const_iterator(Slots() + FindInline(key, Tag(Hash()(key))));
+    }
+
+    size_type count(const K& key) const { return find(key) != end() ? 1 : 0; }
+
+    V& at(const K& key)
+    {
+        auto it = find(key);
+        if (it == end())
+        {
+            throw std::out_of_range("SmallHashMap::at");
+        }
+        return it->second;
+    }
+
+    const V& at(const K& key) const
+    {
+        auto it = find(key);
+        if (it == end())
+        {
+            throw std::out_of_range("SmallHashMap::at");
+        }
+        return it->second;
+    }
+
+    V& operator[](const K& key) { return try_emplace(key).first->second; }
+
+    V& operator[](K&& key) { return try_emplace(std::move(key)).first->second; }
+
+    /**
+     * @brief Inserts a value constructed from args if the key is not present.
+     *
+     * The key is hashed once. If inserting would exceed the inline
+     * capacity, the map is promoted to a hash table first.
+     *
+     * @param key The key to look up or insert.
+     * @param args The arguments to construct the mapped value from.
+     * @return An iterator to the entry and whether it was inserted.
+     */
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args)
+    {
+        return TryEmplace(key, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(K&& key, Args&&... args)
+    {
+        return TryEmplace(std::move(key), std::forward<Args>(args)...);
+    }
+
+    iterator erase(const_iterator pos)
+    {
+        if (promoted_)
+        {
+            return iterator(map_->erase(pos.map_it_));
+        }
+        std::size_t index = pos.slot_ - Slots();
+        --size_;
+        if (index != size_)
+        {
+            Slots()[index] = std::move(Slots()[size_]);
+            inline_.tags[index] = inline_.tags[size_];
+        }
+        Slots()[size_].~Slot();
+        return iterator(Slots() + index);
+    }
+
+    iterator erase(iterator pos) { return erase(const_iterator(pos)); }
+
+    size_type erase(const K& key)
+    {
+        auto it = find(key);
+        if (it == end())
+        {
+            return 0;
+        }
+        erase(it);
+        return 1;
+    }
+
+    void clear()
+    {
+        if (promoted_)
+        {
+            std::pmr::polymorphic_allocator<Map> map_alloc(alloc_);
+            map_->~Map();
+            map_alloc.deallocate(map_, 1);
+            ::new (static_cast<void*>(&inline_)) InlineSlots();
+            promoted_ = false;
+        }
+        for (std::size_t i = 0; i < size_; ++i)
+        {
+            Slots()[i].~Slot();
+        }
+        size_ = 0;
+    }
+
+    /**
+     * @brief Reserves space for at least count entries.
+     *
+     * Reserving more than the inline capacity promotes the map.
+     *
+     * @param count The number of entries to reserve space for.
+     */
+    void reserve(size_type count)
+    {
+        if (promoted_)
+        {
+            map_->reserve(count);
+        }
+        else if (count > N)
+        {
+            Promote(count);
+        }
+    }
+
+private:
+    template <bool IsConst>
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = SmallHashMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<IsConst, const value_type*, value_type*>;
+        using reference = std::conditional_t<IsConst, const value_type&, value_type&>;
+
+        Iterator() = default;
+
+        template <bool OtherConst, typename = std::enable_if_t<IsConst && !OtherConst>>
+        Iterator(const Iterator<OtherConst>& other) : slot_(other.slot_), map_it_(other.map_it_)
+        {
+        }
+
+        reference operator*() const { return slot_ ? AsValue(*slot_) : *map_it_; }
+
+        pointer operator->() const { return &**this; }
+
+        Iterator& operator++()
+        {
+            if (slot_)
+            {
+                ++slot_;
+            }
+            else
+            {
+                ++map_it_;
+            }
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        friend bool operator==(const Iterator& lhs, const Iterator& rhs)
+        {
+            return lhs.slot_ == rhs.slot_ && lhs.map_it_ == rhs.map_it_;
+        }
+
+        friend bool operator!=(const Iterator& lhs, const Iterator& rhs) { return !(lhs == rhs); }
+
+    private:
+        friend class SmallHashMap;
+        template <bool>
+        friend class Iterator;
+
+        using SlotPointer = std::conditional_t<IsConst, const Slot*, Slot*>;
+        using MapIterator = std::conditional_t<IsConst, typename Map::const_iterator, typename Map::iterator>;
+
+        explicit Iterator(SlotPointer slot) : slot_(slot) {}
+
+        explicit Iterator(MapIterator map_it) : map_it_(map_it) {}
+
+        SlotPointer slot_ = nullptr;
+        MapIterator map_it_{};
+    };
+
+    template <typename KeyArg, typename... Args>
+    std::pair<iterator, bool> TryEmplace(KeyArg&& key, Args&&... args)
+    {
+        if (!promoted_)
+        {
+            std::uint32_t tag = Tag(Hash()(key));
+            std::size_t index = FindInline(key, tag);
+            if (index != size_)
+            {
+                return {iterator(Slots() + index), false};
+            }
+            if (size_ < N)
+            {
+                ::new (static_cast<void*>(Slots() + size_))
+                    Slot(std::piecewise_construct, std::forward_as_tuple(std::forward<KeyArg>(key)),
+                         std::forward_as_tuple(std::forward<Args>(args)...));
+                inline_.tags[size_] = tag;
+                return {iterator(Slots() + size_++), true};
+            }
+            Promote(N + 1);
+        }
+        auto result = map_->try_emplace(std::forward<KeyArg>(key), std::forward<Args>(args)...);
+        return {iterator(result.first), result.second};
+    }
+
+    static std::uint32_t Tag(std::size_t hash)
+    {
+        return static_cast<std::uint32_t>(hash ^ (hash >> (sizeof(std::size_t) * 4)));
+    }
+
+    Slot* Slots() { return std::launder(reinterpret_cast<Slot*>(inline_.slots)); }
+
+    const Slot* Slots() const { return std::launder(reinterpret_cast<const Slot*>(inline_.slots)); }
+
+    // Keys of stored slots are never modified, so a slot can be handed out as the pair<const K, V> it is laid out as
+    static value_type& AsValue(Slot& slot) { return *std::launder(reinterpret_cast<value_type*>(&slot)); }
+
+    static const value_type& AsValue(const Slot& slot)
+    {
+        return *std::launder(reinterpret_cast<const value_type*>(&slot));
+    }
+
+    /**
+     * @brief Finds the inline slot holding the key.
+     *
+     * @return The slot index, or size_ if the key is not stored inline.
+     */
+    std::size_t FindInline(const K& key, std::uint32_t tag) const
+    {
+        // Compare against every cached tag without early exit so the loop vectorizes
+        std::uint32_t matches = 0;
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            matches |= static_cast<std::uint32_t>(inline_.tags[i] == tag) << i;
+        }
+        matches &= static_cast<std::uint32_t>((std::uint64_t{1} << size_) - 1);
+
+        for (std::size_t i = 0; matches != 0; ++i, matches >>= 1)
+        {
+            if ((matches & 1) && Eq()(Slots()[i].first, key))
+            {
+                return i;
+            }
+        }
+        return size_;
+    }
+
+    // Slots are moved into the table when that cannot throw and copied otherwise, as std::move_if_noexcept does
+    static constexpr bool kMovesSlots =
+        (std::is_nothrow_move_constructible_v<K> || !std::is_copy_constructible_v<K>) ||
+        (std::is_nothrow_move_constructible_v<V> || !std::is_copy_constructible_v<V>);
+
+    /**
+     * @brief Moves the inline entries into a newly allocated hash table.
+     *
+     * If building the table throws, the table is destroyed and the inline slots are left as they were.
+     */
+    void Promote(size_type capacity)
+    {
+        std::pmr::polymorphic_allocator<Map> map_alloc(alloc_);
+        Map* map = map_alloc.allocate(1);
+        try
+        {
+            map_alloc.construct(map);
+        }
+        catch (...)
+        {
+            map_alloc.deallocate(map, 1);
+            throw;
+        }
+
+        typename Map::iterator inserted[N];
+        std::size_t count = 0;
+        try
+        {
+            map->reserve(capacity);
+            for (; count < size_; ++count)
+            {
+                // try_emplace hashes the key and allocates the node before moving from the slot
+                Slot& slot = Slots()[count];
+                inserted[count] =
+                    map->try_emplace(std::move_if_noexcept(slot.first), std::move_if_noexcept(slot.second)).first;
+            }
+        }
+        catch (...)
+        {
+            if constexpr (kMovesSlots)
+            {
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    auto node = map->extract(inserted[i]);
+                    Slot* slot = Slots() + i;
+                    slot->~Slot();
+                    ::new (static_cast<void*>(slot))
+                        Slot(std::move_if_noexcept(node.key()), std::move_if_noexcept(node.mapped()));
+                }
+            }
+            map_alloc.destroy(map);
+            map_alloc.deallocate(map, 1);
+            throw;
+        }
+        clear();
+        map_ = map;
+        promoted_ = true;
+    }
+
+    void CopyFrom(const SmallHashMap& other)
+    {
+        if (other.promoted_)
+        {
+            // Copy-constructing the table reuses cached hash codes instead of rehashing every key
+            std::pmr::polymorphic_allocator<Map> map_alloc(alloc_);
+            Map* map = map_alloc.allocate(1);
+            try
+            {
+                map_alloc.construct(map, *other.map_);
+            }
+            catch (...)
+            {
+                map_alloc.deallocate(map, 1);
+                throw;
+            }
+            map_ = map;
+            promoted_ = true;
+            return;
+        }
+        for (; size_ < other.size_; ++size_)
+        {
+            ::new (static_cast<void*>(Slots() + size_)) Slot(other.Slots()[size_]);
+            inline_.tags[size_] = other.inline_.tags[size_];
+        }
+    }
+
+    void StealFrom(SmallHashMap& other)
+    {
+        if (other.promoted_)
+        {
+            map_ = other.map_;
+            promoted_ = true;
+            ::new (static_cast<void*>(&other.inline_)) InlineSlots();
+            other.promoted_ = false;
+            return;
+        }
+        for (; size_ < other.size_; ++size_)
+        {
+            ::new (static_cast<void*>(Slots() + size_)) Slot(std::move(other.Slots()[size_]));
+            inline_.tags[size_] = other.inline_.tags[size_];
+        }
+        other.clear();
+    }
+
+    static_assert(sizeof(Slot) == sizeof(value_type) && alignof(Slot) == alignof(value_type),
+                  "inline slots must be layout-compatible with value_type");
+
+    /**
+     * @brief The inline entries and their cached hash tags; tags of unused slots are kept initialized.
+     */
+    struct InlineSlots
+    {
+        InlineSlots() : tags() {}
+
+        alignas(Slot) unsigned char slots[N * sizeof(Slot)];
+        std::uint32_t tags[N];
+    };
+
+    // The inline entries while IsInline(), the hash table once promoted
+    union
+    {
+        InlineSlots inline_{};
+        Map* map_;
+    };
+    std::uint32_t size_ = 0;
+    bool promoted_ = false;
+    allocator_type alloc_;
+};
+
+/**
+ * @brief Smallest inline capacity chosen by kSmallHashMapCapacity, the distinct keys of a typical small map.
+ */
+inline constexpr std::size_t kSmallHashMapMinCapacity = 8;
+
+/**
+ * @brief Inline capacity of a SmallHashMap: at least kSmallHashMapMinCapacity entries, more if they are small.
+ *
+ * The floor is the number of distinct keys a typical small map holds, so
+ * such maps never allocate whatever the entry size. Entries small enough
+ * that more of them fit in the space of two empty hash tables get that
+ * many slots instead.
+ *
+ * @tparam K The key type.
+ * @tparam V The mapped type.
+ * @tparam Hash The hash functor for keys.
+ * @tparam Eq The equality functor for keys.
+ */
+template <typename K, typename V, typename Hash, typename Eq>
+inline constexpr std::size_t kSmallHashMapCapacity =
+    std::clamp<std::size_t>(2 * sizeof(std::pmr::unordered_map<K, V, Hash, Eq>) /
+                                (sizeof(std::pair<K, V>) + sizeof(std::uint32_t)),
+                            kSmallHashMapMinCapacity, 32);
@@ -0,0 +1,83 @@
+#include "symbol_table.hpp"
+
+#include <mutex>
+#include <stdexcept>
+
+#include "hash.hpp"
+
+/**
+ * @brief Interns a string, adding it to the table if it is not there yet.
+ * @param text The text to intern.
+ * @return The symbol for the text.
+ */
+Symbol SymbolTable::Intern(std::string_view text)
+{
+    std::uint64_t full_hash = HashString(text);
+    std::size_t hash = static_cast<std::size_t>(full_hash);
+    Shard& shard = shards_[(full_hash >> 32) % kShardCount];
+
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.index.find(text);
+        if (it != shard.index.end())
+        {
+            return Symbol(it->second);
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    // Another thread may have added the text between the two locks
+    auto it = shard.index.find(text);
+    if (it != shard.index.end())
+    {
+        return Symbol(it->second);
+    }
+
+    const Symbol::Entry* entry = nullptr;
+    {
+        std::unique_lock<std::shared_mutex> entries_lock(entries_mutex_);
+        auto id = static_cast<std::uint32_t>(entries_.size());
+        // std::deque never relocates existing entries, so views into them stay valid
+        entry = &entries_.emplace_back(Symbol::Entry{std::string(text), hash, id});
+    }
+    shard.index.emplace(entry->text, entry);
+    return Symbol(entry);
+}
+
+/**
+ * @brief Returns the symbol with the given identifier.
+ * @param id The symbol identifier.
+ * @return The symbol.
+ * @throws std::out_of_range If no symbol has the identifier.
+ */
+Symbol SymbolTable::At(std::uint32_t id) const
+{
+    std::shared_lock<std::shared_mutex> lock(entries_mutex_);
+
+    if (id >= entries_.size())
+    {
+        throw std::out_of_range("Symbol does not exist in the table");
+    }
+
+    return Symbol(&entries_[id]);
+}
+
+/**
+ * @brief Returns the number of interned strings.
+ * @return The number of distinct symbols.
+ */
+std::size_t SymbolTable::Size() const
+{
+    std::shared_lock<std::shared_mutex> lock(entries_mutex_);
+    return entries_.size();
+}
+
+/**
+ * @brief Returns the process-wide symbol table.
+ * @return The global symbol table.
+ */
+SymbolTable& SymbolTable::Global()
+{
+    static SymbolTable table;
+    return table;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+class SymbolTable;
+
+/**
+ * @brief Interned string handle.
+ * 
+ * A Symbol is a single pointer to a string stored once in a SymbolTable.
+ * The table entry keeps the precomputed hash of the string, so hashing a
+ * Symbol is a load and comparing two Symbols of the same table is a
+ * pointer comparison. The hash equals the hash of the same text as a
+ * std::string element, which lets Symbols and strings be used
+ * interchangeably as MultiSet keys.
+ *
+ * Interning saves the per-element copy of the text, and with it the heap
+ * allocation of strings too long for the small-string buffer. It does not
+ * shrink a MultiSet element, which stays the size of its std::string
+ * alternative.
+ * 
+ * A Symbol must not outlive the SymbolTable that created it.
+ */
+class Symbol
+{
+public:
+    /**
+     * @brief Gets the identifier of the symbol within its table.
+     * 
+     * @return The 32-bit symbol identifier.
+     */
+    std::uint32_t Id() const;
+
+    /**
+     * @brief Gets the precomputed hash of the symbol's text.
+     * 
+     * @return The hash value.
+     */
+    std::size_t Hash() const;
+
+    /**
+     * @brief Gets the interned text.
+     * 
+     * @return A view of the text, valid as long as the table is alive.
+     */
+    std::string_view Text() const;
+
+    bool operator==(const Symbol& other) const
+    {
+        return entry_ == other.entry_ || (Hash() == other.Hash() && Text() == other.Text());
+    }
+
+    bool operator!=(const Symbol& other) const { return !(*this == other); }
+
+private:
+    friend class SymbolTable;
+
+    struct Entry;
+
+    explicit Symbol(const Entry* entry);
+
+    const Entry* entry_;
+};
+
+/**
+ * @brief Table of interned strings.
+ * 
+ * Each distinct string is stored once and identified by a dense 32-bit
+ * identifier. Tables can be scoped to a piece of work, or the process-wide
+ * Global() table can be shared. Interning is thread-safe.
+ *
+ * The text index is split into shards by text hash, each behind its own
+ * reader-writer lock. Interning a text that is already in the table only
+ * takes its shard's lock in shared mode, so concurrent lookups do not
+ * serialize. Adding a new text locks its shard exclusively and briefly
+ * locks the entry list, which At() and Size() read under a shared lock.
+ */
+class SymbolTable
+{
+public:
+    SymbolTable() = default;
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    /**
+     * @brief Interns a string.
+     * 
+     * @param text The text to intern.
+     * @return The symbol for the text; equal texts yield the same symbol.
+     */
+    Symbol Intern(std::string_view text);
+
+    /**
+     * @brief Gets the symbol with the given identifier.
+     * 
+     * @param id The symbol identifier.
+     * @return The symbol.
+     * @throws std::out_of_range If no symbol has the identifier.
+     */
+    Symbol At(std::uint32_t id) const;
+
+    /**
+     * @brief Gets the number of interned strings.
+     * 
+     * @return The number of distinct symbols in the table.
+     */
+    std::size_t Size() const;
+
+    /**
+     * @brief Gets the process-wide symbol table.
+     * 
+     * @return The global symbol table.
+     */
+    static SymbolTable& Global();
+
+private:
+    static constexpr std::size_t kShardCount = 16;
+
+    // Part of the text index; a shard lock is always taken before entries_mutex_
+    struct Shard
+    {
+        std::unordered_map<std::string_view, const Symbol::Entry*> index;
+        std::shared_mutex mutex;
+    };
+
+    std::deque<Symbol::Entry> entries_;
+    mutable std::shared_mutex entries_mutex_;
+    std::array<Shard, kShardCount> shards_;
+};
+
+/**
+ * @brief Interned string stored by a SymbolTable.
+ */
+struct Symbol::Entry
+{
+    std::string text;
+    std::size_t hash;
+    std::uint32_t id;
+};
+
+inline Symbol::Symbol(const Entry* entry) : entry_(entry) {}
+
+inline std::uint32_t Symbol::Id() const { return entry_->id; }
+
+inline std::size_t Symbol::Hash() const { return entry_->hash; }
+
+inline std::string_view Symbol::Text() const { return entry_->text; }
@@ -0,0 +1,756 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory_resource>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "basic_multiset.hpp"
+
+using IdMultiSet = BasicMultiSet<std::uint64_t>;
+
+// Hasher that counts its calls. It is not noexcept, so promoted tables cache hash codes and copies do not rehash.
+struct CountingHash
+{
+    std::size_t operator()(std::uint64_t value) const
+    {
+        ++calls;
+        return std::hash<std::uint64_t>()(value);
+    }
+
+    static inline std::size_t calls = 0;
+};
+
+using CountedMultiSet = BasicMultiSet<std::uint64_t, CountingHash>;
+
+// BasicMultiSet tests
+
+TEST(BasicMultiSetTest, AddAndRemoveIntegers)
+{
+    IdMultiSet ms;
+
+    ms.AddElement(42);
+    ms.AddElement(42);
+    ms.AddElement(7);
+
+    EXPECT_TRUE(ms.IsContains(42));
+    EXPECT_EQ(ms.GetElements().at(42), 2u);
+    EXPECT_EQ(ms.Size(), 3u);
+
+    ms.RemoveElement(42);
+    ms.RemoveElement(42);
+    EXPECT_FALSE(ms.IsContains(42));
+    EXPECT_THROW(ms.RemoveElement(42), std::runtime_error);
+}
+
+TEST(BasicMultiSetTest, AddsManyOccurrencesWithOneProbe)
+{
+    CountingHash::calls = 0;
+    CountedMultiSet ms;
+    ms.AddElement(5, 1000);
+    ms.AddElement(5, 0);
+    EXPECT_EQ(CountingHash::calls, 1u);
+    EXPECT_EQ(ms.GetElements().at(5), 1000u);
+    EXPECT_EQ(ms.Size(), 1000u);
+
+    // The index skips over the counts in between, whether they have buckets or not
+    IdMultiSet indexed;
+    indexed.EnableFrequencyIndex();
+    for (std::uint64_t i = 0; i < 10; ++i)
+    {
+        indexed.AddElement(i, i + 1);
+    }
+    indexed.AddElement(0, 5);
+    indexed.AddElement(3, 100);
+    EXPECT_EQ(indexed.CountWithCountInRange(6, 6), 2u);
+    EXPECT_EQ(indexed.CountWithCountInRange(104, 104), 1u);
+    EXPECT_EQ(indexed.CountWithCountInRange(1, 1), 0u);
+    EXPECT_EQ(indexed.Size(), 55u + 105u);
+}
+
+TEST(BasicMultiSetTest, Operators)
+{
+    IdMultiSet ms1;
+    IdMultiSet ms2;
+
+    ms1.AddElement(1);
+    ms1.AddElement(1);
+    ms1.AddElement(2);
+    ms2.AddElement(1);
+    ms2.AddElement(3);
+
+    IdMultiSet united = ms1 + ms2;
+    EXPECT_EQ(united.GetElements().at(1), 2u);
+    EXPECT_EQ(united.Size(), 4u);
+
+    IdMultiSet intersection = ms1 * ms2;
+    EXPECT_EQ(intersection.GetElements().at(1), 1u);
+    EXPECT_EQ(intersection.Size(), 1u);
+
+    IdMultiSet difference = ms1 - ms2;
+    EXPECT_EQ(difference.GetElements().at(1), 1u);
+    EXPECT_TRUE(difference.IsContains(2));
+    EXPECT_TRUE(difference.IsContains(3));
+
+    IdMultiSet in_place = ms1;
+    in_place *= ms2;
+    EXPECT_EQ(in_place, intersection);
+    EXPECT_NE(in_place, ms1);
+}
+
+TEST(BasicMultiSetTest, CustomHashAndCountTypes)
+{
+    struct ModHash
+    {
+        std::size_t operator()(std::uint32_t value) const { return value % 4; }
+    };
+
+    BasicMultiSet<std::uint32_t, ModHash, std::equal_to<std::uint32_t>, std::uint16_t> ms;
+    ms.AddElement(1);
+    ms.AddElement(5);
+    ms.AddElement(5);
+
+    EXPECT_EQ(ms.GetElements().at(5), 2);
+    EXPECT_EQ(ms.BuildBoolean().Size(), 2u);
+}
+
+TEST(BasicMultiSetTest, UsesGivenMemoryResource)
+{
+    std::pmr::monotonic_buffer_resource arena;
+    IdMultiSet ms(&arena);
+    ms.AddElement(1);
+
+    EXPECT_EQ(ms.get_allocator().resource(), &arena);
+    EXPECT_EQ((ms + IdMultiSet()).get_allocator().resource(), &arena);
+}
+
+TEST(BasicMultiSetTest, CanonicalOrder)
+{
+    IdMultiSet first;
+    IdMultiSet second;
+    for (std::uint64_t i = 0; i < 20; ++i)
+    {
+        first.AddElement(i);
+        second.AddElement(19 - i);
+    }
+    first.AddElement(4);
+    second.AddElement(4);
+
+    std::vector<std::uint64_t> order;
+    for (const auto* entry : first.CanonicalEntries())
+    {
+        order.push_back(entry->first);
+    }
+    EXPECT_TRUE(std::is_sorted(order.begin(), order.end()));
+    EXPECT_EQ(first.CanonicalCompare(second), 0);
+
+    std::ostringstream left;
+    std::ostringstream right;
+    left << CanonicalOrder << first;
+    right << CanonicalOrder << second;
+    EXPECT_EQ(left.str(), right.str());
+
+    second.AddElement(3);
+    EXPECT_LT(first.CanonicalCompare(second), 0);
+    EXPECT_GT(second.CanonicalCompare(first), 0);
+
+    // Concurrent readers of a set without a cached order all see the same order
+    std::vector<std::size_t> sizes(4);
+    std::vector<std::thread> readers;
+    for (std::size_t t = 0; t < sizes.size(); ++t)
+    {
+        readers.emplace_back([&, t] { sizes[t] = second.CanonicalEntries().size(); });
+    }
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+    EXPECT_EQ(sizes, std::vector<std::size_t>(4, second.GetElements().size()));
+}
+
+TEST(BasicMultiSetTest, OutputOperator)
+{
+    IdMultiSet ms;
+    ms.AddElement(5);
+    ms.AddElement(5);
+
+    std::ostringstream oss;
+    oss << ms;
+
+    EXPECT_EQ(oss.str(), "{5, 5}");
+}
+
+TEST(BasicMultiSetTest, SizeIsTrackedThroughOperations)
+{
+    auto sum_of_counts = [](const IdMultiSet& ms)
+    {
+        std::size_t total = 0;
+        for (const auto& elem : ms.GetElements())
+        {
+            total += elem.second;
+        }
+        return total;
+    };
+
+    IdMultiSet ms1;
+    IdMultiSet ms2;
+    for (std::uint64_t i = 0; i < 20; ++i)
+    {
+        ms1.AddElement(i % 7);
+        ms2.AddElement(i % 5);
+    }
+    ms1.RemoveElement(0);
+
+    for (const IdMultiSet& result : {ms1 + ms2, ms1 * ms2, ms1 - ms2, ms1.BuildBoolean()})
+    {
+        EXPECT_EQ(result.Size(), sum_of_counts(result));
+    }
+
+    IdMultiSet in_place = ms1;
+    in_place += ms2;
+    EXPECT_EQ(in_place.Size(), sum_of_counts(in_place));
+    in_place -= ms1;
+    EXPECT_EQ(in_place.Size(), sum_of_counts(in_place));
+    in_place *= ms2;
+    EXPECT_EQ(in_place.Size(), sum_of_counts(in_place));
+
+    in_place.SetElements(ms1.GetElements());
+    EXPECT_EQ(in_place.Size(), ms1.Size());
+}
+
+TEST(BasicMultiSetTest, MovedFromSetIsEmptyAndReusable)
+{
+    auto make_source = []()
+    {
+        IdMultiSet source;
+        source.AddElement(1);
+        source.AddElement(1);
+        source.AddElement(2);
+        source.StructuralHash();  // Cache the hash so a stale one would show
+        return source;
+    };
+    auto expect_reusable = [](IdMultiSet& moved_from)
+    {
+        EXPECT_TRUE(moved_from.IsEmpty());
+        EXPECT_EQ(moved_from.Size(), 0u);
+        EXPECT_EQ(moved_from.StructuralHash(), IdMultiSet().StructuralHash());
+        EXPECT_EQ(moved_from, IdMultiSet());
+        moved_from.AddElement(7);
+        EXPECT_EQ(moved_from.Size(), 1u);
+        EXPECT_EQ(moved_from.GetElements().at(7), 1u);
+    };
+
+    IdMultiSet constructed_from = make_source();
+    IdMultiSet constructed(std::move(constructed_from));
+    EXPECT_EQ(constructed.Size(), 3u);
+    expect_reusable(constructed_from);
+
+    IdMultiSet assigned_from = make_source();
+    IdMultiSet assigned;
+    assigned = std::move(assigned_from);
+    EXPECT_EQ(assigned, make_source());
+    expect_reusable(assigned_from);
+
+    IdMultiSet same_resource_from = make_source();
+    IdMultiSet same_resource(std::move(same_resource_from), same_resource_from.get_allocator());
+    EXPECT_EQ(same_resource.Size(), 3u);
+    expect_reusable(same_resource_from);
+
+    // Between different resources the elements are copied and the source keeps them
+    std::pmr::monotonic_buffer_resource resource;
+    IdMultiSet other_resource_from = make_source();
+    IdMultiSet other_resource(std::move(other_resource_from), IdMultiSet::allocator_type(&resource));
+    EXPECT_EQ(other_resource, make_source());
+    EXPECT_EQ(other_resource_from, make_source());
+    EXPECT_EQ(other_resource_from.Size(), 3u);
+}
+
+TEST(BasicMultiSetTest, StructuralHashFollowsModifications)
+{
+    IdMultiSet ms1;
+    IdMultiSet ms2;
+    ms1.AddElement(1);
+    ms2.AddElement(1);
+
+    std::size_t hash_before = ms1.StructuralHash();
+    EXPECT_EQ(hash_before, ms2.StructuralHash());
+
+    ms1.AddElement(1);
+    EXPECT_NE(ms1.StructuralHash(), hash_before);
+    EXPECT_NE(ms1, ms2);
+
+    ms1.RemoveElement(1);
+    EXPECT_EQ(ms1.StructuralHash(), hash_before);
+    EXPECT_EQ(ms1, ms2);
+
+    ms1 += ms2;
+    ms1 *= ms2;
+    ms1 -= IdMultiSet();
+    EXPECT_EQ(ms1.StructuralHash(), hash_before);
+}
+
+TEST(BasicMultiSetTest, EqualityWithCachedHashes)
+{
+    IdMultiSet ms1;
+    IdMultiSet ms2;
+    ms1.AddElement(1);
+    ms2.AddElement(2);
+
+    // Same size and distinct count, so only the cached hashes or the elements tell them apart
+    ms1.StructuralHash();
+    ms2.StructuralHash();
+    EXPECT_NE(ms1, ms2);
+
+    IdMultiSet copy = ms1;
+    EXPECT_EQ(copy.StructuralHash(), ms1.StructuralHash());
+    EXPECT_EQ(copy, ms1);
+    EXPECT_EQ(ms1, ms1);
+}
+
+TEST(BasicMultiSetTest, OperatorsHashEachElementOnce)
+{
+    CountedMultiSet large;
+    CountedMultiSet small;
+    for (std::uint64_t i = 0; i < 100; ++i)
+    {
+        large.AddElement(i);
+        large.AddElement(i);
+    }
+    for (std::uint64_t i = 50; i < 90; ++i)
+    {
+        small.AddElement(i);
+        small.AddElement(i);
+        small.AddElement(i);
+    }
+
+    CountingHash::calls = 0;
+    CountedMultiSet united = large + small;
+    EXPECT_EQ(CountingHash::calls, small.GetElements().size());
+    EXPECT_EQ(united.Size(), 50u * 2 + 40u * 3 + 10u * 2);
+
+    CountingHash::calls = 0;
+    CountedMultiSet in_place = large;
+    in_place += small;
+    EXPECT_EQ(CountingHash::calls, small.GetElements().size());
+    EXPECT_EQ(in_place, united);
+
+    CountingHash::calls = 0;
+    CountedMultiSet difference = small - large;
+    EXPECT_EQ(CountingHash::calls, large.GetElements().size());
+    EXPECT_EQ(difference.Size(), 40u + 60u * 2);
+
+    CountingHash::calls = 0;
+    in_place = small;
+    in_place -= large;
+    EXPECT_EQ(CountingHash::calls, large.GetElements().size());
+    EXPECT_EQ(in_place, difference);
+
+    CountingHash::calls = 0;
+    in_place = large;
+    in_place *= small;
+    EXPECT_EQ(CountingHash::calls, large.GetElements().size());
+    EXPECT_EQ(in_place.Size(), 40u * 2);
+
+    // Each element of the smaller operand is hashed for the lookup and again for the insertion into the result
+    CountingHash::calls = 0;
+    CountedMultiSet intersection = large * small;
+    EXPECT_EQ(CountingHash::calls, 2 * small.GetElements().size());
+    EXPECT_EQ(intersection, in_place);
+
+    CountingHash::calls = 0;
+    large.AddElement(0);
+    EXPECT_EQ(CountingHash::calls, 1u);
+
+    in_place = small;
+    in_place += in_place;
+    EXPECT_EQ(in_place, small);
+    in_place *= in_place;
+    EXPECT_EQ(in_place, small);
+    in_place -= in_place;
+    EXPECT_TRUE(in_place.IsEmpty());
+    EXPECT_EQ(in_place.Size(), 0u);
+}
+
+TEST(BasicMultiSetTest, DifferenceAndSymmetricDifference)
+{
+    IdMultiSet ms1;
+    IdMultiSet ms2;
+    for (std::uint64_t value : {1, 1, 1, 2, 2, 3})
+    {
+        ms1.AddElement(value);
+    }
+    for (std::uint64_t value : {1, 2, 2, 2, 4})
+    {
+        ms2.AddElement(value);
+    }
+
+    IdMultiSet difference = ms1.Difference(ms2);
+    EXPECT_EQ(difference.GetElements().at(1), 2u);
+    EXPECT_FALSE(difference.IsContains(2));
+    EXPECT_EQ(difference.GetElements().at(3), 1u);
+    EXPECT_FALSE(difference.IsContains(4));
+    EXPECT_EQ(difference.Size(), 3u);
+
+    IdMultiSet symmetric = ms1.SymmetricDifference(ms2);
+    EXPECT_EQ(symmetric.GetElements().at(1), 2u);
+    EXPECT_EQ(symmetric.GetElements().at(2), 1u);
+    EXPECT_EQ(symmetric.GetElements().at(3), 1u);
+    EXPECT_EQ(symmetric.GetElements().at(4), 1u);
+    EXPECT_EQ(symmetric.Size(), 5u);
+    EXPECT_EQ(ms2.SymmetricDifference(ms1), symmetric);
+
+    // Difference == (this - other) minus the elements found only in other, without the extra intersection pass
+    EXPECT_EQ(difference, (ms1 - ms2) * ms1);
+
+    IdMultiSet in_place = ms1;
+    in_place.DifferenceInPlace(ms2);
+    EXPECT_EQ(in_place, difference);
+    in_place = ms1;
+    in_place.SymmetricDifferenceInPlace(ms2);
+    EXPECT_EQ(in_place, symmetric);
+
+    IdMultiSet moved = ms1;
+    EXPECT_EQ(std::move(moved).Difference(ms2), difference);
+    moved = ms1;
+    EXPECT_EQ(std::move(moved).SymmetricDifference(ms2), symmetric);
+
+    // The rvalue overloads take the storage of the source, which is left empty and reusable
+    for (bool is_symmetric : {false, true})
+    {
+        IdMultiSet source = ms1;
+        source.StructuralHash();
+        IdMultiSet result =
+            is_symmetric ? std::move(source).SymmetricDifference(ms2) : std::move(source).Difference(ms2);
+        EXPECT_EQ(result, is_symmetric ? symmetric : difference);
+        EXPECT_TRUE(source.IsEmpty());
+        EXPECT_EQ(source.Size(), 0u);
+        EXPECT_EQ(source, IdMultiSet());
+        source.AddElement(9);
+        EXPECT_EQ(source.Size(), 1u);
+        EXPECT_EQ(source.StructuralHash(), (IdMultiSet() + source).StructuralHash());
+    }
+
+    in_place = ms1;
+    in_place.DifferenceInPlace(in_place);
+    EXPECT_TRUE(in_place.IsEmpty());
+    in_place = ms1;
+    EXPECT_TRUE(std::move(in_place).SymmetricDifference(in_place).IsEmpty());
+    EXPECT_TRUE(ms1.Difference(ms1).IsEmpty());
+}
+
+TEST(BasicMultiSetTest, DifferenceIteratesSmallerOperand)
+{
+    CountedMultiSet large;
+    CountedMultiSet small;
+    for (std::uint64_t i = 0; i < 100; ++i)
+    {
+        large.AddElement(i);
+    }
+    for (std::uint64_t i = 90; i < 110; ++i)
+    {
+        small.AddElement(i);
+        small.AddElement(i);
+    }
+
+    CountingHash::calls = 0;
+    CountedMultiSet shrunk = large.Difference(small);
+    EXPECT_EQ(CountingHash::calls, small.GetElements().size());
+    EXPECT_EQ(shrunk.Size(), 90u);
+    EXPECT_FALSE(shrunk.IsContains(95));
+
+    CountingHash::calls = 0;
+    CountedMultiSet rest = small.Difference(large);
+    EXPECT_EQ(CountingHash::calls, small.GetElements().size());
+    EXPECT_EQ(rest.Size(), 10u + 10u * 2);
+
+    CountingHash::calls = 0;
+    CountedMultiSet symmetric = small.SymmetricDifference(large);
+    EXPECT_EQ(CountingHash::calls, small.GetElements().size());
+    EXPECT_EQ(symmetric.Size(), 90u + 10u + 10u * 2);
+}
+
+TEST(BasicMultiSetTest, WeightedJaccard)
+{
+    CountedMultiSet large;
+    CountedMultiSet small;
+    for (std::uint64_t i = 0; i < 100; ++i)
+    {
+        large.AddElement(i);
+    }
+    for (std::uint64_t i = 90; i < 110; ++i)
+    {
+        small.AddElement(i);
+        small.AddElement(i);
+    }
+
+    CountingHash::calls = 0;
+    double similarity = large.WeightedJaccard(small);
+    EXPECT_EQ(CountingHash::calls, small.GetElements().size());
+    EXPECT_DOUBLE_EQ(similarity, 10.0 / 130.0);
+    EXPECT_DOUBLE_EQ(small.WeightedJaccard(large), similarity);
+    EXPECT_DOUBLE_EQ(similarity, static_cast<double>((large * small).Size()) / (large + small).Size());
+
+    EXPECT_DOUBLE_EQ(large.WeightedJaccard(large), 1.0);
+    EXPECT_DOUBLE_EQ(CountedMultiSet().WeightedJaccard(CountedMultiSet()), 1.0);
+    EXPECT_DOUBLE_EQ(large.WeightedJaccard(CountedMultiSet()), 0.0);
+}
+
+TEST(BasicMultiSetTest, SubMultiSetAndDisjointness)
+{
+    CountedMultiSet large;
+    CountedMultiSet small;
+    for (std::uint64_t i = 0; i < 100; ++i)
+    {
+        large.AddElement(i);
+        large.AddElement(i);
+    }
+    for (std::uint64_t i = 10; i < 20; ++i)
+    {
+        small.AddElement(i);
+    }
+    CountedMultiSet empty;
+
+    EXPECT_TRUE(small.IsSubMultiSetOf(large));
+    EXPECT_TRUE(empty.IsSubMultiSetOf(small));
+    EXPECT_TRUE(large.IsSubMultiSetOf(large));
+    EXPECT_FALSE(small.IsDisjoint(large));
+    EXPECT_TRUE(empty.IsDisjoint(empty));
+    EXPECT_EQ(small.IsSubMultiSetOf(large), (small * large) == small);
+
+    // Larger multisets are rejected by size alone
+    CountingHash::calls = 0;
+    EXPECT_FALSE(large.IsSubMultiSetOf(small));
+    EXPECT_EQ(CountingHash::calls, 0u);
+
+    // The first violating element ends the check
+    small.AddElement(1000);
+    CountingHash::calls = 0;
+    EXPECT_FALSE(small.IsSubMultiSetOf(large));
+    EXPECT_LE(CountingHash::calls, small.GetElements().size());
+
+    // Equal sizes with different cached hashes need no probe
+    CountedMultiSet same_size = small;
+    same_size.RemoveElement(1000);
+    same_size.AddElement(2000);
+    small.StructuralHash();
+    same_size.StructuralHash();
+    CountingHash::calls = 0;
+    EXPECT_FALSE(small.IsSubMultiSetOf(same_size));
+    EXPECT_EQ(CountingHash::calls, 0u);
+
+    // Disjointness probes the smaller multiset's elements into the larger one
+    CountedMultiSet other;
+    for (std::uint64_t i = 500; i < 505; ++i)
+    {
+        other.AddElement(i);
+    }
+    CountingHash::calls = 0;
+    EXPECT_TRUE(other.IsDisjoint(large));
+    EXPECT_TRUE(large.IsDisjoint(other));
+    EXPECT_EQ(CountingHash::calls, 2 * other.GetElements().size());
+    other.AddElement(5);
+    EXPECT_FALSE(large.IsDisjoint(other));
+}
+
+TEST(BasicMultiSetTest, UnionIntersectAndSumAll)
+{
+    std::vector<IdMultiSet> shards(37);
+    for (std::size_t i = 0; i < shards.size(); ++i)
+    {
+        for (std::uint64_t value = i; value < i + 20; ++value)
+        {
+            shards[i].AddElement(value % 25);
+        }
+        shards[i].AddElement(3);
+    }
+    std::vector<const IdMultiSet*> pointers;
+    for (const auto& shard : shards)
+    {
+        pointers.push_back(&shard);
+    }
+
+    IdMultiSet united;
+    IdMultiSet intersection = shards.front();
+    IdMultiSet sum;
+    for (const auto& shard : shards)
+    {
+        united += shard;
+        intersection *= shard;
+        for (const auto& el : shard.GetElements())
+        {
+            for (std::size_t n = 0; n < el.second; ++n)
+            {
+                sum.AddElement(el.first);
+            }
+        }
+    }
+
+    for (std::size_t threads : {1, 4, 7})
+    {
+        EXPECT_EQ(IdMultiSet::UnionAll(pointers.begin(), pointers.end(), threads), united);
+        EXPECT_EQ(IdMultiSet::IntersectAll(pointers.begin(), pointers.end(), threads), intersection);
+        EXPECT_EQ(IdMultiSet::SumAll(pointers.begin(), pointers.end(), threads), sum);
+    }
+    EXPECT_FALSE(intersection.IsEmpty());
+
+    EXPECT_TRUE(IdMultiSet::UnionAll(pointers.end(), pointers.end()).IsEmpty());
+    EXPECT_TRUE(IdMultiSet::IntersectAll(pointers.end(), pointers.end()).IsEmpty());
+    EXPECT_EQ(IdMultiSet::SumAll(pointers.begin(), pointers.begin() + 1), shards.front());
+}
+
+TEST(BasicMultiSetTest, SumAllHashesEachInputElementOnce)
+{
+    std::vector<CountedMultiSet> shards(10);
+    std::vector<const CountedMultiSet*> pointers;
+    std::size_t distinct = 0;
+    for (std::size_t i = 0; i < shards.size(); ++i)
+    {
+        for (std::uint64_t value = 0; value < 10 * (i + 1); ++value)
+        {
+            shards[i].AddElement(value);
+        }
+        distinct += shards[i].GetElements().size();
+        pointers.push_back(&shards[i]);
+    }
+
+    CountingHash::calls = 0;
+    CountedMultiSet sum = CountedMultiSet::SumAll(pointers.begin(), pointers.end());
+    EXPECT_EQ(CountingHash::calls, distinct);
+    EXPECT_EQ(sum.Size(), distinct);
+    EXPECT_EQ(sum.GetElements().at(0), 10u);
+}
+
+TEST(BasicMultiSetTest, ReductionsUseAllocatorOfFirstInput)
+{
+    std::pmr::monotonic_buffer_resource resource;
+    IdMultiSet first{IdMultiSet::allocator_type(&resource)};
+    IdMultiSet second;
+    first.AddElement(1);
+    second.AddElement(1);
+    second.AddElement(2);
+    const IdMultiSet* pointers[] = {&first, &second};
+
+    EXPECT_EQ(IdMultiSet::UnionAll(std::begin(pointers), std::end(pointers)).get_allocator().resource(), &resource);
+    EXPECT_EQ(IdMultiSet::IntersectAll(std::begin(pointers), std::end(pointers)).get_allocator().resource(),
+              &resource);
+    EXPECT_EQ(IdMultiSet::SumAll(std::begin(pointers), std::end(pointers)).get_allocator().resource(), &resource);
+}
+
+TEST(BasicMultiSetTest, TopK)
+{
+    IdMultiSet ms;
+    for (std::uint64_t value = 1; value <= 50; ++value)
+    {
+        for (std::uint64_t n = 0; n < value % 17 + 1; ++n)
+        {
+            ms.AddElement(value);
+        }
+    }
+
+    auto top = ms.TopK(4);
+    ASSERT_EQ(top.size(), 4u);
+    EXPECT_EQ(top[0]->second, 17u);
+    EXPECT_EQ(top[1]->second, 17u);
+    EXPECT_EQ(top[2]->second, 17u);
+    EXPECT_EQ(top[3]->second, 16u);
+    EXPECT_EQ(top[0]->first % 17, 16u);
+    EXPECT_EQ(ms.GetElements().at(top[3]->first), 16u);
+
+    auto all = ms.TopK(1000);
+    ASSERT_EQ(all.size(), 50u);
+    EXPECT_TRUE(std::is_sorted(all.begin(), all.end(),
+                               [](const IdMultiSet::Entry* left, const IdMultiSet::Entry* right)
+                               { return left->second > right->second; }));
+    EXPECT_EQ(all.back()->second, 1u);
+
+    EXPECT_TRUE(ms.TopK(0).empty());
+    EXPECT_TRUE(IdMultiSet().TopK(3).empty());
+}
+
+TEST(BasicMultiSetTest, FrequencyIndexFollowsModifications)
+{
+    IdMultiSet indexed;
+    IdMultiSet plain;
+    indexed.EnableFrequencyIndex();
+    EXPECT_TRUE(indexed.HasFrequencyIndex());
+
+    auto expect_same_queries = [&]()
+    {
+        for (std::size_t low = 1; low <= 6; ++low)
+        {
+            for (std::size_t high = low; high <= 6; ++high)
+            {
+                EXPECT_EQ(indexed.CountWithCountInRange(low, high), plain.CountWithCountInRange(low, high));
+            }
+            std::size_t reported = 0;
+            std::size_t previous = SIZE_MAX;
+            indexed.ForEachWithCountAtLeast(low,
+                                            [&](std::uint64_t element, std::size_t count)
+                                            {
+                                                EXPECT_EQ(plain.GetElements().at(element), count);
+                                                EXPECT_LE(count, previous);
+                                                previous = count;
+                                                ++reported;
+                                            });
+            EXPECT_EQ(reported, plain.CountWithCountInRange(low, SIZE_MAX));
+        }
+    };
+
+    for (std::uint64_t i = 0; i < 200; ++i)
+    {
+        indexed.AddElement(i * 7 % 23);
+        plain.AddElement(i * 7 % 23);
+        if (i % 3 == 0)
+        {
+            indexed.RemoveElement(i * 7 % 23);
+            plain.RemoveElement(i * 7 % 23);
+        }
+    }
+    expect_same_queries();
+
+    IdMultiSet other;
+    for (std::uint64_t value : {1, 1, 2, 30, 30, 30})
+    {
+        other.AddElement(value);
+    }
+    indexed += other;
+    plain += other;
+    expect_same_queries();
+    indexed.DifferenceInPlace(other);
+    plain.DifferenceInPlace(other);
+    expect_same_queries();
+    indexed *= other;
+    plain *= other;
+    expect_same_queries();
+
+    IdMultiSet copy = indexed;
+    EXPECT_TRUE(copy.HasFrequencyIndex());
+    copy.AddElement(99);
+    EXPECT_EQ(copy.CountWithCountInRange(1, 1), indexed.CountWithCountInRange(1, 1) + 1);
+
+    IdMultiSet assigned;
+    assigned = std::move(copy);
+    EXPECT_TRUE(assigned.HasFrequencyIndex());
+    EXPECT_EQ(assigned.CountWithCountInRange(1, 1), indexed.CountWithCountInRange(1, 1) + 1);
+
+    indexed.DisableFrequencyIndex();
+    EXPECT_FALSE(indexed.HasFrequencyIndex());
+    expect_same_queries();
+}
+
+TEST(BasicMultiSetTest, FrequencyIndexUsesMultiSetAllocator)
+{
+    std::pmr::monotonic_buffer_resource resource;
+    IdMultiSet ms{IdMultiSet::allocator_type(&resource)};
+    ms.AddElement(1);
+    ms.EnableFrequencyIndex();
+
+    IdMultiSet copy(ms, IdMultiSet::allocator_type(&resource));
+    IdMultiSet moved(std::move(copy), IdMultiSet::allocator_type());
+    EXPECT_TRUE(moved.HasFrequencyIndex());
+    EXPECT_EQ(moved.CountWithCountInRange(1, 1), 1u);
+}
@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.hpp"
+
+TEST(BoundedQueueTest, PassesItemsInOrderBetweenThreads)
+{
+    BoundedQueue<std::string> queue(3);
+    const int items = 20000;
+    std::thread producer(
+        [&]
+        {
+            for (int i = 0; i < items; ++i)
+            {
+                EXPECT_TRUE(queue.Push(std::to_string(i)));
+            }
+            queue.Close();
+        });
+
+    std::string item;
+    int received = 0;
+    while (queue.Pop(item))
+    {
+        EXPECT_EQ(item, std::to_string(received));
+        ++received;
+    }
+    producer.join();
+    EXPECT_EQ(received, items);
+}
+
+TEST(BoundedQueueTest, ClosingReleasesBothSides)
+{
+    BoundedQueue<int> queue(2);
+    EXPECT_TRUE(queue.Push(1));
+    EXPECT_TRUE(queue.Push(2));
+    queue.Close();
+    EXPECT_FALSE(queue.Push(3));  // Full and closed
+
+    int item = 0;
+    EXPECT_TRUE(queue.Pop(item));
+    EXPECT_EQ(item, 1);
+    EXPECT_TRUE(queue.Pop(item));
+    EXPECT_EQ(item, 2);
+    EXPECT_FALSE(queue.Pop(item));
+
+    // A consumer that gives up lets a waiting producer return
+    BoundedQueue<int> abandoned(1);
+    std::thread producer(
+        [&]
+        {
+            int pushed = 0;
+            while (abandoned.Push(pushed))
+            {
+                ++pushed;
+            }
+            EXPECT_GE(pushed, 1);
+        });
+    EXPECT_TRUE(abandoned.Pop(item));
+    abandoned.Close();
+    producer.join();
+}
@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "frequency_index.hpp"
+
+namespace
+{
+using Index = FrequencyIndex<std::string, int, std::hash<std::string>, std::equal_to<std::string>>;
+
+std::vector<std::pair<std::string, int>> AtLeast(const Index& index, int threshold)
+{
+    std::vector<std::pair<std::string, int>> result;
+    index.ForEachAtLeast(threshold, [&](const std::string& element, int count) { result.emplace_back(element, count); });
+    return result;
+}
+}  // namespace
+
+TEST(FrequencyIndexTest, IncrementAndDecrementMoveBetweenBuckets)
+{
+    Index index;
+    index.Increment("a");
+    index.Increment("a");
+    index.Increment("a");
+    index.Increment("b");
+    index.Increment("c");
+    index.Increment("c");
+    EXPECT_EQ(index.size(), 3u);
+
+    using Result = std::vector<std::pair<std::string, int>>;
+    EXPECT_EQ(AtLeast(index, 2), (Result{{"a", 3}, {"c", 2}}));
+
+    index.Decrement("a");
+    index.Decrement("a");
+    index.Decrement("b");
+    EXPECT_EQ(index.size(), 2u);
+    EXPECT_EQ(AtLeast(index, 1), (Result{{"c", 2}, {"a", 1}}));
+
+    index.Decrement("missing");
+    index.Decrement("a");
+    index.Decrement("c");
+    index.Decrement("c");
+    EXPECT_EQ(index.size(), 0u);
+    EXPECT_TRUE(AtLeast(index, 1).empty());
+}
+
+TEST(FrequencyIndexTest, RangeQueries)
+{
+    Index index;
+    std::map<std::string, int> counts = {{"a", 1}, {"b", 2}, {"c", 2}, {"d", 5}, {"e", 9}};
+    index.Rebuild(counts);
+
+    EXPECT_EQ(index.CountInRange(2, 5), 3u);
+    EXPECT_EQ(index.CountInRange(3, 4), 0u);
+    EXPECT_EQ(index.CountInRange(1, 100), 5u);
+
+    std::map<std::string, int> reported;
+    index.ForEachInRange(2, 5, [&](const std::string& element, int count) { reported[element] = count; });
+    EXPECT_EQ(reported, (std::map<std::string, int>{{"b", 2}, {"c", 2}, {"d", 5}}));
+
+    // Rebuilt buckets are updated like incrementally built ones
+    index.Increment("d");
+    index.Decrement("b");
+    EXPECT_EQ(index.CountInRange(6, 6), 1u);
+    EXPECT_EQ(index.CountInRange(1, 1), 2u);
+}
+
+TEST(FrequencyIndexTest, CopyRebuildsPositions)
+{
+    std::pmr::monotonic_buffer_resource resource;
+    Index index;
+    index.Increment("a");
+    index.Increment("a");
+    index.Increment("b");
+
+    Index copy(index, Index::allocator_type(&resource));
+    EXPECT_EQ(copy.get_allocator().resource(), &resource);
+    index.Decrement("a");
+    copy.Increment("a");
+    EXPECT_EQ(AtLeast(index, 1).size(), 2u);
+    EXPECT_EQ(copy.CountInRange(3, 3), 1u);
+    EXPECT_EQ(index.CountInRange(1, 1), 2u);
+}
+
+TEST(FrequencyIndexTest, AssignmentRebuildsPositions)
+{
+    std::pmr::monotonic_buffer_resource resource;
+    Index index;
+    index.Increment("a");
+    index.Increment("a");
+    index.Increment("b");
+
+    Index copied{Index::allocator_type(&resource)};
+    copied.Increment("z");
+    copied = index;
+    EXPECT_EQ(copied.get_allocator().resource(), &resource);
+    EXPECT_EQ(copied.Get("z"), 0);
+    copied.Increment("b");
+    EXPECT_EQ(copied.CountInRange(2, 2), 2u);
+    EXPECT_EQ(index.CountInRange(1, 1), 1u);
+
+    // Between different resources the index is rebuilt, between equal ones it is taken over
+    Index other_resource;
+    other_resource = std::move(copied);
+    EXPECT_EQ(other_resource.get_allocator(), Index::allocator_type());
+    other_resource.Decrement("a");
+    EXPECT_EQ(AtLeast(other_resource, 1), (std::vector<std::pair<std::string, int>>{{"b", 2}, {"a", 1}}));
+
+    Index same_resource;
+    same_resource = std::move(other_resource);
+    same_resource.Increment("a");
+    EXPECT_EQ(same_resource.CountInRange(2, 2), 2u);
+}
+
+TEST(FrequencyIndexTest, ReplaceLeastFrequentTakesOverCount)
+{
+    Index index;
+    EXPECT_EQ(index.MinCount(), 0);
+    index.Increment("a");
+    index.Increment("a");
+    index.Increment("b");
+    index.Increment("b");
+    index.Increment("b");
+    EXPECT_EQ(index.MinCount(), 2);
+    EXPECT_EQ(index.Get("b"), 3);
+    EXPECT_EQ(index.Get("missing"), 0);
+
+    EXPECT_EQ(index.ReplaceLeastFrequent("c"), "a");
+    EXPECT_EQ(index.size(), 2u);
+    EXPECT_EQ(index.Get("a"), 0);
+    EXPECT_EQ(index.Get("c"), 3);
+    EXPECT_EQ(index.MinCount(), 3);
+
+    index.Increment("c");
+    using Result = std::vector<std::pair<std::string, int>>;
+    EXPECT_EQ(AtLeast(index, 1), (Result{{"c", 4}, {"b", 3}}));
+}
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <unordered_set>
+
+#include "hash.hpp"
+
+// Hash function tests
+
+TEST(HashTest, HashStringIsDeterministic)
+{
+    EXPECT_EQ(HashString("element"), HashString(std::string("element")));
+    EXPECT_NE(HashString("element"), HashString("element", 1));
+}
+
+TEST(HashTest, HashStringDistinguishesEveryLength)
+{
+    // Covers the short, medium and 48-byte block code paths
+    std::string text(200, 'a');
+    std::unordered_set<std::uint64_t> hashes;
+    for (size_t len = 0; len <= text.size(); ++len)
+    {
+        hashes.insert(HashString(std::string_view(text.data(), len)));
+    }
+    EXPECT_EQ(hashes.size(), text.size() + 1);
+}
+
+TEST(HashTest, HashStringCollisionRate)
+{
+    const size_t count = 100000;
+    std::unordered_set<std::uint64_t> hashes;
+    std::unordered_set<std::uint64_t> low_bits;
+    for (size_t i = 0; i < count; ++i)
+    {
+        std::uint64_t hash = HashString("key" + std::to_string(i));
+        hashes.insert(hash);
+        low_bits.insert(hash & 0xFFFFF);
+    }
+
+    EXPECT_EQ(hashes.size(), count);
+    // 100k keys in 2^20 buckets leave about 95.4k distinct buckets for a uniform hash
+    EXPECT_GT(low_bits.size(), count * 94 / 100);
+}
+
+TEST(HashTest, MixHashSpreadsSmallIntegers)
+{
+    std::unordered_set<std::uint64_t> high_bytes;
+    for (std::uint64_t i = 0; i < 256; ++i)
+    {
+        high_bytes.insert(MixHash(i) >> 56);
+    }
+    // The identity hash would put all of them into a single top byte
+    EXPECT_GT(high_bytes.size(), 128u);
+}
@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "heavy_hitters_multiset.hpp"
+#include "multiset.hpp"
+
+namespace
+{
+MultiSet::Element Key(int i) { return MultiSet::Element(std::string("k") + std::to_string(i)); }
+
+// Stream where key i < 10 occurs 200 - 10 * i times, interleaved with 2000 keys that occur once
+std::vector<MultiSet::Element> SkewedStream()
+{
+    std::vector<MultiSet::Element> stream;
+    for (int i = 0; i < 2000; ++i)
+    {
+        stream.push_back(Key(1000 + i));
+        for (int heavy = 0; heavy < 10; ++heavy)
+        {
+            if (i % 10 == 0 && i / 10 < 200 - 10 * heavy)
+            {
+                stream.push_back(Key(heavy));
+            }
+        }
+    }
+    return stream;
+}
+}  // namespace
+
+TEST(HeavyHittersMultiSetTest, ExactBelowCapacity)
+{
+    HeavyHittersMultiSet summary(4);
+    MultiSet::Element nested = MakeMultiSet();
+    summary.AddElement(Key(1));
+    summary.AddElement(Key(1));
+    summary.AddElement(nested);
+    EXPECT_FALSE(summary.IsFull());
+    EXPECT_EQ(summary.Size(), 3);
+    EXPECT_EQ(summary.Count(Key(1)), 2);
+    EXPECT_EQ(summary.Count(nested), 1);
+    EXPECT_EQ(summary.Count(Key(2)), 0);
+    EXPECT_EQ(summary.Error(Key(1)), 0);
+    EXPECT_THROW(HeavyHittersMultiSet(0), std::invalid_argument);
+}
+
+TEST(HeavyHittersMultiSetTest, EvictionBoundsError)
+{
+    HeavyHittersMultiSet summary(2);
+    for (int i : {1, 1, 1, 2, 3})
+    {
+        summary.AddElement(Key(i));
+    }
+    // Key 3 replaced key 2 and took over its count of one
+    EXPECT_TRUE(summary.IsFull());
+    EXPECT_EQ(summary.Count(Key(1)), 3);
+    EXPECT_EQ(summary.Count(Key(2)), 0);
+    EXPECT_EQ(summary.Count(Key(3)), 2);
+    EXPECT_EQ(summary.Error(Key(3)), 1);
+}
+
+TEST(HeavyHittersMultiSetTest, CopyAndMoveAssignment)
+{
+    HeavyHittersMultiSet summary(2);
+    for (int i : {1, 1, 1, 2, 3})
+    {
+        summary.AddElement(Key(i));
+    }
+
+    HeavyHittersMultiSet copy(5);
+    copy.AddElement(Key(9));
+    copy = summary;
+    copy.AddElement(Key(3));
+    EXPECT_EQ(copy.Capacity(), 2u);
+    EXPECT_EQ(copy.Count(Key(9)), 0);
+    EXPECT_EQ(copy.Count(Key(3)), 3);
+    EXPECT_EQ(copy.Error(Key(3)), 1);
+    EXPECT_EQ(summary.Count(Key(3)), 2);
+
+    HeavyHittersMultiSet moved(1);
+    moved = std::move(copy);
+    moved.AddElement(Key(1));
+    EXPECT_EQ(moved.Count(Key(1)), 4);
+    EXPECT_EQ(moved.Size(), 7);
+}
+
+TEST(HeavyHittersMultiSetTest, FindsHeavyHittersOfSkewedStream)
+{
+    const std::vector<MultiSet::Element> stream = SkewedStream();
+    HeavyHittersMultiSet summary(50);
+    for (const auto& element : stream)
+    {
+        summary.AddElement(element);
+    }
+    EXPECT_EQ(summary.Size(), static_cast<std::int64_t>(stream.size()));
+
+    for (int heavy = 0; heavy < 10; ++heavy)
+    {
+        std::int64_t exact = 200 - 10 * heavy;
+        EXPECT_GE(summary.Count(Key(heavy)), exact);
+        EXPECT_LE(summary.Count(Key(heavy)) - summary.Error(Key(heavy)), exact);
+        EXPECT_LE(summary.Error(Key(heavy)), summary.Size() / 50);
+    }
+
+    auto top = summary.TopK(3);
+    ASSERT_EQ(top.size(), 3u);
+    EXPECT_TRUE(VariantEqual()(*top[0].first, Key(0)));
+    EXPECT_GE(top[0].second, top[1].second);
+    EXPECT_GE(top[1].second, top[2].second);
+}
+
+TEST(HeavyHittersMultiSetTest, MergesSummariesOfThreads)
+{
+    const std::vector<MultiSet::Element> stream = SkewedStream();
+    const std::size_t threads = 4;
+    std::vector<HeavyHittersMultiSet> summaries;
+    for (std::size_t t = 0; t < threads; ++t)
+    {
+        summaries.emplace_back(50);
+    }
+    std::vector<std::thread> workers;
+    for (std::size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t] {
+            for (std::size_t i = t; i < stream.size(); i += threads)
+            {
+                summaries[t].AddElement(stream[i]);
+            }
+        });
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    HeavyHittersMultiSet merged = summaries[0] + summaries[1];
+    merged += summaries[2];
+    merged += summaries[3];
+    EXPECT_EQ(merged.Size(), static_cast<std::int64_t>(stream.size()));
+    EXPECT_TRUE(merged.IsFull());
+    for (int heavy = 0; heavy < 10; ++heavy)
+    {
+        std::int64_t exact = 200 - 10 * heavy;
+        EXPECT_GE(merged.Count(Key(heavy)), exact);
+        EXPECT_LE(merged.Count(Key(heavy)) - merged.Error(Key(heavy)), exact);
+    }
+    EXPECT_THROW(merged += HeavyHittersMultiSet(10), std::invalid_argument);
+}
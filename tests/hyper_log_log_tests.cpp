@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <memory_resource>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "hyper_log_log.hpp"
+#include "multiset.hpp"
+
+TEST(HyperLogLogTest, EstimatesWithinStandardError)
+{
+    for (std::size_t distinct : {0, 1, 10, 1000, 100000, 1000000})
+    {
+        HyperLogLog summary(12);
+        for (std::size_t i = 0; i < distinct; ++i)
+        {
+            summary.AddString("item" + std::to_string(i));
+        }
+        // Four standard errors of 1.04 / sqrt(4096)
+        double tolerance = 4 * 1.04 / 64 * static_cast<double>(distinct);
+        EXPECT_NEAR(summary.Estimate(), static_cast<double>(distinct), std::max(tolerance, 0.5)) << distinct;
+    }
+}
+
+TEST(HyperLogLogTest, DuplicatesDoNotChangeTheSummary)
+{
+    HyperLogLog once;
+    HyperLogLog twice;
+    for (int i = 0; i < 500; ++i)
+    {
+        once.AddString("x" + std::to_string(i));
+        twice.AddString("x" + std::to_string(i));
+        twice.AddElement(MultiSet::Element(std::string("x") + std::to_string(i)));
+    }
+    EXPECT_EQ(once, twice);
+}
+
+TEST(HyperLogLogTest, UnionIsRegisterMax)
+{
+    HyperLogLog shard1(10);
+    HyperLogLog shard2(10);
+    HyperLogLog whole(10);
+    for (int i = 0; i < 20000; ++i)
+    {
+        std::string key = "k" + std::to_string(i);
+        if (i < 15000)
+        {
+            shard1.AddString(key);
+        }
+        if (i >= 5000)
+        {
+            shard2.AddString(key);
+        }
+        whole.AddString(key);
+    }
+
+    EXPECT_EQ(shard1 + shard2, whole);
+    shard1 += shard2;
+    EXPECT_EQ(shard1, whole);
+    EXPECT_THROW(shard1 += HyperLogLog(11), std::invalid_argument);
+    EXPECT_THROW(HyperLogLog(3), std::invalid_argument);
+}
+
+TEST(HyperLogLogTest, BuildsFromMultiSet)
+{
+    MultiSet ms;
+    std::stringstream("{a,a,b,{c},{c},{d,e}}") >> ms;
+    HyperLogLog summary = HyperLogLog::FromMultiSet(ms);
+    EXPECT_NEAR(summary.Estimate(), 4.0, 0.5);
+
+    HyperLogLog streamed;
+    for (const auto& element : ms.GetElements())
+    {
+        streamed.AddElement(element.first);
+    }
+    EXPECT_EQ(streamed, summary);
+}
+
+TEST(HyperLogLogTest, SerializationRoundTrip)
+{
+    std::pmr::monotonic_buffer_resource resource;
+    HyperLogLog summary(8);
+    for (int i = 0; i < 100000; ++i)
+    {
+        summary.AddString(std::to_string(i));
+    }
+
+    std::string bytes = summary.Serialize();
+    EXPECT_EQ(bytes.size(), 2u + 256 * 6 / 8);
+    HyperLogLog restored = HyperLogLog::Deserialize(bytes, HyperLogLog::allocator_type(&resource));
+    EXPECT_EQ(restored, summary);
+    EXPECT_EQ(restored.Estimate(), summary.Estimate());
+    EXPECT_EQ(restored.get_allocator().resource(), &resource);
+
+    EXPECT_THROW(HyperLogLog::Deserialize(bytes.substr(0, bytes.size() - 1)), std::runtime_error);
+    EXPECT_THROW(HyperLogLog::Deserialize(std::string("\x02\x08", 2)), std::runtime_error);
+    std::string corrupt = bytes;
+    corrupt[2] = static_cast<char>(0xff);
+    EXPECT_THROW(HyperLogLog::Deserialize(corrupt), std::runtime_error);
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ingestion_pipeline.hpp"
+#include "multiset.hpp"
+#include "multiset_loader.hpp"
+
+namespace
+{
+// One random record per line, some with a nested set, every 97th one missing its closing brace
+std::string RandomRecords(std::size_t records, unsigned seed, std::vector<std::size_t>* broken_lines = nullptr)
+{
+    std::mt19937 random(seed);
+    std::string input;
+    for (std::size_t i = 0; i < records; ++i)
+    {
+        input += '{';
+        std::size_t size = 1 + random() % 6;
+        for (std::size_t k = 0; k < size; ++k)
+        {
+            input += k == 0 ? "" : ",";
+            input += random() % 8 == 0 ? "{n" + std::to_string(random() % 3) + ",m}"
+                                        : "e" + std::to_string(random() % 20);
+        }
+        if (broken_lines != nullptr && i % 97 == 13)
+        {
+            broken_lines->push_back(i + 1);
+        }
+        else
+        {
+            input += '}';
+        }
+        input += '\n';
+    }
+    return input;
+}
+}  // namespace
+
+TEST(IngestionPipelineTest, MatchesParsingTheWholeInput)
+{
+    std::string input = RandomRecords(5000, 4);
+    std::vector<MultiSet> expected = ParseRecords(input);
+
+    // Small blocks make records straddle block ends; the last line has no newline
+    input.pop_back();
+    for (std::size_t parsers : {1, 3})
+    {
+        IngestOptions options;
+        options.block_size = 1000;
+        options.queue_capacity = 2;
+        options.parser_threads = parsers;
+
+        std::istringstream stream(input);
+        std::vector<MultiSet> sets;
+        EXPECT_EQ(IngestRecords(stream, [&sets](MultiSet&& set) { sets.push_back(std::move(set)); }, options),
+                  expected.size());
+        EXPECT_EQ(sets, expected);
+
+        std::istringstream again(input);
+        EXPECT_EQ(IngestSum(again, options), SumRecords(input));
+    }
+
+    std::istringstream empty("");
+    EXPECT_TRUE(IngestSum(empty).IsEmpty());
+    std::istringstream stream(input);
+    IngestOptions invalid;
+    invalid.parser_threads = 0;
+    EXPECT_THROW(IngestSum(stream, invalid), std::invalid_argument);
+}
+
+TEST(IngestionPipelineTest, SkipsOrStopsAtMalformedRecords)
+{
+    std::vector<std::size_t> broken_lines;
+    std::string input = RandomRecords(2000, 5, &broken_lines);
+    std::vector<ParseResult> expected_errors;
+    std::vector<MultiSet> expected = ParseRecords(input, 1, &expected_errors);
+    ASSERT_EQ(expected_errors.size(), broken_lines.size());
+
+    IngestOptions options;
+    options.block_size = 512;
+    options.parser_threads = 2;
+    std::istringstream stream(input);
+    std::vector<ParseResult> errors;
+    std::vector<MultiSet> sets;
+    IngestRecords(stream, [&sets](MultiSet&& set) { sets.push_back(std::move(set)); }, options, &errors);
+    EXPECT_EQ(sets, expected);
+    ASSERT_EQ(errors.size(), expected_errors.size());
+    for (std::size_t i = 0; i < errors.size(); ++i)
+    {
+        // A broken record at the end of a block cannot run on into the next line
+        EXPECT_TRUE(errors[i].error == expected_errors[i].error || errors[i].error == ParseError::kUnexpectedEnd);
+        EXPECT_EQ(errors[i].offset, expected_errors[i].offset);
+        EXPECT_EQ(errors[i].line, expected_errors[i].line);
+    }
+
+    std::istringstream again(input);
+    EXPECT_THROW(IngestSum(again, options), std::runtime_error);
+
+    // An exception from the sink stops the pipeline
+    std::istringstream valid(RandomRecords(2000, 6));
+    std::size_t seen = 0;
+    auto sink = [&seen](MultiSet&&)
+    {
+        if (++seen == 100)
+        {
+            throw std::logic_error("stop");
+        }
+    };
+    EXPECT_THROW(IngestRecords(valid, sink, options), std::logic_error);
+    EXPECT_EQ(seen, 100u);
+}
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "basic_multiset.hpp"
+#include "min_hash.hpp"
+#include "multiset.hpp"
+
+namespace
+{
+using IdMultiSet = BasicMultiSet<std::uint64_t>;
+
+// Pair of multisets over 0..199 with overlapping supports and varying counts
+std::pair<IdMultiSet, IdMultiSet> OverlappingSets()
+{
+    IdMultiSet left;
+    IdMultiSet right;
+    for (std::uint64_t i = 0; i < 200; ++i)
+    {
+        for (std::uint64_t c = 0; c < 1 + i % 5; ++c)
+        {
+            if (i < 150)
+            {
+                left.AddElement(i);
+            }
+            if (i >= 50 && c < 1 + i % 3)
+            {
+                right.AddElement(i);
+            }
+        }
+    }
+    return {left, right};
+}
+}  // namespace
+
+TEST(MinHashTest, WeightedSignaturesEstimateWeightedJaccard)
+{
+    auto [left, right] = OverlappingSets();
+    MinHash hasher(512);
+    double estimate = MinHash::Similarity(hasher.Compute(left), hasher.Compute(right));
+    EXPECT_NEAR(estimate, left.WeightedJaccard(right), 0.07);
+    EXPECT_DOUBLE_EQ(MinHash::Similarity(hasher.Compute(left), hasher.Compute(left)), 1.0);
+}
+
+TEST(MinHashTest, SetSignaturesIgnoreCounts)
+{
+    auto [left, right] = OverlappingSets();
+    MinHash hasher(512, MinHash::Mode::kSet);
+    // The supports are 0..149 and 50..199
+    double estimate = MinHash::Similarity(hasher.Compute(left), hasher.Compute(right));
+    EXPECT_NEAR(estimate, 100.0 / 200.0, 0.07);
+    EXPECT_EQ(hasher.Compute(left), hasher.Compute(left.BuildBoolean()));
+}
+
+TEST(MinHashTest, SignaturesOfMultiSetsAreDeterministic)
+{
+    MultiSet first;
+    MultiSet second;
+    for (int i = 0; i < 20; ++i)
+    {
+        first.AddElement(MultiSet::Element(std::string("w") + std::to_string(i)));
+        second.AddElement(MultiSet::Element(std::string("w") + std::to_string(19 - i)));
+    }
+    MinHash hasher(64, MinHash::Mode::kWeighted, 42);
+    EXPECT_EQ(hasher.Compute(first), hasher.Compute(second));
+    EXPECT_NE(hasher.Compute(first), MinHash(64, MinHash::Mode::kWeighted, 43).Compute(first));
+    EXPECT_EQ(hasher.Compute(first).size(), 64u);
+
+    EXPECT_THROW(MinHash(0), std::invalid_argument);
+    EXPECT_THROW(MinHash::Similarity(MinHash::Signature(3), MinHash::Signature(4)), std::invalid_argument);
+}
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "multiset.hpp"
+#include "multiset_batch.hpp"
+
+namespace
+{
+MultiSet Parse(const std::string& text)
+{
+    MultiSet set;
+    std::istringstream stream(text);
+    stream >> set;
+    return set;
+}
+}  // namespace
+
+TEST(MultiSetBatchTest, RoundTripsRows)
+{
+    std::vector<MultiSet> sets = {Parse("{a,a,b}"), MultiSet(), Parse("{c,{a,b},b,b,b}")};
+    MultiSetBatch batch;
+    for (std::size_t i = 0; i < sets.size(); ++i)
+    {
+        EXPECT_EQ(batch.Append(sets[i]), i);
+    }
+    EXPECT_EQ(batch.Rows(), 3u);
+    EXPECT_EQ(batch.DistinctElements(), 4u);
+    for (std::size_t i = 0; i < sets.size(); ++i)
+    {
+        MultiSet row = batch.ToMultiSet(i);
+        EXPECT_EQ(row, sets[i]);
+        EXPECT_EQ(row.Size(), sets[i].Size());
+    }
+    EXPECT_THROW(batch.ToMultiSet(3), std::out_of_range);
+
+    auto id = batch.Find(MultiSet::Element(std::string("b")));
+    ASSERT_TRUE(id.has_value());
+    EXPECT_TRUE(VariantEqual()(batch.GetElement(*id), MultiSet::Element(std::string("b"))));
+    EXPECT_FALSE(batch.Find(MultiSet::Element(std::string("z"))).has_value());
+}
+
+TEST(MultiSetBatchTest, BatchOperationsMatchMultiSets)
+{
+    std::vector<MultiSet> sets;
+    MultiSetBatch batch;
+    for (int i = 0; i < 500; ++i)
+    {
+        MultiSet set;
+        for (int word = 0; word < 6; ++word)
+        {
+            for (int c = 0; c < (i * 7 + word * 3) % 4; ++c)
+            {
+                set.AddElement(MultiSet::Element("w" + std::to_string((i + word) % 9)));
+            }
+        }
+        sets.push_back(set);
+        batch.Append(set);
+    }
+
+    MultiSet query = Parse("{w1,w1,w2,w5,w5,w5,x}");
+    std::vector<std::int64_t> sizes = batch.Sizes();
+    std::vector<int> counts = batch.CountAcrossRows(MultiSet::Element(std::string("w5")));
+    std::vector<std::int64_t> intersections = batch.IntersectionSizes(query);
+    MultiSetBatch intersected = batch.Intersect(query);
+    ASSERT_EQ(intersected.Rows(), sets.size());
+    for (std::size_t i = 0; i < sets.size(); ++i)
+    {
+        EXPECT_EQ(sizes[i], static_cast<std::int64_t>(sets[i].Size()));
+        auto it = sets[i].GetElements().find(MultiSet::Element(std::string("w5")));
+        EXPECT_EQ(counts[i], it == sets[i].GetElements().end() ? 0 : it->second);
+        MultiSet expected = sets[i] * query;
+        EXPECT_EQ(intersections[i], static_cast<std::int64_t>(expected.Size()));
+        EXPECT_EQ(intersected.ToMultiSet(i), expected);
+    }
+    EXPECT_EQ(batch.CountAcrossRows(MultiSet::Element(std::string("x"))), std::vector<int>(sets.size(), 0));
+}
+
+TEST(MultiSetBatchTest, CopiesAndMovesOutliveTheSource)
+{
+    std::vector<MultiSet> sets = {Parse("{a,a,b}"), Parse("{c,{a,b}}")};
+    MultiSetBatch copy;
+    MultiSetBatch assigned;
+    std::pmr::monotonic_buffer_resource resource;
+    std::optional<MultiSetBatch> moved;
+    {
+        MultiSetBatch source;
+        for (const MultiSet& set : sets)
+        {
+            source.Append(set);
+        }
+        copy = source;
+        MultiSetBatch constructed(source);
+        assigned = std::move(constructed);
+        EXPECT_EQ(constructed.Rows(), 0u);
+        moved.emplace(std::move(source), MultiSetBatch::allocator_type(&resource));
+        EXPECT_EQ(source.Rows(), 0u);
+        EXPECT_EQ(source.DistinctElements(), 0u);
+    }
+    for (const MultiSetBatch* batch : {&copy, &assigned, &*moved})
+    {
+        ASSERT_EQ(batch->Rows(), sets.size());
+        for (std::size_t i = 0; i < sets.size(); ++i)
+        {
+            EXPECT_EQ(batch->ToMultiSet(i), sets[i]);
+        }
+        EXPECT_EQ(batch->CountAcrossRows(MultiSet::Element(std::string("a"))), (std::vector<int>{2, 0}));
+    }
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "multiset.hpp"
+#include "multiset_collection.hpp"
+
+namespace
+{
+using Ids = std::vector<MultiSetCollection::Id>;
+
+MultiSet Parse(const std::string& text)
+{
+    MultiSet set;
+    std::istringstream stream(text);
+    stream >> set;
+    return set;
+}
+
+MultiSet::Element Word(const std::string& text) { return MultiSet::Element(text); }
+}  // namespace
+
+TEST(MultiSetCollectionTest, ContainmentQueries)
+{
+    MultiSetCollection collection;
+    EXPECT_EQ(collection.Add(Parse("{a,a,b}")), 0u);
+    EXPECT_EQ(collection.Add(Parse("{a,c}")), 1u);
+    EXPECT_EQ(collection.Add(MultiSet()), 2u);
+    EXPECT_EQ(collection.Add(Parse("{b,c,{a,b}}")), 3u);
+    EXPECT_EQ(collection.Size(), 4u);
+    EXPECT_EQ(collection.Get(1), Parse("{c,a}"));
+    EXPECT_THROW(collection.Get(4), std::out_of_range);
+
+    EXPECT_EQ(collection.Containing(Word("a")), (Ids{0, 1}));
+    EXPECT_EQ(collection.Containing(Word("a"), 2), (Ids{0}));
+    EXPECT_EQ(collection.Containing(Word("z")), Ids{});
+    EXPECT_EQ(collection.Containing(MakeMultiSet(Parse("{b,a}"))), (Ids{3}));
+
+    EXPECT_EQ(collection.ContainingAll(Parse("{a,b}")), (Ids{0}));
+    EXPECT_EQ(collection.ContainingAll(Parse("{c}")), (Ids{1, 3}));
+    EXPECT_EQ(collection.ContainingAll(Parse("{a,a,a}")), Ids{});
+    EXPECT_EQ(collection.ContainingAll(MultiSet()), (Ids{0, 1, 2, 3}));
+
+    EXPECT_EQ(collection.SubMultiSetsOf(Parse("{a,a,b,c}")), (Ids{0, 1, 2}));
+    EXPECT_EQ(collection.SubMultiSetsOf(Parse("{a,b,c}")), (Ids{1, 2}));
+    EXPECT_EQ(collection.SubMultiSetsOf(Parse("{b,c,d,{a,b}}")), (Ids{2, 3}));
+}
+
+TEST(MultiSetCollectionTest, MatchesScanOverManySets)
+{
+    MultiSetCollection collection;
+    std::vector<MultiSet> sets;
+    for (std::uint64_t i = 0; i < 3000; ++i)
+    {
+        MultiSet set;
+        for (std::uint64_t word = 0; word < 12; ++word)
+        {
+            if ((i * 2654435761u >> word) % 3 == 0)
+            {
+                for (std::uint64_t c = 0; c <= (i + word) % 3; ++c)
+                {
+                    set.AddElement(Word("w" + std::to_string(word)));
+                }
+            }
+        }
+        sets.push_back(set);
+        collection.Add(set);
+    }
+    // Dense ids delta-encode into two bytes per posting
+    std::size_t postings = 0;
+    for (const auto& set : sets)
+    {
+        postings += set.GetElements().size();
+    }
+    EXPECT_LE(collection.PostingBytes(), postings * 2 + 12 * 64);
+
+    MultiSet query = Parse("{w1,w1,w4,w7,w7,w7}");
+    Ids containing_all;
+    Ids sub_multisets;
+    Ids containing;
+    for (std::size_t id = 0; id < sets.size(); ++id)
+    {
+        if ((sets[id] * query) == query)
+        {
+            containing_all.push_back(id);
+        }
+        if ((sets[id] * query) == sets[id])
+        {
+            sub_multisets.push_back(id);
+        }
+        auto it = sets[id].GetElements().find(Word("w7"));
+        if (it != sets[id].GetElements().end() && it->second >= 2)
+        {
+            containing.push_back(id);
+        }
+    }
+    EXPECT_FALSE(containing_all.empty());
+    EXPECT_EQ(collection.ContainingAll(query), containing_all);
+    EXPECT_EQ(collection.SubMultiSetsOf(query), sub_multisets);
+    EXPECT_EQ(collection.Containing(Word("w7"), 2), containing);
+}
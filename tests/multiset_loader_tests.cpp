@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "multiset.hpp"
+#include "multiset_loader.hpp"
+
+namespace
+{
+MultiSet Parse(const std::string& text)
+{
+    MultiSet set;
+    std::istringstream stream(text);
+    stream >> set;
+    return set;
+}
+
+// One random record per line, some with a nested set
+std::string RandomRecords(std::size_t records, unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::string input;
+    for (std::size_t i = 0; i < records; ++i)
+    {
+        input += '{';
+        std::size_t size = 1 + random() % 6;
+        for (std::size_t k = 0; k < size; ++k)
+        {
+            input += k == 0 ? "" : ",";
+            input += random() % 8 == 0 ? "{n" + std::to_string(random() % 3) + ",m}"
+                                        : "e" + std::to_string(random() % 20);
+        }
+        input += "}\n";
+    }
+    return input;
+}
+}  // namespace
+
+TEST(MultiSetLoaderTest, SplitsAtRecordBoundaries)
+{
+    std::string input = RandomRecords(500, 1);
+    std::vector<std::size_t> bounds = SplitRecords(input, 7);
+    ASSERT_EQ(bounds.size(), 8u);
+    EXPECT_EQ(bounds.front(), 0u);
+    EXPECT_EQ(bounds.back(), input.size());
+    for (std::size_t i = 1; i + 1 < bounds.size(); ++i)
+    {
+        EXPECT_LT(bounds[i - 1], bounds[i]);
+        EXPECT_EQ(input[bounds[i] - 2], '}');
+        EXPECT_EQ(input[bounds[i] - 1], '\n');
+    }
+
+    EXPECT_EQ(SplitRecords("{a}", 4), (std::vector<std::size_t>{0, 3}));
+    EXPECT_EQ(SplitRecords("", 4), (std::vector<std::size_t>{0, 0}));
+}
+
+TEST(MultiSetLoaderTest, ParallelParsingMatchesSequentialReading)
+{
+    std::string input = RandomRecords(3000, 2);
+    std::vector<MultiSet> expected;
+    std::istringstream stream(input);
+    for (std::size_t i = 0; i < 3000; ++i)
+    {
+        expected.push_back(MultiSet());
+        stream >> expected.back();
+    }
+
+    for (std::size_t threads : {1, 4})
+    {
+        std::vector<MultiSet> sets = ParseRecords(input, threads);
+        EXPECT_EQ(sets, expected);
+
+        std::vector<const MultiSet*> pointers;
+        for (const auto& set : expected)
+        {
+            pointers.push_back(&set);
+        }
+        MultiSet sum = SumRecords(input, threads);
+        EXPECT_EQ(sum, MultiSet::SumAll(pointers.begin(), pointers.end()));
+        EXPECT_EQ(sum.Size(), MultiSet::SumAll(pointers.begin(), pointers.end()).Size());
+    }
+    EXPECT_TRUE(ParseRecords(" \n ", 4).empty());
+    EXPECT_TRUE(ParseRecords("", 4).empty());
+    EXPECT_EQ(SumRecords("{a,b}\n{b}", 2), Parse("{a,b,b}"));
+}
+
+TEST(MultiSetLoaderTest, ReportsTheOffsetOfMalformedRecords)
+{
+    std::string input = "{a}\n{b,c}\n}{d}\n{f}";
+    for (std::size_t threads : {1, 3})
+    {
+        try
+        {
+            ParseRecords(input, threads);
+            FAIL() << "malformed input was accepted";
+        }
+        catch (const std::runtime_error& error)
+        {
+            EXPECT_NE(std::string(error.what()).find("byte 10"), std::string::npos) << error.what();
+        }
+        EXPECT_THROW(SumRecords(input, threads), std::runtime_error);
+    }
+    EXPECT_THROW(ParseRecords("{a}\n{b,c", 2), std::runtime_error);
+}
+
+TEST(MultiSetLoaderTest, MalformedInputGivesTheSameResultsForAnyThreadCount)
+{
+    std::string input;
+    for (int i = 0; i < 50; ++i)
+    {
+        input += "x {b} {c}\n{d" + std::to_string(i) + "} {e}\n}{f}\n{g,\nh}\n{i{j}}\n{k,{l}}\n";
+    }
+    EXPECT_EQ(SplitRecords("x {b} {c}\n", 2), (std::vector<std::size_t>{0, 10}));
+
+    std::vector<ParseResult> expected_errors;
+    std::vector<MultiSet> expected = ParseRecords(input, 1, &expected_errors);
+    ASSERT_FALSE(expected.empty());
+    ASSERT_FALSE(expected_errors.empty());
+    std::vector<ParseResult> sum_errors;
+    MultiSet expected_sum = SumRecords(input, 1, &sum_errors);
+    for (std::size_t threads : {2, 3, 8, 64})
+    {
+        std::vector<ParseResult> errors;
+        EXPECT_EQ(ParseRecords(input, threads, &errors), expected) << threads;
+        ASSERT_EQ(errors.size(), expected_errors.size()) << threads;
+        for (std::size_t i = 0; i < errors.size(); ++i)
+        {
+            EXPECT_EQ(errors[i].error, expected_errors[i].error) << threads;
+            EXPECT_EQ(errors[i].offset, expected_errors[i].offset) << threads;
+            EXPECT_EQ(errors[i].line, expected_errors[i].line) << threads;
+        }
+        errors.clear();
+        EXPECT_EQ(SumRecords(input, threads, &errors), expected_sum) << threads;
+        EXPECT_EQ(errors.size(), expected_errors.size()) << threads;
+    }
+}
+
+TEST(MultiSetLoaderTest, SkipsMalformedRecordsWhenCollectingErrors)
+{
+    std::string input = RandomRecords(400, 3);
+    std::vector<MultiSet> expected = ParseRecords(input);
+    // Break every hundredth record by dropping its closing brace
+    std::string broken;
+    std::size_t line = 0;
+    std::size_t start = 0;
+    std::vector<std::size_t> broken_lines;
+    for (std::size_t end = input.find('\n'); end != std::string::npos; start = end + 1, end = input.find('\n', start))
+    {
+        bool drop = line % 100 == 50;
+        broken += input.substr(start, end - start - (drop ? 1 : 0)) + "\n";
+        if (drop)
+        {
+            broken_lines.push_back(line + 1);
+            expected.erase(expected.begin() + static_cast<std::ptrdiff_t>(line + 1 - broken_lines.size()));
+        }
+        ++line;
+    }
+
+    for (std::size_t threads : {1, 4})
+    {
+        std::vector<ParseResult> errors;
+        EXPECT_EQ(ParseRecords(broken, threads, &errors), expected);
+        ASSERT_EQ(errors.size(), broken_lines.size());
+        for (std::size_t i = 0; i < errors.size(); ++i)
+        {
+            // The broken record runs on into the next line and fails at the brace that starts it
+            EXPECT_EQ(errors[i].line, broken_lines[i] + 1);
+            EXPECT_EQ(broken[errors[i].offset], '{');
+        }
+        errors.clear();
+        SumRecords(broken, threads, &errors);
+        EXPECT_EQ(errors.size(), broken_lines.size());
+    }
+}
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "basic_multiset.hpp"
+#include "multiset_lsh_index.hpp"
+
+namespace
+{
+using IdMultiSet = BasicMultiSet<std::uint64_t>;
+
+// Random multisets of 40 distinct elements out of 100000, with counts from 1 to 3
+std::vector<IdMultiSet> RandomSets(std::size_t count, std::uint32_t seed)
+{
+    std::mt19937_64 random(seed);
+    std::vector<IdMultiSet> sets(count);
+    for (auto& set : sets)
+    {
+        while (set.GetElements().size() < 40)
+        {
+            std::uint64_t element = random() % 100000;
+            for (std::uint64_t c = 0; c <= element % 3; ++c)
+            {
+                set.AddElement(element);
+            }
+        }
+    }
+    return sets;
+}
+}  // namespace
+
+TEST(MultiSetLshIndexTest, FindsNearDuplicates)
+{
+    const std::vector<IdMultiSet> sets = RandomSets(1000, 1);
+    MultiSetLshIndex index = MultiSetLshIndex::ForThreshold(0.7, 128);
+    EXPECT_LE(index.Bands() * index.Rows(), 128u);
+    for (std::size_t i = 0; i < sets.size(); ++i)
+    {
+        EXPECT_EQ(index.Insert(sets[i]), i);
+    }
+    EXPECT_EQ(index.Size(), sets.size());
+
+    std::size_t candidates = 0;
+    for (std::size_t i = 0; i < 50; ++i)
+    {
+        // Replacing two elements keeps the weighted similarity around 0.9
+        IdMultiSet query = sets[i];
+        const auto& elements = query.GetElements();
+        std::vector<std::uint64_t> removed = {elements.begin()->first, std::next(elements.begin())->first};
+        for (std::uint64_t element : removed)
+        {
+            while (query.IsContains(element))
+            {
+                query.RemoveElement(element);
+            }
+            query.AddElement(200000 + element);
+        }
+        ASSERT_GE(query.WeightedJaccard(sets[i]), 0.8);
+
+        std::vector<MultiSetLshIndex::Id> matches = index.Query(query, 0.7);
+        EXPECT_NE(std::find(matches.begin(), matches.end(), i), matches.end());
+        for (auto id : matches)
+        {
+            EXPECT_GE(index.Similarity(index.Hasher().Compute(query), id), 0.7);
+        }
+        candidates += index.Candidates(index.Hasher().Compute(query)).size();
+    }
+    // Unrelated random sets almost never share a bucket with the query
+    EXPECT_LT(candidates, 50u * 3);
+}
+
+TEST(MultiSetLshIndexTest, ValidatesArguments)
+{
+    EXPECT_THROW(MultiSetLshIndex(0, 4), std::invalid_argument);
+    EXPECT_THROW(MultiSetLshIndex(4, 0), std::invalid_argument);
+    EXPECT_THROW(MultiSetLshIndex::ForThreshold(1.5), std::invalid_argument);
+
+    MultiSetLshIndex index(4, 8, MinHash::Mode::kSet);
+    EXPECT_EQ(index.Hasher().NumHashes(), 32u);
+    EXPECT_THROW(index.InsertSignature(MinHash::Signature(31)), std::invalid_argument);
+    EXPECT_THROW(index.Similarity(MinHash::Signature(32), 0), std::out_of_range);
+
+    IdMultiSet set;
+    set.AddElement(7);
+    auto id = index.Insert(set);
+    EXPECT_EQ(index.Query(set, 1.0), std::vector<MultiSetLshIndex::Id>{id});
+}
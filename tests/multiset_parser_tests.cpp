@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "multiset.hpp"
+#include "multiset_parser.hpp"
+#include "symbol_table.hpp"
+
+namespace
+{
+MultiSet Parse(const std::string& text)
+{
+    MultiSet set;
+    std::istringstream stream(text);
+    stream >> set;
+    return set;
+}
+
+// Records events as compact strings: "(" depth, element text and ")" depth
+struct EventRecorder
+{
+    void OnBeginSet(std::size_t depth) { events.push_back("(" + std::to_string(depth)); }
+    void OnElement(std::string_view text, std::size_t depth)
+    {
+        events.push_back(std::string(text) + "@" + std::to_string(depth));
+    }
+    void OnEndSet(std::size_t depth) { events.push_back(")" + std::to_string(depth)); }
+
+    std::vector<std::string> events;
+};
+
+// Counts the elements of top-level sets only, skipping nested sets
+struct TopLevelCounter
+{
+    void OnBeginSet(std::size_t) {}
+    void OnElement(std::string_view text, std::size_t depth)
+    {
+        if (depth == 0)
+        {
+            ++counts[std::string(text)];
+        }
+    }
+    void OnEndSet(std::size_t) {}
+
+    std::map<std::string, int> counts;
+};
+}  // namespace
+
+TEST(MultiSetParserTest, ReportsEventsInInputOrder)
+{
+    std::istringstream stream("  {a, b,{c,{}} ,a}");
+    EventRecorder recorder;
+    EXPECT_TRUE(ParseMultiSetEvents(stream, recorder));
+    std::vector<std::string> expected = {"(0", "a@0", "b@0", "(1", "c@1", "(2", ")2", ")1", "a@0", ")0"};
+    EXPECT_EQ(recorder.events, expected);
+    EXPECT_FALSE(stream.fail());
+    EXPECT_EQ(stream.peek(), std::char_traits<char>::eof());
+}
+
+TEST(MultiSetParserTest, AggregatesRecordsWithoutBuildingSets)
+{
+    std::string input = "{x,y,x}\n{y,{x,x}}\n{z , x}\n";
+    std::istringstream stream(input);
+    TopLevelCounter counter;
+    int records = 0;
+    while (ParseMultiSetEvents(stream, counter))
+    {
+        ++records;
+    }
+    EXPECT_EQ(records, 3);
+    EXPECT_TRUE(stream.eof());
+
+    // The same records read with operator>> give the same top-level counts
+    std::istringstream again(input);
+    std::map<std::string, int> expected;
+    for (int i = 0; i < records; ++i)
+    {
+        MultiSet set;
+        again >> set;
+        for (const auto& [element, count] : set.GetElements())
+        {
+            if (const auto* text = std::get_if<std::string>(&element))
+            {
+                expected[*text] += count;
+            }
+        }
+    }
+    EXPECT_EQ(counter.counts, expected);
+    EXPECT_EQ(counter.counts["z "], 1);
+}
+
+TEST(MultiSetParserTest, RejectsMalformedInput)
+{
+    for (const char* text : {"a,b}", "{a,b", "{a b", "{a,{b}", "{a{b}}", "{a,b}}x", ""})
+    {
+        std::istringstream stream(text);
+        EventRecorder recorder;
+        bool complete = ParseMultiSetEvents(stream, recorder);
+        // "{a,b}}x" is one complete record followed by garbage
+        EXPECT_EQ(complete, std::string_view(text) == "{a,b}}x") << text;
+        EXPECT_EQ(stream.fail(), !complete) << text;
+    }
+}
+
+TEST(MultiSetParserTest, ParsesBuffersLikeTheStreamOperator)
+{
+    std::string input = "{a,b,{c,{d,a}},a} {x}";
+    MultiSet set;
+    ParseResult result = ParseMultiSet(input, set);
+    ASSERT_TRUE(result);
+    EXPECT_EQ(result.offset, 17u);
+
+    MultiSet expected;
+    std::istringstream stream(input);
+    stream >> expected;
+    EXPECT_EQ(set, expected);
+    EXPECT_EQ(set.Size(), 4);
+
+    MultiSet empty = Parse("{a}");
+    ASSERT_TRUE(ParseMultiSet(" { } ", empty));
+    EXPECT_TRUE(empty.IsEmpty());
+
+    SymbolTable symbols;
+    MultiSet interned;
+    interned.SetSymbolTable(&symbols);
+    ASSERT_TRUE(ParseMultiSet("{a,{a}}", interned));
+    EXPECT_EQ(symbols.Size(), 1u);
+    EXPECT_EQ(interned, Parse("{a,{a}}"));
+}
+
+TEST(MultiSetParserTest, ReportsErrorKindOffsetAndLine)
+{
+    struct Case
+    {
+        const char* text;
+        ParseError error;
+        std::size_t offset;
+        std::size_t line;
+    };
+    const Case cases[] = {
+        {"a,b}", ParseError::kExpectedSet, 0, 1},
+        {"{a,\nb", ParseError::kUnexpectedEnd, 5, 2},
+        {"  ", ParseError::kUnexpectedEnd, 2, 1},
+        {"{a,\n\n b{c}}", ParseError::kUnexpectedBrace, 7, 3},
+        {"{{a} b}", ParseError::kExpectedSeparator, 5, 1},
+    };
+    for (const Case& c : cases)
+    {
+        MultiSet set = Parse("{z}");
+        ParseResult result = ParseMultiSet(c.text, set);
+        EXPECT_FALSE(result) << c.text;
+        EXPECT_EQ(result.error, c.error) << c.text;
+        EXPECT_EQ(result.offset, c.offset) << c.text;
+        EXPECT_EQ(result.line, c.line) << c.text;
+        EXPECT_EQ(set, Parse("{z}")) << c.text;  // Left unchanged
+    }
+    EXPECT_EQ(ParseErrorMessage(ParseError::kUnexpectedEnd), "unexpected end of input");
+    EXPECT_EQ(DescribeParseFailure({ParseError::kExpectedSet, 4, 2}),
+              "Malformed MultiSet record at byte 4, line 2: expected '{'");
+}
+
+TEST(MultiSetParserTest, ResynchronizesAfterMalformedRecords)
+{
+    std::string input = "{a}\n{b,{c}\n{d}\nx}\n{e,e}";
+    std::vector<MultiSet> sets;
+    std::vector<ParseResult> errors;
+    std::size_t records = ForEachRecord(
+        input, [&](MultiSet&& set) { sets.push_back(std::move(set)); },
+        [&](const ParseResult& error) { errors.push_back(error); });
+
+    EXPECT_EQ(records, 3u);
+    std::vector<MultiSet> expected = {Parse("{a}"), Parse("{d}"), Parse("{e,e}")};
+    EXPECT_EQ(sets, expected);
+    ASSERT_EQ(errors.size(), 2u);
+    EXPECT_EQ(errors[0].error, ParseError::kExpectedSeparator);
+    EXPECT_EQ(errors[0].line, 3u);
+    EXPECT_EQ(errors[0].offset, 11u);
+    EXPECT_EQ(errors[1].error, ParseError::kExpectedSet);
+    EXPECT_EQ(errors[1].line, 4u);
+    EXPECT_EQ(errors[1].offset, 15u);
+}
@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 
 #include <sstream>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
 
 #include "multiset.hpp"
 
@@ -112,6 +115,43 @@ TEST(MultiSetTest, DifferenceOperator)
     EXPECT_EQ(result.Size(), 1);
 }
 
+TEST(MultiSetTest, DifferenceIgnoresElementsOnlyInOther)
+{
+    MultiSet ms1;
+    MultiSet ms2;
+    ms1.AddElement("a");
+    ms1.AddElement("a");
+    ms1.AddElement("b");
+    ms2.AddElement("a");
+    ms2.AddElement("c");
+
+    MultiSet difference = ms1.Difference(ms2);
+    EXPECT_EQ(difference.Size(), 2);
+    EXPECT_TRUE(difference.IsContains("a"));
+    EXPECT_TRUE(difference.IsContains("b"));
+    EXPECT_FALSE(difference.IsContains("c"));
+
+    MultiSet symmetric = std::move(ms1).SymmetricDifference(ms2);
+    EXPECT_EQ(symmetric.Size(), 3);
+    EXPECT_TRUE(symmetric.IsContains("c"));
+}
+
+TEST(MultiSetTest, UnionAllWithNestedSets)
+{
+    std::vector<MultiSet> shards(8);
+    std::vector<const MultiSet*> pointers;
+    for (std::size_t i = 0; i < shards.size(); ++i)
+    {
+        std::stringstream("{a,b,{c," + std::to_string(i % 2) + "}}") >> shards[i];
+        pointers.push_back(&shards[i]);
+    }
+
+    MultiSet united = MultiSet::UnionAll(pointers.begin(), pointers.end(), 4);
+    EXPECT_EQ(united.Size(), 4);
+    EXPECT_EQ(MultiSet::SumAll(pointers.begin(), pointers.end(), 4).Size(), 24);
+    EXPECT_EQ(MultiSet::IntersectAll(pointers.begin(), pointers.end(), 4).Size(), 2);
+}
+
 TEST(MultiSetTest, Equals_UnionOperation)
 {
     MultiSet ms1;
@@ -180,40 +220,101 @@ TEST(MultiSetTest, OutputOperator)
     EXPECT_EQ(oss.str(), "{element1}");
 }
 
+TEST(MultiSetTest, CanonicalOutputDoesNotDependOnInsertionOrder)
+{
+    SymbolTable symbols;
+    MultiSet forward;
+    MultiSet backward;
+    backward.SetSymbolTable(&symbols);
+    MultiSet nested;
+    nested.AddElement("y");
+    nested.AddElement("x");
+    for (int i = 0; i < 12; ++i)
+    {
+        forward.AddElement("e" + std::to_string(i));
+        backward.AddElement("e" + std::to_string(11 - i));
+    }
+    forward.AddElement(MakeMultiSet(nested));
+    forward.AddElement("e3");
+    backward.AddElement("e3");
+    backward.AddElement(MakeMultiSet(nested));
+    ASSERT_EQ(forward, backward);
+
+    std::ostringstream first;
+    std::ostringstream second;
+    first << CanonicalOrder << forward;
+    second << CanonicalOrder << backward;
+    EXPECT_EQ(first.str(), "{e0, e1, e10, e11, e2, e3, e3, e4, e5, e6, e7, e8, e9, {x, y}}");
+    EXPECT_EQ(first.str(), second.str());
+    EXPECT_TRUE(IsCanonicalOrder(first));
+    first << HashOrder;
+    EXPECT_FALSE(IsCanonicalOrder(first));
+}
+
+TEST(MultiSetTest, CanonicalOrderIsCachedUntilModified)
+{
+    MultiSet ms;
+    ms.AddElement("b");
+    ms.AddElement("a");
+    const auto* entries = &ms.CanonicalEntries();
+    EXPECT_EQ(&ms.CanonicalEntries(), entries);
+    ASSERT_EQ(entries->size(), 2u);
+    EXPECT_EQ(std::get<std::string>((*entries)[0]->first), "a");
+
+    ms.AddElement("0");
+    ASSERT_EQ(ms.CanonicalEntries().size(), 3u);
+    EXPECT_EQ(std::get<std::string>(ms.CanonicalEntries()[0]->first), "0");
+
+    // Nested sets order after strings and among themselves by their canonical entries
+    MultiSet small;
+    small.AddElement("a");
+    MultiSet large = small;
+    large.AddElement("b");
+    MultiSet outer;
+    outer.AddElement(MakeMultiSet(large));
+    outer.AddElement(MakeMultiSet(small));
+    outer.AddElement("z");
+    std::ostringstream oss;
+    oss << CanonicalOrder << outer;
+    EXPECT_EQ(oss.str(), "{z, {a}, {a, b}}");
+    EXPECT_LT(small.CanonicalCompare(large), 0);
+    EXPECT_EQ(large.CanonicalCompare(MultiSet(large)), 0);
+}
+
 // std::variant tests
 
 TEST(VariantHashTest, HashString)
 {
-    std::variant<std::string, std::shared_ptr<MultiSet>> v = "test";
+    MultiSet::Element v = "test";
     VariantHash hasher;
     EXPECT_NE(hasher(v), 0);
 }
 
 TEST(VariantHashTest, HashMultiSet)
 {
-    std::shared_ptr<MultiSet> ms = std::make_shared<MultiSet>();
+    MultiSetPtr ms = MakeMultiSet();
     ms->AddElement("element");
-    std::variant<std::string, std::shared_ptr<MultiSet>> v = ms;
+    MultiSet::Element v = ms;
     VariantHash hasher;
     EXPECT_NE(hasher(v), 0);
 }
 
 TEST(VariantEqualTest, EqualityString)
 {
-    std::variant<std::string, std::shared_ptr<MultiSet>> v1 = "test";
-    std::variant<std::string, std::shared_ptr<MultiSet>> v2 = "test";
+    MultiSet::Element v1 = "test";
+    MultiSet::Element v2 = "test";
     VariantEqual comparer;
     EXPECT_TRUE(comparer(v1, v2));
 }
 
 TEST(VariantEqualTest, EqualityMultiSet)
 {
-    std::shared_ptr<MultiSet> ms1 = std::make_shared<MultiSet>();
-    std::shared_ptr<MultiSet> ms2 = std::make_shared<MultiSet>();
+    MultiSetPtr ms1 = MakeMultiSet();
+    MultiSetPtr ms2 = MakeMultiSet();
     ms1->AddElement("element");
     ms2->AddElement("element");
-    std::variant<std::string, std::shared_ptr<MultiSet>> v1 = ms1;
-    std::variant<std::string, std::shared_ptr<MultiSet>> v2 = ms2;
+    MultiSet::Element v1 = ms1;
+    MultiSet::Element v2 = ms2;
     VariantEqual comparer;
     EXPECT_TRUE(comparer(v1, v2));
 }
@@ -245,12 +346,12 @@ TEST(MultiSetTest, AddNestedMultiSet)
     ms2.AddElement("nested_element");
 
     // Add a nested multiset to ms1
-    ms1.AddElement(std::make_shared<MultiSet>(ms2));
+    ms1.AddElement(MakeMultiSet(ms2));
 
     EXPECT_EQ(ms1.Size(), 1);
 
     // Check that the nested element is properly added
-    auto nested_set = std::get<std::shared_ptr<MultiSet>>(ms1.GetElements().begin()->first);
+    auto nested_set = std::get<MultiSetPtr>(ms1.GetElements().begin()->first);
     EXPECT_TRUE(nested_set->IsContains("nested_element"));
 }
 
@@ -261,10 +362,10 @@ TEST(MultiSetTest, RemoveNestedMultiSet)
     ms2.AddElement("nested_element");
 
     // Add and then remove a nested multiset
-    ms1.AddElement(std::make_shared<MultiSet>(ms2));
+    ms1.AddElement(MakeMultiSet(ms2));
     EXPECT_EQ(ms1.Size(), 1);
 
-    ms1.RemoveElement(std::make_shared<MultiSet>(ms2));
+    ms1.RemoveElement(MakeMultiSet(ms2));
     EXPECT_EQ(ms1.Size(), 0);
 }
 
@@ -278,15 +379,15 @@ TEST(MultiSetTest, UnionWithNestedMultiSets)
     nested_ms1.AddElement("nested_element1");
     nested_ms2.AddElement("nested_element2");
 
-    ms1.AddElement(std::make_shared<MultiSet>(nested_ms1));
-    ms2.AddElement(std::make_shared<MultiSet>(nested_ms2));
+    ms1.AddElement(MakeMultiSet(nested_ms1));
+    ms2.AddElement(MakeMultiSet(nested_ms2));
 
     MultiSet result = ms1 + ms2;
 
     // Ensure both nested multisets exist in the result
     EXPECT_EQ(result.Size(), 2);
-    EXPECT_TRUE(result.IsContains(std::make_shared<MultiSet>(nested_ms1)));
-    EXPECT_TRUE(result.IsContains(std::make_shared<MultiSet>(nested_ms2)));
+    EXPECT_TRUE(result.IsContains(MakeMultiSet(nested_ms1)));
+    EXPECT_TRUE(result.IsContains(MakeMultiSet(nested_ms2)));
 }
 
 TEST(MultiSetTest, IntersectionWithNestedMultiSets)
@@ -297,16 +398,16 @@ TEST(MultiSetTest, IntersectionWithNestedMultiSets)
 
     nested_ms.AddElement("shared_nested_element");
 
-    ms1.AddElement(std::make_shared<MultiSet>(nested_ms));
+    ms1.AddElement(MakeMultiSet(nested_ms));
 
-    ms2.AddElement(std::make_shared<MultiSet>(nested_ms));
+    ms2.AddElement(MakeMultiSet(nested_ms));
 
     MultiSet result = ms1 * ms2;
 
     // Ensure the shared nested multiset exists in the intersection
     EXPECT_EQ(result.Size(), 1);
 
-    EXPECT_TRUE(result.IsContains(std::make_shared<MultiSet>(nested_ms)));
+    EXPECT_TRUE(result.IsContains(MakeMultiSet(nested_ms)));
 }
 
 TEST(MultiSetTest, DifferenceWithNestedMultiSets)
@@ -317,14 +418,14 @@ TEST(MultiSetTest, DifferenceWithNestedMultiSets)
 
     nested_ms.AddElement("unique_nested_element");
 
-    ms1.AddElement(std::make_shared<MultiSet>(nested_ms));
+    ms1.AddElement(MakeMultiSet(nested_ms));
 
     // Difference between ms1 and ms2, where ms2 is empty
     MultiSet result = ms1 - ms2;
 
     // Ensure the nested multiset remains in the result
     EXPECT_EQ(result.Size(), 1);
-    EXPECT_TRUE(result.IsContains(std::make_shared<MultiSet>(nested_ms)));
+    EXPECT_TRUE(result.IsContains(MakeMultiSet(nested_ms)));
 }
 
 TEST(MultiSetTest, ComplexNestedMultiSet)
@@ -339,8 +440,8 @@ TEST(MultiSetTest, ComplexNestedMultiSet)
     nested_ms2.AddElement("element_b");
     nested_ms2.AddElement("element_b");
 
-    ms1.AddElement(std::make_shared<MultiSet>(nested_ms1));
-    ms1.AddElement(std::make_shared<MultiSet>(nested_ms2));
+    ms1.AddElement(MakeMultiSet(nested_ms1));
+    ms1.AddElement(MakeMultiSet(nested_ms2));
 
     EXPECT_EQ(ms1.Size(), 2);
 
@@ -349,7 +450,7 @@ TEST(MultiSetTest, ComplexNestedMultiSet)
 
     for (const auto& elem : ms1.GetElements())
     {
-        auto nested_set = std::get<std::shared_ptr<MultiSet>>(elem.first);
+        auto nested_set = std::get<MultiSetPtr>(elem.first);
         if (nested_set->IsContains("element_a"))
         {
             contains_a = true;
@@ -375,7 +476,7 @@ TEST(MultiSetTest, AddNestedMultiSetWithDifferentOrder)
     nested_ms.AddElement("element_2");
     nested_ms.AddElement("element_3");
 
-    ms1.AddElement(std::make_shared<MultiSet>(nested_ms));
+    ms1.AddElement(MakeMultiSet(nested_ms));
 
     EXPECT_EQ(ms1.Size(), 1);
 
@@ -384,7 +485,7 @@ TEST(MultiSetTest, AddNestedMultiSetWithDifferentOrder)
     nested_ms2.AddElement("element_1");
     nested_ms2.AddElement("element_2");
 
-    ms1.AddElement(std::make_shared<MultiSet>(nested_ms2));
+    ms1.AddElement(MakeMultiSet(nested_ms2));
 
     // Cardinality of the set is sum of elements repeats
     EXPECT_EQ(ms1.Size(), 2);
@@ -392,7 +493,7 @@ TEST(MultiSetTest, AddNestedMultiSetWithDifferentOrder)
     EXPECT_EQ(ms1.GetElements().size(), 1);
 
     // Access the only element in ms1 and check it contains "element_1", "element_2", "element_3"
-    auto nested_set = std::get<std::shared_ptr<MultiSet>>(ms1.GetElements().begin()->first);
+    auto nested_set = std::get<MultiSetPtr>(ms1.GetElements().begin()->first);
 
     EXPECT_TRUE(nested_set->IsContains("element_1"));
     EXPECT_TRUE(nested_set->IsContains("element_2"));
@@ -417,7 +518,7 @@ TEST(MultiSetTest, InputOperatorWithNestedMultiSet)
     std::istringstream second_input("nested_element3");
     second_input >> second_el;
 
-    EXPECT_TRUE(ms.IsContains(std::make_shared<MultiSet>(first_el)));
+    EXPECT_TRUE(ms.IsContains(MakeMultiSet(first_el)));
 }
 
 TEST(MultiSetTest, CompareMultiSetWithElementAndNestedSet)
@@ -429,7 +530,7 @@ TEST(MultiSetTest, CompareMultiSetWithElementAndNestedSet)
     nested_ms.AddElement("1");
 
     MultiSet ms2;
-    ms2.AddElement(std::make_shared<MultiSet>(nested_ms));
+    ms2.AddElement(MakeMultiSet(nested_ms));
 
     EXPECT_NE(ms1, ms2);
 
@@ -437,7 +538,7 @@ TEST(MultiSetTest, CompareMultiSetWithElementAndNestedSet)
     EXPECT_TRUE(ms1.IsContains("1"));
 
     EXPECT_EQ(ms2.Size(), 1);
-    auto nested_set = std::get<std::shared_ptr<MultiSet>>(ms2.GetElements().begin()->first);
+    auto nested_set = std::get<MultiSetPtr>(ms2.GetElements().begin()->first);
     EXPECT_TRUE(nested_set->IsContains("1"));
 }
 
@@ -450,4 +551,242 @@ TEST(MultiSetTest, InequalityOperatorTest)
     ms2.AddElement("2");
 
     EXPECT_TRUE(ms1 != ms2);
-}
\ No newline at end of file
+}
+// Allocator tests
+
+TEST(MultiSetAllocatorTest, UsesGivenMemoryResource)
+{
+    std::pmr::monotonic_buffer_resource arena;
+    MultiSet ms(&arena);
+
+    ms.AddElement("element1");
+    ms.AddElement("element2");
+
+    EXPECT_EQ(ms.get_allocator().resource(), &arena);
+    EXPECT_EQ(ms.GetElements().get_allocator().resource(), &arena);
+    EXPECT_EQ(ms.Size(), 2);
+}
+
+TEST(MultiSetAllocatorTest, InputOperatorAllocatesNestedSetsFromResource)
+{
+    std::pmr::monotonic_buffer_resource arena;
+    MultiSet ms(&arena);
+
+    std::istringstream input("{{a,{b}}, c}");
+    input >> ms;
+
+    ASSERT_EQ(ms.Size(), 2);
+    for (const auto& elem : ms.GetElements())
+    {
+        if (std::holds_alternative<MultiSetPtr>(elem.first))
+        {
+            const auto& nested_set = std::get<MultiSetPtr>(elem.first);
+            EXPECT_EQ(nested_set->get_allocator().resource(), &arena);
+            EXPECT_EQ(nested_set->Size(), 2);
+        }
+    }
+}
+
+TEST(MultiSetAllocatorTest, OperatorsKeepLeftOperandResource)
+{
+    std::pmr::monotonic_buffer_resource arena;
+    MultiSet ms1(&arena);
+    MultiSet ms2;
+
+    ms1.AddElement("element1");
+    ms2.AddElement("element1");
+    ms2.AddElement("element2");
+
+    EXPECT_EQ((ms1 + ms2).get_allocator().resource(), &arena);
+    EXPECT_EQ((ms1 * ms2).get_allocator().resource(), &arena);
+    EXPECT_EQ((ms1 - ms2).get_allocator().resource(), &arena);
+    EXPECT_EQ(ms1.BuildBoolean().get_allocator().resource(), &arena);
+}
+
+TEST(MultiSetAllocatorTest, AllocatorExtendedCopy)
+{
+    std::pmr::monotonic_buffer_resource arena;
+    MultiSet ms;
+    ms.AddElement("element1");
+
+    MultiSet copy(ms, &arena);
+    EXPECT_EQ(copy.get_allocator().resource(), &arena);
+    EXPECT_EQ(copy, ms);
+
+    MultiSet plain_copy(copy);
+    EXPECT_EQ(plain_copy.get_allocator().resource(), std::pmr::get_default_resource());
+}
+
+// Intrusive handle tests
+
+namespace
+{
+struct CountedNode : IntrusiveRefCounted<CountedNode, NonAtomicRefCount>
+{
+    explicit CountedNode(int* destroyed) : destroyed_(destroyed) {}
+    ~CountedNode() { ++*destroyed_; }
+
+    int* destroyed_;
+};
+}  // namespace
+
+TEST(IntrusivePtrTest, ReferenceCounting)
+{
+    int destroyed = 0;
+    IntrusivePtr<CountedNode> first(new CountedNode(&destroyed));
+    EXPECT_EQ(first->UseCount(), 1u);
+
+    {
+        IntrusivePtr<CountedNode> second = first;
+        EXPECT_EQ(first->UseCount(), 2u);
+        EXPECT_EQ(second, first);
+
+        IntrusivePtr<CountedNode> third = std::move(second);
+        EXPECT_FALSE(second);
+        EXPECT_EQ(first->UseCount(), 2u);
+    }
+
+    EXPECT_EQ(first->UseCount(), 1u);
+    EXPECT_EQ(destroyed, 0);
+
+    first.reset();
+    EXPECT_EQ(destroyed, 1);
+}
+
+TEST(IntrusivePtrTest, CopiedObjectStartsWithoutReferences)
+{
+    int destroyed = 0;
+    IntrusivePtr<CountedNode> ptr(new CountedNode(&destroyed));
+
+    CountedNode copy(*ptr);
+    EXPECT_EQ(copy.UseCount(), 0u);
+    EXPECT_EQ(ptr->UseCount(), 1u);
+}
+
+TEST(MultiSetPtrTest, AllocateMultiSetUsesResource)
+{
+    std::pmr::monotonic_buffer_resource arena;
+    MultiSet ms;
+    ms.AddElement("element1");
+
+    MultiSetPtr nested = AllocateMultiSet(&arena, ms);
+    EXPECT_EQ(nested->get_allocator().resource(), &arena);
+    EXPECT_EQ(*nested, ms);
+
+    MultiSet parent;
+    parent.AddElement(nested);
+    parent.AddElement(MakeMultiSet(ms));
+    EXPECT_EQ(parent.GetElements().at(nested), 2);
+}
+
+TEST(MultiSetTest, EqualityComparesNestedSetsByContent)
+{
+    MultiSet nested_ms;
+    nested_ms.AddElement("element");
+
+    MultiSet ms1;
+    MultiSet ms2;
+    ms1.AddElement(MakeMultiSet(nested_ms));
+    ms2.AddElement(MakeMultiSet(nested_ms));
+
+    EXPECT_EQ(ms1, ms2);
+
+    ms2.AddElement(MakeMultiSet(nested_ms));
+    EXPECT_NE(ms1, ms2);
+}
+
+TEST(MultiSetTest, SmallSetsStayInline)
+{
+    static_assert(MultiSet::kInlineCapacity == 8, "typical sets of up to eight distinct elements must not allocate");
+
+    MultiSet ms;
+    for (size_t i = 0; i < MultiSet::kInlineCapacity; ++i)
+    {
+        ms.AddElement(std::to_string(i));
+    }
+    EXPECT_TRUE(ms.GetElements().IsInline());
+    ms.AddElement("extra");
+    EXPECT_FALSE(ms.GetElements().IsInline());
+}
+
+TEST(MultiSetTest, GrowsPastInlineCapacity)
+{
+    MultiSet ms;
+    for (size_t i = 0; i < 3 * MultiSet::kInlineCapacity; ++i)
+    {
+        ms.AddElement(std::to_string(i));
+        ms.AddElement(std::to_string(i));
+    }
+
+    EXPECT_FALSE(ms.GetElements().IsInline());
+    EXPECT_EQ(ms.GetElements().size(), 3 * MultiSet::kInlineCapacity);
+    EXPECT_EQ(ms.Size(), 6 * MultiSet::kInlineCapacity);
+    EXPECT_EQ(ms.GetElements().at("0"), 2);
+
+    MultiSet copy = ms;
+    EXPECT_EQ(copy, ms);
+}
+
+TEST(MultiSetTest, MovesWithoutThrowing)
+{
+    static_assert(std::is_nothrow_move_constructible_v<MultiSet>);
+
+    for (size_t distinct : {size_t{1}, 2 * MultiSet::kInlineCapacity})
+    {
+        MultiSet ms;
+        for (size_t i = 0; i < distinct; ++i)
+        {
+            ms.AddElement(std::to_string(i));
+        }
+        MultiSet expected = ms;
+
+        MultiSet moved(std::move(ms));
+        EXPECT_EQ(moved, expected);
+        EXPECT_TRUE(ms.IsEmpty());
+    }
+}
+
+TEST(MultiSetHashTest, NoCollisionsAcrossSmallMultiSets)
+{
+    // Every multiset over four elements with counts 0..3, plain and nested one level down
+    const std::string names[] = {"a", "b", "c", "d"};
+    std::unordered_set<std::size_t> hashes;
+    size_t sets = 0;
+    for (int mask = 0; mask < 256; ++mask)
+    {
+        MultiSet ms;
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int count = 0; count < ((mask >> (2 * i)) & 3); ++count)
+            {
+                ms.AddElement(names[i]);
+            }
+        }
+
+        MultiSet outer;
+        outer.AddElement(MakeMultiSet(ms));
+
+        hashes.insert(MultiSetHash{}(ms));
+        hashes.insert(MultiSetHash{}(outer));
+        sets += 2;
+    }
+
+    // The previous XOR combiner cancelled equal element hashes and produced hundreds of collisions here
+    EXPECT_EQ(hashes.size(), sets);
+}
+
+TEST(MultiSetTest, SharedNestedSetsAreEqual)
+{
+    MultiSet nested_ms;
+    nested_ms.AddElement("element");
+    MultiSetPtr shared = MakeMultiSet(nested_ms);
+
+    MultiSet::Element v1 = shared;
+    MultiSet::Element v2 = shared;
+    EXPECT_TRUE(VariantEqual{}(v1, v2));
+
+    MultiSet ms;
+    ms.AddElement(shared);
+    EXPECT_EQ(MultiSetHash{}(*shared), MultiSetHash{}(nested_ms));
+    EXPECT_TRUE(ms.IsContains(MakeMultiSet(nested_ms)));
+}
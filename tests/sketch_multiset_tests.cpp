@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "multiset.hpp"
+#include "sketch_multiset.hpp"
+
+namespace
+{
+// Memory resource that tracks the bytes currently allocated through it
+class ByteCountingResource : public std::pmr::memory_resource
+{
+public:
+    std::size_t bytes = 0;
+
+private:
+    void* do_allocate(std::size_t size, std::size_t alignment) override
+    {
+        bytes += size;
+        return std::pmr::new_delete_resource()->allocate(size, alignment);
+    }
+
+    void do_deallocate(void* p, std::size_t size, std::size_t alignment) override
+    {
+        bytes -= size;
+        std::pmr::new_delete_resource()->deallocate(p, size, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+// Skewed stream: key i occurs 1 + 2000 / (i + 1) times
+std::vector<std::pair<std::string, int>> ZipfCounts(std::size_t distinct)
+{
+    std::vector<std::pair<std::string, int>> counts;
+    for (std::size_t i = 0; i < distinct; ++i)
+    {
+        counts.emplace_back("k" + std::to_string(i), 1 + static_cast<int>(2000 / (i + 1)));
+    }
+    return counts;
+}
+}  // namespace
+
+TEST(SketchMultiSetTest, CountMinNeverUnderestimates)
+{
+    SketchMultiSet sketch(64, 4);
+    MultiSet::Element nested = MakeMultiSet();
+    for (int i = 0; i < 100; ++i)
+    {
+        sketch.AddElement(MultiSet::Element(std::string("e") + std::to_string(i % 10)));
+    }
+    sketch.AddElement(nested, 3);
+
+    EXPECT_EQ(sketch.Size(), 103);
+    for (int i = 0; i < 10; ++i)
+    {
+        EXPECT_GE(sketch.CountString("e" + std::to_string(i)), 10);
+    }
+    EXPECT_GE(sketch.Count(nested), 3);
+    EXPECT_EQ(sketch.CountString("e3"), sketch.Count(MultiSet::Element(std::string("e3"))));
+}
+
+TEST(SketchMultiSetTest, MergeSumsShards)
+{
+    for (auto mode : {SketchMultiSet::Mode::kCountMin, SketchMultiSet::Mode::kCountSketch})
+    {
+        SketchMultiSet shard1(1024, 5, mode, 7);
+        SketchMultiSet shard2(1024, 5, mode, 7);
+        SketchMultiSet whole(1024, 5, mode, 7);
+        for (int i = 0; i < 300; ++i)
+        {
+            std::string key = "key" + std::to_string(i % 30);
+            (i % 2 == 0 ? shard1 : shard2).AddString(key);
+            whole.AddString(key);
+        }
+
+        SketchMultiSet merged = shard1 + shard2;
+        EXPECT_EQ(merged.Size(), whole.Size());
+        for (int i = 0; i < 30; ++i)
+        {
+            std::string key = "key" + std::to_string(i);
+            EXPECT_EQ(merged.CountString(key), whole.CountString(key));
+        }
+
+        shard1 += shard2;
+        EXPECT_EQ(shard1.CountString("key0"), whole.CountString("key0"));
+    }
+
+    SketchMultiSet other_seed(1024, 5, SketchMultiSet::Mode::kCountMin, 8);
+    SketchMultiSet other_width(512, 5);
+    SketchMultiSet sketch(1024, 5);
+    EXPECT_FALSE(sketch.IsCompatible(other_seed));
+    EXPECT_THROW(sketch += other_seed, std::invalid_argument);
+    EXPECT_THROW(sketch + other_width, std::invalid_argument);
+    EXPECT_THROW(SketchMultiSet(0, 5), std::invalid_argument);
+    EXPECT_THROW(SketchMultiSet(8, SketchMultiSet::kMaxDepth + 1), std::invalid_argument);
+    EXPECT_THROW(SketchMultiSet::WithErrorBounds(0.0, 0.01), std::invalid_argument);
+}
+
+TEST(SketchMultiSetTest, ErrorBoundsSizeTheSketch)
+{
+    SketchMultiSet sketch = SketchMultiSet::WithErrorBounds(0.01, 0.01);
+    EXPECT_EQ(sketch.Width(), 272u);
+    EXPECT_EQ(sketch.Depth(), 5u);
+    EXPECT_EQ(sketch.MemoryUsage(), 272u * 5 * sizeof(std::int64_t));
+
+    std::pmr::monotonic_buffer_resource resource;
+    SketchMultiSet pooled = SketchMultiSet::WithErrorBounds(0.1, 0.1, SketchMultiSet::Mode::kCountSketch, 0,
+                                                            SketchMultiSet::allocator_type(&resource));
+    EXPECT_EQ(pooled.Width(), 300u);
+    EXPECT_EQ(pooled.get_allocator().resource(), &resource);
+
+    SketchMultiSet deepest = SketchMultiSet::WithErrorBounds(0.1, 1e-300, SketchMultiSet::Mode::kCountSketch);
+    EXPECT_EQ(deepest.Depth(), SketchMultiSet::kMaxDepth);
+    deepest.AddString("a", 3);
+    EXPECT_EQ(deepest.CountString("a"), 3);
+}
+
+// Compares memory and error against the exact MultiSet on a skewed stream.
+// The measurements are recorded as test properties in the gtest XML output.
+TEST(SketchMultiSetTest, MemoryVersusErrorAgainstExactMultiSet)
+{
+    constexpr double kEpsilon = 0.001;
+    constexpr double kDelta = 0.01;
+    auto counts = ZipfCounts(20000);
+
+    ByteCountingResource exact_resource;
+    MultiSet exact{MultiSet::allocator_type(&exact_resource)};
+    SketchMultiSet count_min = SketchMultiSet::WithErrorBounds(kEpsilon, kDelta);
+    SketchMultiSet count_sketch(count_min.Width(), count_min.Depth(), SketchMultiSet::Mode::kCountSketch);
+    for (const auto& [key, count] : counts)
+    {
+        for (int n = 0; n < count; ++n)
+        {
+            exact.AddElement(key);
+        }
+        count_min.AddString(key, count);
+        count_sketch.AddString(key, count);
+    }
+    ASSERT_EQ(count_min.Size(), static_cast<std::int64_t>(exact.Size()));
+
+    double bound = kEpsilon * static_cast<double>(exact.Size());
+    std::size_t over_bound = 0;
+    double count_min_error = 0;
+    double count_sketch_error = 0;
+    for (const auto& [key, count] : counts)
+    {
+        std::int64_t estimate = count_min.CountString(key);
+        EXPECT_GE(estimate, count);
+        over_bound += static_cast<double>(estimate - count) > bound;
+        count_min_error += static_cast<double>(estimate - count);
+        count_sketch_error += std::abs(static_cast<double>(count_sketch.CountString(key) - count));
+    }
+    count_min_error /= static_cast<double>(counts.size());
+    count_sketch_error /= static_cast<double>(counts.size());
+
+    RecordProperty("exact_bytes", std::to_string(exact_resource.bytes));
+    RecordProperty("sketch_bytes", std::to_string(count_min.MemoryUsage()));
+    RecordProperty("count_min_mean_error", std::to_string(count_min_error));
+    RecordProperty("count_sketch_mean_error", std::to_string(count_sketch_error));
+
+    EXPECT_LT(count_min.MemoryUsage() * 4, exact_resource.bytes);
+    EXPECT_LE(static_cast<double>(over_bound), kDelta * static_cast<double>(counts.size()));
+    EXPECT_LT(count_min_error, bound);
+    EXPECT_LT(count_sketch_error, bound);
+}
@@ -0,0 +1,242 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <new>
+#include <string>
+#include <type_traits>
+
+#include "small_hash_map.hpp"
+
+namespace
+{
+using SmallMap = SmallHashMap<std::string, int, std::hash<std::string>, std::equal_to<std::string>, 4>;
+
+// Hash that sends every key to the same tag, so lookups rely on the equality check
+struct ConstantHash
+{
+    std::size_t operator()(int) const { return 1; }
+};
+
+// Key that can only be moved, so any key copy fails to compile
+struct MoveOnlyKey
+{
+    explicit MoveOnlyKey(int v) : value(v) {}
+    MoveOnlyKey(MoveOnlyKey&&) noexcept = default;
+    MoveOnlyKey& operator=(MoveOnlyKey&&) noexcept = default;
+
+    bool operator==(const MoveOnlyKey& other) const { return value == other.value; }
+
+    int value;
+};
+
+struct MoveOnlyKeyHash
+{
+    std::size_t operator()(const MoveOnlyKey& key) const { return std::hash<int>()(key.value); }
+};
+
+// Memory resource that counts allocations made through it and can fail one of them
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+    int allocations = 0;
+    int fail_at = 0;  // Allocation number that throws std::bad_alloc, or 0 for none
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        if (++allocations == fail_at)
+        {
+            throw std::bad_alloc();
+        }
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+    {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+std::map<std::string, int> ToStdMap(const SmallMap& map)
+{
+    return std::map<std::string, int>(map.begin(), map.end());
+}
+}  // namespace
+
+// SmallHashMap tests
+
+TEST(SmallHashMapTest, StaysInlineUpToCapacity)
+{
+    CountingResource resource;
+    SmallMap map(&resource);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        map[std::to_string(i)] = i;
+    }
+
+    EXPECT_TRUE(map.IsInline());
+    EXPECT_EQ(map.size(), 4u);
+    EXPECT_EQ(resource.allocations, 0);
+    EXPECT_EQ(map.at("3"), 3);
+}
+
+TEST(SmallHashMapTest, PromotesPastCapacity)
+{
+    CountingResource resource;
+    SmallMap map(&resource);
+
+    for (int i = 0; i < 6; ++i)
+    {
+        map[std::to_string(i)] = i;
+    }
+
+    EXPECT_FALSE(map.IsInline());
+    EXPECT_GT(resource.allocations, 0);
+    EXPECT_EQ(map.size(), 6u);
+    for (int i = 0; i < 6; ++i)
+    {
+        EXPECT_EQ(map.at(std::to_string(i)), i);
+    }
+    EXPECT_THROW(map.at("6"), std::out_of_range);
+}
+
+TEST(SmallHashMapTest, TryEmplaceDoesNotOverwrite)
+{
+    SmallMap map;
+
+    EXPECT_TRUE(map.try_emplace("a", 1).second);
+    auto result = map.try_emplace("a", 2);
+    EXPECT_FALSE(result.second);
+    EXPECT_EQ(result.first->second, 1);
+}
+
+TEST(SmallHashMapTest, EraseKeepsRemainingEntries)
+{
+    SmallMap map;
+    map["a"] = 1;
+    map["b"] = 2;
+    map["c"] = 3;
+
+    EXPECT_EQ(map.erase("a"), 1u);
+    EXPECT_EQ(map.erase("a"), 0u);
+    EXPECT_EQ(ToStdMap(map), (std::map<std::string, int>{{"b", 2}, {"c", 3}}));
+
+    for (auto it = map.begin(); it != map.end();)
+    {
+        it = map.erase(it);
+    }
+    EXPECT_TRUE(map.empty());
+}
+
+TEST(SmallHashMapTest, CollidingTagsUseEquality)
+{
+    SmallHashMap<int, int, ConstantHash, std::equal_to<int>, 8> map;
+    for (int i = 0; i < 5; ++i)
+    {
+        map[i] = i * 10;
+    }
+
+    for (int i = 0; i < 5; ++i)
+    {
+        EXPECT_EQ(map.at(i), i * 10);
+    }
+    EXPECT_EQ(map.find(5), map.end());
+}
+
+TEST(SmallHashMapTest, CopyAndMoveInBothModes)
+{
+    for (int count : {3, 7})
+    {
+        SmallMap map;
+        for (int i = 0; i < count; ++i)
+        {
+            map[std::to_string(i)] = i;
+        }
+
+        SmallMap copy(map);
+        EXPECT_EQ(ToStdMap(copy), ToStdMap(map));
+
+        SmallMap moved(std::move(copy));
+        EXPECT_EQ(ToStdMap(moved), ToStdMap(map));
+        EXPECT_TRUE(copy.empty());
+
+        SmallMap assigned;
+        assigned["x"] = 1;
+        assigned = moved;
+        EXPECT_EQ(ToStdMap(assigned), ToStdMap(map));
+
+        std::pmr::monotonic_buffer_resource arena;
+        SmallMap other_resource(std::move(moved), &arena);
+        EXPECT_EQ(ToStdMap(other_resource), ToStdMap(map));
+        EXPECT_EQ(other_resource.get_allocator().resource(), &arena);
+    }
+}
+
+TEST(SmallHashMapTest, MovesKeysInsteadOfCopying)
+{
+    using MoveOnlyMap = SmallHashMap<MoveOnlyKey, int, MoveOnlyKeyHash, std::equal_to<MoveOnlyKey>, 4>;
+    static_assert(std::is_nothrow_move_constructible_v<MoveOnlyMap>);
+    static_assert(std::is_nothrow_move_constructible_v<SmallMap>);
+
+    MoveOnlyMap map;
+    for (int i = 0; i < 4; ++i)
+    {
+        map.try_emplace(MoveOnlyKey(i), i);
+    }
+    EXPECT_EQ(map.erase(MoveOnlyKey(0)), 1u);  // Moves the last inline entry into the hole
+    EXPECT_EQ(map.at(MoveOnlyKey(3)), 3);
+
+    MoveOnlyMap moved(std::move(map));
+    EXPECT_TRUE(map.empty());
+    EXPECT_TRUE(moved.IsInline());
+    for (int i = 4; i < 8; ++i)
+    {
+        moved.try_emplace(MoveOnlyKey(i), i);
+    }
+    EXPECT_FALSE(moved.IsInline());
+
+    MoveOnlyMap promoted(std::move(moved));
+    EXPECT_TRUE(moved.IsInline());
+    EXPECT_TRUE(moved.empty());
+    EXPECT_EQ(promoted.size(), 7u);
+    for (int i = 1; i < 8; ++i)
+    {
+        EXPECT_EQ(promoted.at(MoveOnlyKey(i)), i);
+    }
+
+    moved.try_emplace(MoveOnlyKey(9), 9);  // A moved-from map is usable again
+    EXPECT_EQ(moved.at(MoveOnlyKey(9)), 9);
+}
+
+TEST(SmallHashMapTest, FailedPromotionKeepsInlineEntries)
+{
+    CountingResource resource;
+    const std::map<std::string, int> expected{{"0", 0}, {"1", 1}, {"2", 2}, {"3", 3}};
+
+    // Fail each allocation in turn: the table, its buckets, a node per moved entry and then the new entry
+    bool inserted = false;
+    for (int fail_at = 1; !inserted; ++fail_at)
+    {
+        SmallMap map(&resource);
+        for (const auto& [key, value] : expected)
+        {
+            map[key] = value;
+        }
+        resource.allocations = 0;
+        resource.fail_at = fail_at;
+        try
+        {
+            map["4"] = 4;
+            inserted = true;
+        }
+        catch (const std::bad_alloc&)
+        {
+            EXPECT_EQ(map.IsInline(), fail_at <= 2 + 4) << "failed allocation " << fail_at;
+            EXPECT_EQ(ToStdMap(map), expected) << "failed allocation " << fail_at;
+        }
+    }
+    EXPECT_EQ(resource.fail_at, 8);
+}
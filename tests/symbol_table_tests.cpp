@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "multiset.hpp"
+#include "symbol_table.hpp"
+
+// SymbolTable tests
+
+TEST(SymbolTableTest, InternReturnsSameSymbol)
+{
+    SymbolTable table;
+
+    Symbol first = table.Intern("apple");
+    Symbol second = table.Intern(std::string("apple"));
+    Symbol other = table.Intern("banana");
+
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(first.Id(), second.Id());
+    EXPECT_NE(first, other);
+    EXPECT_EQ(first.Text(), "apple");
+    EXPECT_EQ(table.Size(), 2u);
+    static_assert(sizeof(Symbol) == sizeof(void*), "a Symbol is a single pointer");
+}
+
+TEST(SymbolTableTest, AtReturnsSymbolById)
+{
+    SymbolTable table;
+    Symbol symbol = table.Intern("apple");
+
+    EXPECT_EQ(table.At(symbol.Id()), symbol);
+    EXPECT_THROW(table.At(symbol.Id() + 1), std::out_of_range);
+}
+
+TEST(SymbolTableTest, ConcurrentInternsAgree)
+{
+    SymbolTable table;
+    constexpr int kThreads = 4;
+    constexpr int kTexts = 200;
+
+    // Every thread interns the same texts, starting at a different one
+    std::vector<std::vector<Symbol>> symbols(kThreads, std::vector<Symbol>(kTexts, table.Intern("0")));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t)
+    {
+        threads.emplace_back(
+            [&, t]
+            {
+                for (int i = 0; i < kTexts; ++i)
+                {
+                    int text = (i + t * kTexts / kThreads) % kTexts;
+                    symbols[t][text] = table.Intern(std::to_string(text));
+                }
+            });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_EQ(table.Size(), static_cast<std::size_t>(kTexts));
+    for (int i = 0; i < kTexts; ++i)
+    {
+        Symbol symbol = table.At(symbols[0][i].Id());
+        EXPECT_EQ(symbol.Text(), std::to_string(i));
+        for (int t = 1; t < kThreads; ++t)
+        {
+            EXPECT_EQ(symbols[t][i].Id(), symbol.Id());
+        }
+    }
+}
+
+TEST(SymbolTableTest, SymbolsFromDifferentTablesCompareByText)
+{
+    SymbolTable first_table;
+    SymbolTable second_table;
+
+    EXPECT_EQ(first_table.Intern("apple"), second_table.Intern("apple"));
+    EXPECT_NE(first_table.Intern("apple"), second_table.Intern("banana"));
+}
+
+TEST(SymbolTableTest, SymbolHashesLikeString)
+{
+    SymbolTable table;
+    MultiSet::Element symbol = table.Intern("apple");
+    MultiSet::Element str = std::string("apple");
+
+    EXPECT_EQ(VariantHash{}(symbol), VariantHash{}(str));
+    EXPECT_TRUE(VariantEqual{}(symbol, str));
+    EXPECT_TRUE(VariantEqual{}(str, symbol));
+}
+
+// Interned MultiSet tests
+
+TEST(SymbolTableTest, AddElementInternsStrings)
+{
+    SymbolTable table;
+    MultiSet ms;
+    ms.SetSymbolTable(&table);
+
+    ms.AddElement("apple");
+    ms.AddElement("apple");
+
+    EXPECT_EQ(table.Size(), 1u);
+    EXPECT_TRUE(std::holds_alternative<Symbol>(ms.GetElements().begin()->first));
+    EXPECT_TRUE(ms.IsContains("apple"));
+    EXPECT_EQ(ms.GetElements().at("apple"), 2);
+
+    ms.RemoveElement("apple");
+    EXPECT_EQ(ms.Size(), 1u);
+}
+
+TEST(SymbolTableTest, InternedAndPlainSetsAreEqual)
+{
+    SymbolTable table;
+    MultiSet interned;
+    interned.SetSymbolTable(&table);
+    MultiSet plain;
+
+    interned.AddElement("apple");
+    plain.AddElement("apple");
+
+    EXPECT_EQ(interned, plain);
+    EXPECT_EQ((interned + plain).Size(), 1u);
+    EXPECT_EQ((interned * plain).Size(), 1u);
+}
+
+TEST(SymbolTableTest, InputOperatorInternsNestedStrings)
+{
+    SymbolTable table;
+    MultiSet ms;
+    ms.SetSymbolTable(&table);
+
+    std::istringstream input("{{a,b}, a}");
+    input >> ms;
+
+    EXPECT_EQ(ms.Size(), 2u);
+    EXPECT_EQ(table.Size(), 2u);
+
+    std::ostringstream output;
+    output << ms.BuildBoolean();
+    EXPECT_NE(output.str().find("a"), std::string::npos);
+}